@@ -0,0 +1,169 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include "autobaud.h"
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+
+#include "config.h"
+#include "utils.h"
+#include "systime.h"
+#include "mob_manager.h"
+
+// most common rates first, so a busy bus locks early
+static const uint8_t autobaud_rates[] PROGMEM = {
+	BITRATE_500_KBPS,
+	BITRATE_250_KBPS,
+	BITRATE_125_KBPS,
+	BITRATE_1_MBPS,
+	BITRATE_100_KBPS,
+	BITRATE_50_KBPS,
+	BITRATE_20_KBPS,
+	BITRATE_10_KBPS
+};
+
+#define	AUTOBAUD_STANDARD_COUNT		(sizeof(autobaud_rates) / sizeof(autobaud_rates[0]))
+
+static const uint8_t autobaud_custom[][3] PROGMEM = {
+	AUTOBAUD_CUSTOM_RATES
+};
+
+#define	AUTOBAUD_CUSTOM_COUNT		(sizeof(autobaud_custom) / sizeof(autobaud_custom[0]))
+
+#define	AUTOBAUD_ERROR_FLAGS		((1 << SERG) | (1 << CERG) | (1 << FERG))
+
+// ----------------------------------------------------------------------------
+static void autobaud_select(uint8_t rate)
+{
+	mob_begin();
+	
+	if (rate & AUTOBAUD_CUSTOM) {
+		uint8_t canbt[3];
+		memcpy_P(canbt, autobaud_custom[rate & ~AUTOBAUD_CUSTOM], 3);
+		mob_set_bit_timing(canbt);
+	}
+	else {
+		mob_init(rate);
+	}
+	mob_set_mode(LISTEN_ONLY_MODE);
+	
+	mob_commit();
+}
+
+// ----------------------------------------------------------------------------
+// Listens with the current rate and returns the number of valid messages.
+// *errors is set to the number of errors seen.
+//
+// The messages are taken directly from the CAN library and discarded. The
+// receive path (rx_queue_poll()) is not used: the filters and protocol
+// functions attached to it would hide messages from the count, and
+// anything answering there must not transmit during the listen-only probe.
+
+static uint8_t autobaud_listen(uint8_t *errors)
+{
+	uint8_t frames = 0;
+	uint8_t rec = CANREC;
+	
+	*errors = 0;
+	
+	// clear old error flags
+	CANGIT = AUTOBAUD_ERROR_FLAGS;
+	
+	uint16_t end = systime_ms() + AUTOBAUD_DWELL_MS;
+	while (!systime_elapsed(end))
+	{
+		can_t msg;
+		while (can_get_message(&msg)) {
+			if (frames < 0xff)
+				frames++;
+		}
+		
+		uint8_t flags = CANGIT & AUTOBAUD_ERROR_FLAGS;
+		if (flags) {
+			CANGIT = flags;
+			(*errors)++;
+		}
+		
+		if (frames >= AUTOBAUD_LOCK_FRAMES && *errors == 0 && CANREC == rec)
+			break;
+	}
+	
+	if (CANREC > rec)
+		*errors += CANREC - rec;
+	
+	return frames;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t autobaud_detect(void)
+{
+	uint8_t best = AUTOBAUD_NONE;
+	uint8_t best_frames = 0;
+	uint8_t best_errors = 0xff;
+	uint8_t rate = AUTOBAUD_NONE;
+	
+	can_bitrate_t old_bitrate = mob_get_bitrate();
+	can_mode_t old_mode = mob_get_mode();
+	
+	bool catch_all = mob_get_catch_all();
+	mob_set_catch_all(true);
+	
+	for (uint8_t i = 0; i < AUTOBAUD_STANDARD_COUNT + AUTOBAUD_CUSTOM_COUNT; i++)
+	{
+		if (i < AUTOBAUD_STANDARD_COUNT)
+			rate = pgm_read_byte(&autobaud_rates[i]);
+		else
+			rate = AUTOBAUD_CUSTOM + (i - AUTOBAUD_STANDARD_COUNT);
+		
+		autobaud_select(rate);
+		
+		uint8_t errors;
+		uint8_t frames = autobaud_listen(&errors);
+		
+		if (frames == 0)
+			continue;
+		
+		if (errors < best_errors || (errors == best_errors && frames > best_frames)) {
+			best = rate;
+			best_frames = frames;
+			best_errors = errors;
+		}
+		
+		if (frames >= AUTOBAUD_LOCK_FRAMES && errors == 0)
+			break;
+	}
+	
+	if (best == AUTOBAUD_NONE) {
+		// nothing found, restore the old configuration
+		mob_begin();
+		mob_init(old_bitrate);
+		mob_set_mode(old_mode);
+		mob_commit();
+	}
+	else if (best != rate) {
+		autobaud_select(best);
+	}
+	
+	mob_set_catch_all(catch_all);
+	
+	return best;
+}
@@ -0,0 +1,52 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	AUTOBAUD_H
+#define	AUTOBAUD_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Detection of the bitrate of an unknown bus
+ *
+ * All standard bitrates and the bit timings listed in AUTOBAUD_CUSTOM_RATES
+ * are tried in listen-only mode. Every rate is judged by the number of
+ * valid messages and the number of errors seen within at most
+ * AUTOBAUD_DWELL_MS. A rate receiving AUTOBAUD_LOCK_FRAMES messages
+ * without any error is taken immediately.
+ */
+
+#include <stdint.h>
+
+#include "can.h"
+
+// returned by autobaud_detect() if no rate was found
+#define	AUTOBAUD_NONE		0xff
+
+// custom rates are returned as AUTOBAUD_CUSTOM + index
+#define	AUTOBAUD_CUSTOM		0x80
+
+// ----------------------------------------------------------------------------
+// Searches for the bitrate and keeps the best one. Returns the
+// can_bitrate_t value, AUTOBAUD_CUSTOM + n for the n-th custom rate or
+// AUTOBAUD_NONE. The controller stays in listen-only mode.
+
+extern uint8_t autobaud_detect(void);
+
+#endif	// AUTOBAUD_H
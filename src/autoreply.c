@@ -0,0 +1,210 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "autoreply.h"
+#include "tx_queue.h"
+#include "systime.h"
+
+#if SUPPORT_AUTOREPLY
+
+static autoreply_rule_t autoreply_rule[AUTOREPLY_COUNT];
+static uint8_t autoreply_count;
+
+// delayed replies
+static bool autoreply_pending[AUTOREPLY_COUNT];
+static uint16_t autoreply_due[AUTOREPLY_COUNT];
+
+static const tx_options_t autoreply_tx_options = {
+	.queue = AUTOREPLY_TX_QUEUE,
+	.timeout = 0,
+	.one_shot = false
+};
+
+// ----------------------------------------------------------------------------
+int8_t autoreply_add(const capture_trigger_t *match, bool remote)
+{
+	if (autoreply_count >= AUTOREPLY_COUNT)
+		return -1;
+	
+	autoreply_rule_t *rule = &autoreply_rule[autoreply_count];
+	
+	memset(rule, 0, sizeof(autoreply_rule_t));
+	rule->match = *match;
+	rule->remote = remote;
+	rule->counter_byte = AUTOREPLY_NONE;
+	rule->checksum_byte = AUTOREPLY_NONE;
+	
+	autoreply_pending[autoreply_count] = false;
+	
+	return autoreply_count++;
+}
+
+// ----------------------------------------------------------------------------
+bool autoreply_set_reply(uint8_t n, const can_t *reply)
+{
+	if (n >= autoreply_count)
+		return false;
+	
+	autoreply_rule[n].reply = *reply;
+	autoreply_rule[n].active = true;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+bool autoreply_set_options(uint8_t n, uint16_t delay, uint8_t counter_byte,
+		uint8_t counter_mask, uint8_t checksum_byte, uint8_t checksum_type)
+{
+	if (n >= autoreply_count || delay > 30000 ||
+		(counter_byte != AUTOREPLY_NONE && (counter_byte > 7 || counter_mask == 0)) ||
+		(checksum_byte != AUTOREPLY_NONE && checksum_byte > 7) ||
+		checksum_type > AUTOREPLY_XOR)
+		return false;
+	
+	autoreply_rule_t *rule = &autoreply_rule[n];
+	
+	rule->delay = delay;
+	rule->counter_byte = counter_byte;
+	rule->counter_mask = counter_mask;
+	rule->checksum_byte = checksum_byte;
+	rule->checksum_type = checksum_type;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+bool autoreply_remove(uint8_t n)
+{
+	if (n >= autoreply_count)
+		return false;
+	
+	autoreply_count--;
+	memmove(&autoreply_rule[n], &autoreply_rule[n + 1],
+			(autoreply_count - n) * sizeof(autoreply_rule_t));
+	memmove(&autoreply_pending[n], &autoreply_pending[n + 1],
+			(autoreply_count - n) * sizeof(bool));
+	memmove(&autoreply_due[n], &autoreply_due[n + 1],
+			(autoreply_count - n) * sizeof(uint16_t));
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+void autoreply_clear(void)
+{
+	autoreply_count = 0;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t autoreply_get_count(void)
+{
+	return autoreply_count;
+}
+
+// ----------------------------------------------------------------------------
+const autoreply_rule_t * autoreply_get(uint8_t n)
+{
+	return &autoreply_rule[n];
+}
+
+// ----------------------------------------------------------------------------
+// Zaehler und Pruefsumme aktualisieren und die Antwort verschicken
+
+static void autoreply_send(autoreply_rule_t *rule)
+{
+	can_t *reply = &rule->reply;
+	
+	if (rule->counter_byte < reply->length) {
+		uint8_t mask = rule->counter_mask;
+		uint8_t *data = &reply->data[rule->counter_byte];
+		
+		// das niedrigste Bit der Maske ist die Einheit des Zaehlers
+		*data = (*data & ~mask) | ((*data + (mask & -mask)) & mask);
+	}
+	
+	if (rule->checksum_byte < reply->length) {
+		uint8_t sum = 0;
+		
+		for (uint8_t i = 0; i < reply->length; i++) {
+			if (i == rule->checksum_byte)
+				continue;
+			
+			if (rule->checksum_type == AUTOREPLY_XOR)
+				sum ^= reply->data[i];
+			else
+				sum += reply->data[i];
+		}
+		reply->data[rule->checksum_byte] = sum;
+	}
+	
+	tx_queue_send(reply, &autoreply_tx_options);
+	tx_queue_pump();
+}
+
+// ----------------------------------------------------------------------------
+void autoreply_update(const can_t *msg)
+{
+	for (uint8_t i = 0; i < autoreply_count; i++)
+	{
+		autoreply_rule_t *rule = &autoreply_rule[i];
+		
+		if (!rule->active || rule->remote != msg->flags.rtr)
+			continue;
+		
+		// bei Remote Frames keine Daten vergleichen
+		if (msg->flags.rtr) {
+			#if SUPPORT_EXTENDED_CANID
+			if (rule->match.extended != msg->flags.extended)
+				continue;
+			#endif
+			if ((msg->id ^ rule->match.id) & rule->match.mask)
+				continue;
+		}
+		else if (!capture_match(&rule->match, msg)) {
+			continue;
+		}
+		
+		rule->hits++;
+		
+		if (rule->delay == 0) {
+			autoreply_send(rule);
+		}
+		else if (!autoreply_pending[i]) {
+			autoreply_due[i] = systime_ms() + rule->delay;
+			autoreply_pending[i] = true;
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+void autoreply_poll(void)
+{
+	for (uint8_t i = 0; i < autoreply_count; i++)
+	{
+		if (autoreply_pending[i] && systime_elapsed(autoreply_due[i])) {
+			autoreply_pending[i] = false;
+			autoreply_send(&autoreply_rule[i]);
+		}
+	}
+}
+
+#endif	// SUPPORT_AUTOREPLY
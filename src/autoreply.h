@@ -0,0 +1,107 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	AUTOREPLY_H
+#define	AUTOREPLY_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Automatic answers to received messages
+ *
+ * Each rule compares received messages like a trigger of the capture
+ * (identifier with mask, up to eight data bytes with masks), either with
+ * data frames or with remote frames. On a match the reply of the rule is
+ * put into the TX queue directly from the receive path or, with a delay,
+ * from autoreply_poll().
+ *
+ * Before sending, a rolling counter (the bits of a mask within one byte)
+ * can be incremented and a checksum byte (sum or XOR of all other bytes)
+ * can be updated. The changes are kept in the reply, so the counter
+ * continues with the next answer.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+#include "capture.h"
+
+#define	AUTOREPLY_NONE			0xff	//!< no counter or checksum
+
+#define	AUTOREPLY_SUM			0
+#define	AUTOREPLY_XOR			1
+
+// ----------------------------------------------------------------------------
+typedef struct {
+	capture_trigger_t match;
+	bool remote;			//!< match remote frames instead of data frames
+	bool active;			//!< reply is set
+	can_t reply;
+	uint16_t delay;			//!< ms
+	uint8_t counter_byte;
+	uint8_t counter_mask;
+	uint8_t checksum_byte;
+	uint8_t checksum_type;
+	uint16_t hits;
+} autoreply_rule_t;
+
+// ----------------------------------------------------------------------------
+// Adds a rule without reply. Returns the number of the rule or -1 if the
+// table is full.
+
+extern int8_t autoreply_add(const capture_trigger_t *match, bool remote);
+
+// ----------------------------------------------------------------------------
+extern bool autoreply_set_reply(uint8_t n, const can_t *reply);
+
+// ----------------------------------------------------------------------------
+extern bool autoreply_set_options(uint8_t n, uint16_t delay, uint8_t counter_byte,
+		uint8_t counter_mask, uint8_t checksum_byte, uint8_t checksum_type);
+
+// ----------------------------------------------------------------------------
+extern bool autoreply_remove(uint8_t n);
+
+// ----------------------------------------------------------------------------
+extern void autoreply_clear(void);
+
+// ----------------------------------------------------------------------------
+extern uint8_t autoreply_get_count(void);
+
+// ----------------------------------------------------------------------------
+extern const autoreply_rule_t * autoreply_get(uint8_t n);
+
+// ----------------------------------------------------------------------------
+// Checks the rules for a received message
+
+extern void autoreply_update(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+// Sends the delayed replies, has to be called periodically.
+
+extern void autoreply_poll(void);
+
+// ----------------------------------------------------------------------------
+#if !SUPPORT_AUTOREPLY
+	#define	autoreply_update(msg)
+	#define	autoreply_poll()
+#endif
+
+#endif	// AUTOREPLY_H
@@ -0,0 +1,239 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include <avr/io.h>
+
+#include "busload.h"
+#include "utils.h"
+
+// bits received in the current 10 ms tick
+static volatile uint16_t busload_bits;
+
+// the following variables are only changed by busload_tick()
+static uint32_t busload_window_bits;
+static uint8_t busload_window_ticks;
+
+// up to 100000 bits per window with 1 Mbps
+static volatile uint32_t busload_current;
+static volatile uint32_t busload_peak;
+static volatile uint32_t busload_average_x8;		// in 1/8 bits
+
+static bool busload_gauge;
+
+#if BUSLOAD_EXACT_STUFFING
+// ----------------------------------------------------------------------------
+// Zaehlt die Stopfbits fuer die gegebenen Bits (MSB zuerst). Nach fuenf
+// gleichen Bits wird ein Bit mit umgekehrter Polaritaet eingefuegt, welches
+// bereits zur naechsten Folge zaehlt.
+
+typedef struct {
+	uint8_t count;
+	uint8_t run;
+	bool last;
+} stuffing_t;
+
+static void busload_stuff(stuffing_t *s, uint32_t value, uint8_t n)
+{
+	while (n--)
+	{
+		bool bit = (value >> n) & 1;
+		
+		if (bit == s->last) {
+			if (++s->run == 5) {
+				s->count++;
+				s->last = !bit;
+				s->run = 1;
+			}
+		}
+		else {
+			s->last = bit;
+			s->run = 1;
+		}
+	}
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// Laenge eines Frames in Bits inkl. Interframe Space (3 Bits)
+
+static uint8_t busload_frame_bits(const can_t *msg)
+{
+	uint8_t data = (msg->flags.rtr) ? 0 : msg->length * 8;
+	uint8_t bits;
+	
+	#if SUPPORT_EXTENDED_CANID
+	bool extended = msg->flags.extended;
+	#else
+	bool extended = false;
+	#endif
+	
+	#if BUSLOAD_EXACT_STUFFING
+	
+	stuffing_t s = { 0, 1, false };		// SOF
+	
+	if (extended) {
+		busload_stuff(&s, msg->id >> 18, 11);
+		busload_stuff(&s, 0x3, 2);						// SRR, IDE
+		busload_stuff(&s, msg->id & 0x3ffff, 18);
+		busload_stuff(&s, msg->flags.rtr ? 0x4 : 0, 3);	// RTR, r1, r0
+		bits = 67;
+	}
+	else {
+		busload_stuff(&s, msg->id, 11);
+		busload_stuff(&s, msg->flags.rtr ? 0x4 : 0, 3);	// RTR, IDE, r0
+		bits = 47;
+	}
+	busload_stuff(&s, msg->length, 4);
+	
+	for (uint8_t i = 0; i < data / 8; i++)
+		busload_stuff(&s, msg->data[i], 8);
+	
+	// the CRC is unknown, at most 4 stuff bits for its 15 bits
+	return bits + data + s.count + 4;
+	
+	#else
+	
+	uint8_t stuffed;
+	
+	if (extended) {
+		bits = 67;
+		stuffed = 54 + data;	// SOF .. CRC
+	}
+	else {
+		bits = 47;
+		stuffed = 34 + data;
+	}
+	
+	// worst case: one stuff bit after every four bits
+	return bits + data + (stuffed - 1) / 4;
+	
+	#endif
+}
+
+// ----------------------------------------------------------------------------
+// Anzahl der Bits die der Bus in 10 ms uebertragen kann
+
+static uint16_t busload_capacity(void)
+{
+	uint8_t brp = ((CANBT1 >> 1) & 0x3f) + 1;
+	uint8_t tq = 1 + (((CANBT2 >> 1) & 0x07) + 1) +
+			(((CANBT3 >> 1) & 0x07) + 1) + (((CANBT3 >> 4) & 0x07) + 1);
+	
+	return (F_CPU / 100) / ((uint16_t) brp * tq);
+}
+
+// ----------------------------------------------------------------------------
+static uint8_t busload_percent(uint32_t bits)
+{
+	// bits of a window of 100 ms
+	uint32_t load = bits * 10 / busload_capacity();
+	
+	if (load > 100)
+		return 100;
+	
+	return load;
+}
+
+// ----------------------------------------------------------------------------
+void busload_add(const can_t *msg)
+{
+	uint8_t bits = busload_frame_bits(msg);
+	
+	ENTER_CRITICAL_SECTION
+	busload_bits += bits;
+	LEAVE_CRITICAL_SECTION
+}
+
+// ----------------------------------------------------------------------------
+void busload_tick(void)
+{
+	busload_window_bits += busload_bits;
+	busload_bits = 0;
+	
+	if (++busload_window_ticks < 10)
+		return;
+	
+	uint32_t bits = busload_window_bits;
+	busload_window_bits = 0;
+	busload_window_ticks = 0;
+	
+	busload_current = bits;
+	if (bits > busload_peak)
+		busload_peak = bits;
+	
+	// exponentieller Mittelwert mit Faktor 1/8 (~ 1 s)
+	busload_average_x8 += bits - (busload_average_x8 + 4) / 8;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t busload_get_current(void)
+{
+	uint32_t bits;
+	
+	ENTER_CRITICAL_SECTION
+	bits = busload_current;
+	LEAVE_CRITICAL_SECTION
+	
+	return busload_percent(bits);
+}
+
+// ----------------------------------------------------------------------------
+uint8_t busload_get_peak(void)
+{
+	uint32_t bits;
+	
+	ENTER_CRITICAL_SECTION
+	bits = busload_peak;
+	LEAVE_CRITICAL_SECTION
+	
+	return busload_percent(bits);
+}
+
+// ----------------------------------------------------------------------------
+uint8_t busload_get_average(void)
+{
+	uint32_t bits;
+	
+	ENTER_CRITICAL_SECTION
+	bits = (busload_average_x8 + 4) / 8;
+	LEAVE_CRITICAL_SECTION
+	
+	return busload_percent(bits);
+}
+
+// ----------------------------------------------------------------------------
+void busload_reset_peak(void)
+{
+	ENTER_CRITICAL_SECTION
+	busload_peak = 0;
+	LEAVE_CRITICAL_SECTION
+}
+
+// ----------------------------------------------------------------------------
+void busload_set_gauge(bool enable)
+{
+	busload_gauge = enable;
+}
+
+// ----------------------------------------------------------------------------
+bool busload_get_gauge(void)
+{
+	return busload_gauge;
+}
@@ -0,0 +1,84 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	BUSLOAD_H
+#define	BUSLOAD_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Estimation of the bus load
+ *
+ * The length of every received and transmitted frame is calculated
+ * from its type and DLC including the interframe space. The stuff bits
+ * are either estimated for the worst case or counted for the known part
+ * of the frame (BUSLOAD_EXACT_STUFFING, only the CRC is estimated then).
+ *
+ * The bits are summed up over windows of 100 ms by the 10 ms timer
+ * interrupt and compared to the number of bits the bus could transfer in
+ * this time (taken from the bit timing registers).
+ *
+ * Only frames which reach rx_queue_poll() are counted. Frames rejected by
+ * the hardware filters (user filters, "set filter auto", no catch-all)
+ * or lost because libcan's RX buffer or the pool overflowed are not
+ * seen, so the load is too low whenever the MObs don't receive
+ * everything. Error frames are not counted either.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+
+// ----------------------------------------------------------------------------
+extern void busload_add(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+// Called every 10 ms by the timer interrupt
+
+extern void busload_tick(void);
+
+// ----------------------------------------------------------------------------
+// Load in percent during the last 100 ms
+
+extern uint8_t busload_get_current(void);
+
+// ----------------------------------------------------------------------------
+// Highest load of a 100 ms window since the last reset
+
+extern uint8_t busload_get_peak(void);
+
+// ----------------------------------------------------------------------------
+// Load averaged over about one second
+
+extern uint8_t busload_get_average(void);
+
+// ----------------------------------------------------------------------------
+extern void busload_reset_peak(void);
+
+// ----------------------------------------------------------------------------
+// Show the average load with the duo LEDs instead of the mode
+
+extern void busload_set_gauge(bool enable);
+
+// ----------------------------------------------------------------------------
+extern bool busload_get_gauge(void);
+
+#endif	// BUSLOAD_H
@@ -0,0 +1,211 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include "capture.h"
+#include "systime.h"
+
+static capture_frame_t capture_buffer[CAPTURE_SIZE];
+static uint8_t capture_head;			// next slot to write
+static uint8_t capture_count;
+static uint8_t capture_trigger_slot;
+
+static capture_trigger_t capture_trigger[2];
+static bool capture_use_b;
+static uint16_t capture_window;
+static uint16_t capture_deadline;
+
+static uint8_t capture_post = CAPTURE_SIZE / 2;
+static uint8_t capture_remaining;
+
+static capture_state_t capture_state;
+
+// ----------------------------------------------------------------------------
+bool capture_match(const capture_trigger_t *trigger, const can_t *msg)
+{
+	#if SUPPORT_EXTENDED_CANID
+	if (trigger->extended != msg->flags.extended)
+		return false;
+	#endif
+	
+	if ((msg->id ^ trigger->id) & trigger->mask)
+		return false;
+	
+	if (trigger->length > msg->length)
+		return false;
+	
+	for (uint8_t i = 0; i < trigger->length; i++) {
+		if ((msg->data[i] ^ trigger->data[i]) & trigger->data_mask[i])
+			return false;
+	}
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+void capture_set_trigger_a(const capture_trigger_t *trigger)
+{
+	capture_trigger[0] = *trigger;
+}
+
+// ----------------------------------------------------------------------------
+bool capture_set_trigger_b(const capture_trigger_t *trigger, uint16_t window)
+{
+	if (trigger == NULL) {
+		capture_use_b = false;
+		return true;
+	}
+	
+	if (window == 0 || window > 30000)
+		return false;
+	
+	capture_trigger[1] = *trigger;
+	capture_window = window;
+	capture_use_b = true;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+bool capture_set_post(uint8_t count)
+{
+	if (count >= CAPTURE_SIZE)
+		return false;
+	
+	capture_post = count;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+void capture_arm(void)
+{
+	capture_head = 0;
+	capture_count = 0;
+	capture_state = CAPTURE_ARMED;
+}
+
+// ----------------------------------------------------------------------------
+void capture_stop(void)
+{
+	capture_state = CAPTURE_OFF;
+}
+
+// ----------------------------------------------------------------------------
+capture_state_t capture_get_state(void)
+{
+	return capture_state;
+}
+
+// ----------------------------------------------------------------------------
+static void capture_fire(uint8_t slot)
+{
+	capture_trigger_slot = slot;
+	capture_remaining = capture_post;
+	
+	capture_state = (capture_post) ? CAPTURE_TRIGGERED : CAPTURE_DONE;
+}
+
+// ----------------------------------------------------------------------------
+void capture_record(const can_t *msg)
+{
+	if (capture_state == CAPTURE_OFF || capture_state == CAPTURE_DONE)
+		return;
+	
+	uint8_t slot = capture_head;
+	uint16_t now = systime_ms();
+	
+	capture_buffer[slot].msg = *msg;
+	capture_buffer[slot].time = now;
+	
+	if (++capture_head >= CAPTURE_SIZE)
+		capture_head = 0;
+	if (capture_count < CAPTURE_SIZE)
+		capture_count++;
+	
+	switch (capture_state)
+	{
+		case CAPTURE_WAIT_B:
+			if (!systime_elapsed(capture_deadline)) {
+				if (capture_match(&capture_trigger[1], msg))
+					capture_fire(slot);
+				break;
+			}
+			
+			// too late for B, wait for the next A
+			capture_state = CAPTURE_ARMED;
+			// no break
+		
+		case CAPTURE_ARMED:
+			if (capture_match(&capture_trigger[0], msg))
+			{
+				if (capture_use_b) {
+					capture_deadline = now + capture_window;
+					capture_state = CAPTURE_WAIT_B;
+				}
+				else {
+					capture_fire(slot);
+				}
+			}
+			break;
+		
+		case CAPTURE_TRIGGERED:
+			if (--capture_remaining == 0)
+				capture_state = CAPTURE_DONE;
+			break;
+		
+		default:
+			break;
+	}
+}
+
+// ----------------------------------------------------------------------------
+uint8_t capture_get_count(void)
+{
+	return capture_count;
+}
+
+// ----------------------------------------------------------------------------
+static uint8_t capture_oldest(void)
+{
+	return (capture_count < CAPTURE_SIZE) ? 0 : capture_head;
+}
+
+// ----------------------------------------------------------------------------
+const capture_frame_t * capture_get(uint8_t n)
+{
+	uint16_t slot = capture_oldest() + n;
+	
+	if (slot >= CAPTURE_SIZE)
+		slot -= CAPTURE_SIZE;
+	
+	return &capture_buffer[slot];
+}
+
+// ----------------------------------------------------------------------------
+uint8_t capture_get_trigger_position(void)
+{
+	if (capture_state != CAPTURE_TRIGGERED && capture_state != CAPTURE_DONE)
+		return 0xff;
+	
+	int16_t pos = (int16_t) capture_trigger_slot - capture_oldest();
+	if (pos < 0)
+		pos += CAPTURE_SIZE;
+	
+	return pos;
+}
@@ -0,0 +1,116 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	CAPTURE_H
+#define	CAPTURE_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Ring buffer for the messages before and after a trigger
+ *
+ * While armed all received messages are recorded into a ring buffer of
+ * CAPTURE_SIZE messages. The trigger fires on a message matching
+ * trigger A or, if trigger B is enabled, on a message matching B within
+ * the given time after A. After the configured number of further
+ * messages the recording stops and the buffer can be read.
+ *
+ * Each trigger compares the identifier with a mask and up to eight data
+ * bytes with a mask for each byte.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+
+// ----------------------------------------------------------------------------
+typedef enum {
+	CAPTURE_OFF,
+	CAPTURE_ARMED,			//!< recording, waiting for trigger A
+	CAPTURE_WAIT_B,			//!< trigger A seen, waiting for trigger B
+	CAPTURE_TRIGGERED,		//!< recording the messages after the trigger
+	CAPTURE_DONE			//!< buffer frozen
+} capture_state_t;
+
+typedef struct {
+	uint32_t id;
+	uint32_t mask;
+	bool extended;
+	uint8_t length;			//!< number of data bytes to compare
+	uint8_t data[8];
+	uint8_t data_mask[8];
+} capture_trigger_t;
+
+typedef struct {
+	can_t msg;
+	uint16_t time;			//!< time of reception in ms
+} capture_frame_t;
+
+// ----------------------------------------------------------------------------
+// Checks if the message matches the trigger (also used by autoreply.c)
+
+extern bool capture_match(const capture_trigger_t *trigger, const can_t *msg);
+
+// ----------------------------------------------------------------------------
+extern void capture_set_trigger_a(const capture_trigger_t *trigger);
+
+// ----------------------------------------------------------------------------
+// Enables trigger B which has to follow trigger A within the given time
+// (max. 30000 ms). With trigger = NULL only A is used.
+
+extern bool capture_set_trigger_b(const capture_trigger_t *trigger, uint16_t window);
+
+// ----------------------------------------------------------------------------
+// Number of messages recorded after the trigger (0..CAPTURE_SIZE-1)
+
+extern bool capture_set_post(uint8_t count);
+
+// ----------------------------------------------------------------------------
+// Clears the buffer and starts the recording
+
+extern void capture_arm(void);
+
+// ----------------------------------------------------------------------------
+extern void capture_stop(void);
+
+// ----------------------------------------------------------------------------
+extern capture_state_t capture_get_state(void);
+
+// ----------------------------------------------------------------------------
+extern void capture_record(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+// Number of messages in the buffer
+
+extern uint8_t capture_get_count(void);
+
+// ----------------------------------------------------------------------------
+// Returns the n-th message of the buffer, 0 is the oldest one
+
+extern const capture_frame_t * capture_get(uint8_t n);
+
+// ----------------------------------------------------------------------------
+// Position of the triggering message (see capture_get()) or 0xff if the
+// trigger has not fired
+
+extern uint8_t capture_get_trigger_position(void);
+
+#endif	// CAPTURE_H
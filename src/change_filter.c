@@ -0,0 +1,116 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+
+#include <string.h>
+
+#include "change_filter.h"
+#include "id_table.h"
+#include "systime.h"
+
+#if (CHANGE_CACHE_SIZE & (CHANGE_CACHE_SIZE - 1)) != 0
+	#error	CHANGE_CACHE_SIZE must be a power of two
+#endif
+
+typedef struct {
+	uint8_t length;
+	uint8_t data[8];
+	uint16_t time;		// last time the message was forwarded
+} change_entry_t;
+
+static uint32_t change_keys[CHANGE_CACHE_SIZE];
+static change_entry_t change_cache[CHANGE_CACHE_SIZE];
+
+static bool change_enabled;
+static uint16_t change_keepalive;
+
+static uint16_t change_suppressed;
+static uint16_t change_evictions;
+
+// ----------------------------------------------------------------------------
+void change_filter_enable(uint16_t keepalive)
+{
+	id_table_clear(change_keys, CHANGE_CACHE_SIZE);
+	
+	change_keepalive = keepalive;
+	change_enabled = true;
+}
+
+// ----------------------------------------------------------------------------
+void change_filter_disable(void)
+{
+	change_enabled = false;
+}
+
+// ----------------------------------------------------------------------------
+bool change_filter_is_enabled(void)
+{
+	return change_enabled;
+}
+
+// ----------------------------------------------------------------------------
+uint16_t change_filter_get_keepalive(void)
+{
+	return change_keepalive;
+}
+
+// ----------------------------------------------------------------------------
+bool change_filter_check(const can_t *msg)
+{
+	if (!change_enabled || msg->flags.rtr)
+		return true;
+	
+	id_table_result_t result;
+	uint8_t slot = id_table_insert(change_keys, CHANGE_CACHE_SIZE,
+			id_table_key(msg), &result);
+	
+	change_entry_t *entry = &change_cache[slot];
+	uint16_t now = systime_ms();
+	
+	if (result == ID_TABLE_FOUND &&
+		entry->length == msg->length &&
+		memcmp(entry->data, msg->data, msg->length) == 0 &&
+		(change_keepalive == 0 || (uint16_t) (now - entry->time) < change_keepalive))
+	{
+		change_suppressed++;
+		return false;
+	}
+	
+	if (result == ID_TABLE_EVICTED)
+		change_evictions++;
+	
+	entry->length = msg->length;
+	memcpy(entry->data, msg->data, msg->length);
+	entry->time = now;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+uint16_t change_filter_get_suppressed(void)
+{
+	return change_suppressed;
+}
+
+// ----------------------------------------------------------------------------
+uint16_t change_filter_get_evictions(void)
+{
+	return change_evictions;
+}
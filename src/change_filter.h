@@ -0,0 +1,71 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+
+#ifndef	CHANGE_FILTER_H
+#define	CHANGE_FILTER_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Forward only messages whose content has changed
+ *
+ * The length and data of the last message of each identifier are kept in
+ * a cache of CHANGE_CACHE_SIZE entries. A message is only forwarded if
+ * it differs from the previous one with the same identifier or if the
+ * keepalive interval has passed since the last forwarded copy. RTR frames
+ * are always forwarded.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+
+// ----------------------------------------------------------------------------
+// keepalive in ms, 0 = unchanged messages are never repeated
+
+extern void change_filter_enable(uint16_t keepalive);
+
+// ----------------------------------------------------------------------------
+extern void change_filter_disable(void);
+
+// ----------------------------------------------------------------------------
+extern bool change_filter_is_enabled(void);
+
+// ----------------------------------------------------------------------------
+extern uint16_t change_filter_get_keepalive(void);
+
+// ----------------------------------------------------------------------------
+// Returns true if the message should be forwarded
+
+extern bool change_filter_check(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+// Number of messages not forwarded because they were unchanged
+
+extern uint16_t change_filter_get_suppressed(void);
+
+// ----------------------------------------------------------------------------
+// Number of identifiers removed from the cache to make space for others
+
+extern uint16_t change_filter_get_evictions(void);
+
+#endif	// CHANGE_FILTER_H
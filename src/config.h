@@ -41,10 +41,148 @@
 #define	SUPPORT_EXTENDED_CANID	1
 #define	SUPPORT_TIMESTAMPS		1
 
-#define	CAN_FORCE_TX_ORDER		1
+// The order of transmission is kept by the queues in tx_queue.c, the
+// messages are written directly to the free MObs.
+#define	CAN_FORCE_TX_ORDER		0
 
-#define	CAN_RX_BUFFER_SIZE		32
-#define	CAN_TX_BUFFER_SIZE		64
+// Only used to bridge the time until the main loop moves the messages to
+// the pool
+#define	CAN_RX_BUFFER_SIZE		16
+#define	CAN_TX_BUFFER_SIZE		0
+
+// Messages waiting for the USB output and for transmission share one pool
+// of POOL_SIZE blocks (20 bytes each). The given number of blocks is
+// always kept available for each direction.
+#define	POOL_SIZE				16
+#define	POOL_RX_RESERVE			4
+#define	POOL_TX_RESERVE			4
+
+// number of priority queues for transmission, queue 0 has the highest
+// priority
+#define	TX_QUEUE_COUNT			3
+
+// messages without explicit queue are sorted by their identifier:
+// 0x000..0x0ff to queue 0, 0x100..0x3ff to queue 1 and the rest to queue 2
+#define	TX_QUEUE_ID_LIMITS		0x100, 0x400
+
+// number of message objects reserved for transmission after reset, the
+// remaining MObs are used for reception. Every TX queue has at most one
+// message in a MOb, so more than TX_QUEUE_COUNT would stay unused.
+#define	MOB_TX_DEFAULT			TX_QUEUE_COUNT
+
+// time in ms a pending transmission gets to finish before its MOb is
+// changed to reception (one frame at 10 kbps takes up to 13 ms)
+#define	MOB_TX_DRAIN_MS			15
+
+// bitrate detection: maximum time spent on each rate in ms and number of
+// error free messages after which a rate is taken immediately
+#define	AUTOBAUD_DWELL_MS		100
+#define	AUTOBAUD_LOCK_FRAMES	3
+
+// additional bit timings tried by the bitrate detection (CANBT1..3 for
+// 16 MHz), the default is 83.333 kbps with a sample point at 75%
+#define	AUTOBAUD_CUSTOM_RATES	{ 0x16, 0x0c, 0x37 }
+
+// maximum number of extended identifiers in the software filter, standard
+// identifiers are always held in a bitmap (256 bytes)
+#define	IDFILTER_EXTENDED_SIZE	8
+
+// number of identifiers remembered by the change-only forwarding (15 bytes
+// each), must be a power of two
+#define	CHANGE_CACHE_SIZE		16
+
+// rate limiting: number of rules (12 bytes each) and of identifiers with a
+// rule whose state is kept (8 bytes each, must be a power of two)
+#define	RATE_RULE_COUNT			4
+#define	RATE_STATE_SIZE			16
+
+// number of identifiers for which statistics are collected (19 bytes
+// each, 20 with CAN_RX_BUFFER_SIZE 0), must be a power of two
+#define	ID_STATS_SIZE			16
+
+// events (alarms etc.) waiting for the output, must be a power of two
+#define	EVENT_QUEUE_SIZE		8
+
+// supervision of cyclic messages: number of identifiers (11 bytes each,
+// must be a power of two) and allowed deviation in percent of the period
+// in addition to the jitter seen during the training
+#define	PERIOD_WATCH_SIZE		16
+#define	PERIOD_WATCH_TOLERANCE	25
+
+// bus load: count the stuff bits of every frame instead of assuming the
+// worst case (costs about 60 us per frame)
+#define	BUSLOAD_EXACT_STUFFING	0
+
+// number of messages held by the capture buffer (18 bytes each)
+#define	CAPTURE_SIZE			16
+
+// maximum number of identifiers for "set filter auto" (9 bytes of stack
+// each), a shell line of 49 characters holds about 8 standard identifiers
+#define	FILTER_AUTO_MAX_IDS		10
+
+// filter expressions: maximum size of the bytecode and of the estimated
+// cycles per message. A saturated bus with 500 kbps and the shortest
+// frames leaves about 1500 cycles per message for the whole RX path.
+#define	EXPR_CODE_SIZE			48
+#define	EXPR_CYCLE_BUDGET		600
+
+// ----------------------------------------------------------------------------
+// Optional protocol functions. Each of them fits into RAM_LIMIT together
+// with the functions above, all of them need more than the 4 KB SRAM, so
+// they are disabled by default. The makefile checks the static RAM against
+// RAM_LIMIT, enable only the functions which are needed.
+
+// decoding of signals on the device and the number of signals (35 bytes
+// each)
+#define	SUPPORT_SIGNALS			0
+#define	SIGNAL_COUNT			4
+
+// ISO-TP on the device, number of channels (35 bytes each plus the
+// buffers), size of the buffers for received and sent PDUs, timeout for
+// flow control and consecutive frames (ms) and the TX queue used. A
+// Lawicel command line holds 29 bytes of payload.
+#define	SUPPORT_ISOTP			0
+#define	ISOTP_CHANNELS			1
+#define	ISOTP_RX_SIZE			64
+#define	ISOTP_TX_SIZE			29
+#define	ISOTP_TIMEOUT			1000
+#define	ISOTP_TX_QUEUE			0
+
+// reassembly of the J1939 transport protocol, concurrent sessions (16
+// bytes each plus the buffer), maximum size of a message (up to 1785),
+// timeout (ms) and the TX queue for CTS and acknowledgements
+#define	SUPPORT_J1939			0
+#define	J1939_SESSIONS			2
+#define	J1939_BUFFER_SIZE		64
+#define	J1939_TIMEOUT			1250
+#define	J1939_TX_QUEUE			0
+
+// request engine, number of entries (35 bytes each), buffered responses
+// (21 bytes each) and the TX queue used
+#define	SUPPORT_REQUEST			0
+#define	REQUEST_COUNT			4
+#define	REQUEST_RESULTS			2
+#define	REQUEST_TX_QUEUE		0
+
+// automatic replies, number of rules (55 bytes each) and the TX queue
+// used for them
+#define	SUPPORT_AUTOREPLY		0
+#define	AUTOREPLY_COUNT			4
+#define	AUTOREPLY_TX_QUEUE		0
+
+// rewriting and retransmitting of messages, number of rules (65 bytes
+// each) and the TX queue used
+#define	SUPPORT_GATEWAY			0
+#define	GATEWAY_COUNT			4
+#define	GATEWAY_TX_QUEUE		0
+
+// width of the pulse of the trigger output
+#define	TRIGGER_PULSE_US		2
+
+// checks of the end-to-end protection (CRC and counter), number of
+// checked identifiers (37 bytes each)
+#define	SUPPORT_E2E				0
+#define	E2E_COUNT				4
 
 // ----------------------------------------------------------------------------
 extern void debugger_indicate_tx_traffic(void);
@@ -108,6 +246,9 @@ extern void debugger_indicate_rx_traffic(void);
 #define	RD				G,1
 #define	WR				G,0
 
+// spare pin for the trigger output (PDO of the ISP connector)
+#define	TRIGGER_PIN		E,1
+
 #define	USB_DATA		A
 
 #define	USB_RXF			E,7
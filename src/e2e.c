@@ -0,0 +1,328 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include <string.h>
+#include <avr/pgmspace.h>
+
+#include "e2e.h"
+#include "id_table.h"
+#include "event_queue.h"
+
+#if SUPPORT_E2E
+
+// ----------------------------------------------------------------------------
+// CRC8 SAE J1850, Polynom 0x1d
+static const uint8_t e2e_crc8_table[256] PROGMEM = {
+	0x00, 0x1d, 0x3a, 0x27, 0x74, 0x69, 0x4e, 0x53, 0xe8, 0xf5, 0xd2, 0xcf,
+	0x9c, 0x81, 0xa6, 0xbb, 0xcd, 0xd0, 0xf7, 0xea, 0xb9, 0xa4, 0x83, 0x9e,
+	0x25, 0x38, 0x1f, 0x02, 0x51, 0x4c, 0x6b, 0x76, 0x87, 0x9a, 0xbd, 0xa0,
+	0xf3, 0xee, 0xc9, 0xd4, 0x6f, 0x72, 0x55, 0x48, 0x1b, 0x06, 0x21, 0x3c,
+	0x4a, 0x57, 0x70, 0x6d, 0x3e, 0x23, 0x04, 0x19, 0xa2, 0xbf, 0x98, 0x85,
+	0xd6, 0xcb, 0xec, 0xf1, 0x13, 0x0e, 0x29, 0x34, 0x67, 0x7a, 0x5d, 0x40,
+	0xfb, 0xe6, 0xc1, 0xdc, 0x8f, 0x92, 0xb5, 0xa8, 0xde, 0xc3, 0xe4, 0xf9,
+	0xaa, 0xb7, 0x90, 0x8d, 0x36, 0x2b, 0x0c, 0x11, 0x42, 0x5f, 0x78, 0x65,
+	0x94, 0x89, 0xae, 0xb3, 0xe0, 0xfd, 0xda, 0xc7, 0x7c, 0x61, 0x46, 0x5b,
+	0x08, 0x15, 0x32, 0x2f, 0x59, 0x44, 0x63, 0x7e, 0x2d, 0x30, 0x17, 0x0a,
+	0xb1, 0xac, 0x8b, 0x96, 0xc5, 0xd8, 0xff, 0xe2, 0x26, 0x3b, 0x1c, 0x01,
+	0x52, 0x4f, 0x68, 0x75, 0xce, 0xd3, 0xf4, 0xe9, 0xba, 0xa7, 0x80, 0x9d,
+	0xeb, 0xf6, 0xd1, 0xcc, 0x9f, 0x82, 0xa5, 0xb8, 0x03, 0x1e, 0x39, 0x24,
+	0x77, 0x6a, 0x4d, 0x50, 0xa1, 0xbc, 0x9b, 0x86, 0xd5, 0xc8, 0xef, 0xf2,
+	0x49, 0x54, 0x73, 0x6e, 0x3d, 0x20, 0x07, 0x1a, 0x6c, 0x71, 0x56, 0x4b,
+	0x18, 0x05, 0x22, 0x3f, 0x84, 0x99, 0xbe, 0xa3, 0xf0, 0xed, 0xca, 0xd7,
+	0x35, 0x28, 0x0f, 0x12, 0x41, 0x5c, 0x7b, 0x66, 0xdd, 0xc0, 0xe7, 0xfa,
+	0xa9, 0xb4, 0x93, 0x8e, 0xf8, 0xe5, 0xc2, 0xdf, 0x8c, 0x91, 0xb6, 0xab,
+	0x10, 0x0d, 0x2a, 0x37, 0x64, 0x79, 0x5e, 0x43, 0xb2, 0xaf, 0x88, 0x95,
+	0xc6, 0xdb, 0xfc, 0xe1, 0x5a, 0x47, 0x60, 0x7d, 0x2e, 0x33, 0x14, 0x09,
+	0x7f, 0x62, 0x45, 0x58, 0x0b, 0x16, 0x31, 0x2c, 0x97, 0x8a, 0xad, 0xb0,
+	0xe3, 0xfe, 0xd9, 0xc4
+};
+
+// CRC8H2F, Polynom 0x2f
+static const uint8_t e2e_crc8h2f_table[256] PROGMEM = {
+	0x00, 0x2f, 0x5e, 0x71, 0xbc, 0x93, 0xe2, 0xcd, 0x57, 0x78, 0x09, 0x26,
+	0xeb, 0xc4, 0xb5, 0x9a, 0xae, 0x81, 0xf0, 0xdf, 0x12, 0x3d, 0x4c, 0x63,
+	0xf9, 0xd6, 0xa7, 0x88, 0x45, 0x6a, 0x1b, 0x34, 0x73, 0x5c, 0x2d, 0x02,
+	0xcf, 0xe0, 0x91, 0xbe, 0x24, 0x0b, 0x7a, 0x55, 0x98, 0xb7, 0xc6, 0xe9,
+	0xdd, 0xf2, 0x83, 0xac, 0x61, 0x4e, 0x3f, 0x10, 0x8a, 0xa5, 0xd4, 0xfb,
+	0x36, 0x19, 0x68, 0x47, 0xe6, 0xc9, 0xb8, 0x97, 0x5a, 0x75, 0x04, 0x2b,
+	0xb1, 0x9e, 0xef, 0xc0, 0x0d, 0x22, 0x53, 0x7c, 0x48, 0x67, 0x16, 0x39,
+	0xf4, 0xdb, 0xaa, 0x85, 0x1f, 0x30, 0x41, 0x6e, 0xa3, 0x8c, 0xfd, 0xd2,
+	0x95, 0xba, 0xcb, 0xe4, 0x29, 0x06, 0x77, 0x58, 0xc2, 0xed, 0x9c, 0xb3,
+	0x7e, 0x51, 0x20, 0x0f, 0x3b, 0x14, 0x65, 0x4a, 0x87, 0xa8, 0xd9, 0xf6,
+	0x6c, 0x43, 0x32, 0x1d, 0xd0, 0xff, 0x8e, 0xa1, 0xe3, 0xcc, 0xbd, 0x92,
+	0x5f, 0x70, 0x01, 0x2e, 0xb4, 0x9b, 0xea, 0xc5, 0x08, 0x27, 0x56, 0x79,
+	0x4d, 0x62, 0x13, 0x3c, 0xf1, 0xde, 0xaf, 0x80, 0x1a, 0x35, 0x44, 0x6b,
+	0xa6, 0x89, 0xf8, 0xd7, 0x90, 0xbf, 0xce, 0xe1, 0x2c, 0x03, 0x72, 0x5d,
+	0xc7, 0xe8, 0x99, 0xb6, 0x7b, 0x54, 0x25, 0x0a, 0x3e, 0x11, 0x60, 0x4f,
+	0x82, 0xad, 0xdc, 0xf3, 0x69, 0x46, 0x37, 0x18, 0xd5, 0xfa, 0x8b, 0xa4,
+	0x05, 0x2a, 0x5b, 0x74, 0xb9, 0x96, 0xe7, 0xc8, 0x52, 0x7d, 0x0c, 0x23,
+	0xee, 0xc1, 0xb0, 0x9f, 0xab, 0x84, 0xf5, 0xda, 0x17, 0x38, 0x49, 0x66,
+	0xfc, 0xd3, 0xa2, 0x8d, 0x40, 0x6f, 0x1e, 0x31, 0x76, 0x59, 0x28, 0x07,
+	0xca, 0xe5, 0x94, 0xbb, 0x21, 0x0e, 0x7f, 0x50, 0x9d, 0xb2, 0xc3, 0xec,
+	0xd8, 0xf7, 0x86, 0xa9, 0x64, 0x4b, 0x3a, 0x15, 0x8f, 0xa0, 0xd1, 0xfe,
+	0x33, 0x1c, 0x6d, 0x42
+};
+
+static e2e_entry_t e2e_entry[E2E_COUNT];
+static uint8_t e2e_count;
+
+// ----------------------------------------------------------------------------
+int8_t e2e_add(uint32_t key, e2e_profile_t profile, uint16_t data_id)
+{
+	if (e2e_count >= E2E_COUNT ||
+		(profile != E2E_PROFILE_1 && profile != E2E_PROFILE_2))
+		return -1;
+	
+	for (uint8_t i = 0; i < e2e_count; i++) {
+		if (e2e_entry[i].key == key)
+			return -1;
+	}
+	
+	e2e_entry_t *entry = &e2e_entry[e2e_count];
+	
+	memset(entry, 0, sizeof(e2e_entry_t));
+	entry->key = key;
+	entry->profile = profile;
+	if (profile == E2E_PROFILE_1)
+		entry->data_id = data_id;
+	else
+		memset(entry->data_id_list, data_id & 0xff, 16);
+	entry->crc_byte = 0;
+	entry->counter_byte = 1;
+	entry->counter_shift = 0;
+	entry->max_delta = 1;
+	
+	return e2e_count++;
+}
+
+// ----------------------------------------------------------------------------
+bool e2e_set_layout(uint8_t n, uint8_t crc_byte, uint8_t counter_byte,
+		uint8_t counter_shift, uint8_t max_delta)
+{
+	if (n >= e2e_count ||
+		(crc_byte != E2E_NONE && crc_byte > 7) ||
+		(counter_byte != E2E_NONE && counter_byte > 7) ||
+		(counter_shift != 0 && counter_shift != 4) ||
+		max_delta == 0 || max_delta > 14)
+		return false;
+	
+	e2e_entry_t *entry = &e2e_entry[n];
+	
+	if (entry->profile == E2E_PROFILE_2 && crc_byte != E2E_NONE &&
+		counter_byte == E2E_NONE)
+		return false;
+	
+	entry->crc_byte = crc_byte;
+	entry->counter_byte = counter_byte;
+	entry->counter_shift = counter_shift;
+	entry->max_delta = max_delta;
+	entry->valid = false;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+bool e2e_set_data_id_list(uint8_t n, const uint8_t *list)
+{
+	if (n >= e2e_count || e2e_entry[n].profile != E2E_PROFILE_2)
+		return false;
+	
+	memcpy(e2e_entry[n].data_id_list, list, 16);
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+bool e2e_remove(uint8_t n)
+{
+	if (n >= e2e_count)
+		return false;
+	
+	e2e_count--;
+	memmove(&e2e_entry[n], &e2e_entry[n + 1],
+			(e2e_count - n) * sizeof(e2e_entry_t));
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+void e2e_clear(void)
+{
+	e2e_count = 0;
+}
+
+// ----------------------------------------------------------------------------
+void e2e_reset(void)
+{
+	for (uint8_t i = 0; i < e2e_count; i++)
+	{
+		e2e_entry_t *entry = &e2e_entry[i];
+		
+		entry->valid = false;
+		entry->ok = 0;
+		entry->crc_errors = 0;
+		entry->repeated = 0;
+		entry->lost = 0;
+		entry->length_errors = 0;
+	}
+}
+
+// ----------------------------------------------------------------------------
+uint8_t e2e_get_count(void)
+{
+	return e2e_count;
+}
+
+// ----------------------------------------------------------------------------
+const e2e_entry_t * e2e_get(uint8_t n)
+{
+	return &e2e_entry[n];
+}
+
+// ----------------------------------------------------------------------------
+static uint8_t e2e_crc_update(const uint8_t *table, uint8_t crc, uint8_t data)
+{
+	return pgm_read_byte(&table[crc ^ data]);
+}
+
+// ----------------------------------------------------------------------------
+// Die Startwerte ergeben sich aus der Verkettung der Crc_CalculateCRC8()
+// Aufrufe in den AUTOSAR Profilen: beide beginnen effektiv mit 0x00,
+// Profil 2 invertiert das Ergebnis. Profil 2 waehlt die Data ID mit dem
+// Zaehler aus der DataIDList (e2e_set_layout() erzwingt den Zaehler).
+
+static uint8_t e2e_calculate_crc(const e2e_entry_t *entry, const can_t *msg)
+{
+	uint8_t crc = 0;
+	
+	if (entry->profile == E2E_PROFILE_1)
+	{
+		crc = e2e_crc_update(e2e_crc8_table, crc, entry->data_id & 0xff);
+		crc = e2e_crc_update(e2e_crc8_table, crc, entry->data_id >> 8);
+		
+		for (uint8_t i = 0; i < msg->length; i++) {
+			if (i != entry->crc_byte)
+				crc = e2e_crc_update(e2e_crc8_table, crc, msg->data[i]);
+		}
+		
+		return crc;
+	}
+	else
+	{
+		for (uint8_t i = 0; i < msg->length; i++) {
+			if (i != entry->crc_byte)
+				crc = e2e_crc_update(e2e_crc8h2f_table, crc, msg->data[i]);
+		}
+		uint8_t counter = (msg->data[entry->counter_byte] >> entry->counter_shift) & 0x0f;
+		crc = e2e_crc_update(e2e_crc8h2f_table, crc, entry->data_id_list[counter]);
+		
+		return crc ^ 0xff;
+	}
+}
+
+// ----------------------------------------------------------------------------
+// Returns false if a message was repeated or lost
+
+static bool e2e_check_counter(e2e_entry_t *entry, uint32_t key,
+		const can_t *msg)
+{
+	uint8_t counter = (msg->data[entry->counter_byte] >> entry->counter_shift) & 0x0f;
+	uint8_t range = (entry->profile == E2E_PROFILE_1) ? 15 : 16;
+	
+	if (counter >= range) {
+		// Profil 1 verwendet den Wert 15 nicht
+		entry->lost++;
+		entry->valid = false;
+		event_push(E2E_EVENT, 'i', key, counter);
+		return false;
+	}
+	
+	bool ok = true;
+	
+	if (entry->valid)
+	{
+		uint8_t delta = counter + range - entry->last_counter;
+		if (delta >= range)
+			delta -= range;
+		
+		if (delta == 0) {
+			entry->repeated++;
+			event_push(E2E_EVENT, 'r', key, counter);
+			ok = false;
+		}
+		else if (delta > entry->max_delta) {
+			// Anzahl der verlorenen Nachrichten
+			entry->lost++;
+			event_push(E2E_EVENT, 'l', key, delta - 1);
+			ok = false;
+		}
+	}
+	
+	entry->last_counter = counter;
+	entry->valid = true;
+	
+	return ok;
+}
+
+// ----------------------------------------------------------------------------
+void e2e_update(const can_t *msg)
+{
+	if (e2e_count == 0 || msg->flags.rtr)
+		return;
+	
+	uint32_t key = id_table_key(msg);
+	
+	for (uint8_t i = 0; i < e2e_count; i++)
+	{
+		e2e_entry_t *entry = &e2e_entry[i];
+		
+		if (entry->key != key)
+			continue;
+		
+		if ((entry->crc_byte != E2E_NONE && entry->crc_byte >= msg->length) ||
+			(entry->counter_byte != E2E_NONE && entry->counter_byte >= msg->length)) {
+			entry->length_errors++;
+			event_push(E2E_EVENT, 'd', key, msg->length);
+			return;
+		}
+		
+		if (entry->crc_byte != E2E_NONE)
+		{
+			uint8_t crc = e2e_calculate_crc(entry, msg);
+			uint8_t received = msg->data[entry->crc_byte];
+			
+			if (crc != received) {
+				// der Zaehler einer verfaelschten Nachricht ist wertlos
+				entry->crc_errors++;
+				event_push(E2E_EVENT, 'c', key, ((uint16_t) received << 8) | crc);
+				return;
+			}
+		}
+		
+		if (entry->counter_byte != E2E_NONE && !e2e_check_counter(entry, key, msg))
+			return;
+		
+		entry->ok++;
+		
+		return;
+	}
+}
+
+#endif	// SUPPORT_E2E
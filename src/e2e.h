@@ -0,0 +1,129 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	E2E_H
+#define	E2E_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Checks the end-to-end protection of received messages
+ *
+ * For each configured identifier the CRC and the rolling counter of the
+ * AUTOSAR E2E profiles 1 and 2 are verified:
+ *
+ * - Profile 1: CRC8 (SAE J1850) over the low and high byte of the data ID
+ *   and all data bytes except the CRC, counter from 0 to 14.
+ * - Profile 2: CRC8H2F over all data bytes except the CRC followed by the
+ *   data ID, counter from 0 to 15. The data ID is taken from the DataIDList
+ *   of 16 entries indexed by the counter. e2e_add() fills the list with
+ *   one value, e2e_set_data_id_list() sets the individual entries.
+ *
+ * Position of the CRC and the counter (low or high nibble of a byte) can be
+ * changed, E2E_NONE disables the check. The checks run before any filter,
+ * so violations are counted and reported (event E2E_EVENT) even if the
+ * messages themselves are not forwarded to the host.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+
+#define	E2E_EVENT			'e'
+
+#define	E2E_NONE			0xff	//!< no CRC or counter
+
+typedef enum {
+	E2E_PROFILE_1 = 1,
+	E2E_PROFILE_2 = 2
+} e2e_profile_t;
+
+// ----------------------------------------------------------------------------
+typedef struct {
+	uint32_t key;			//!< see id_table_key()
+	union {
+		uint16_t data_id;			//!< profile 1
+		uint8_t data_id_list[16];	//!< profile 2, indexed by the counter
+	};
+	uint8_t profile;
+	uint8_t crc_byte;
+	uint8_t counter_byte;
+	uint8_t counter_shift;	//!< 0 = low nibble, 4 = high nibble
+	uint8_t max_delta;		//!< largest allowed step of the counter
+	
+	uint8_t last_counter;
+	bool valid;				//!< last_counter is set
+	
+	uint16_t ok;
+	uint16_t crc_errors;
+	uint16_t repeated;		//!< same counter as the message before
+	uint16_t lost;			//!< counter jumped by more than max_delta
+	uint16_t length_errors;
+} e2e_entry_t;
+
+// ----------------------------------------------------------------------------
+// Adds an identifier with the default layout of the profile (CRC in byte 0,
+// counter in the low nibble of byte 1). Returns the number of the entry or
+// -1 if the table is full or the identifier is already checked. With
+// profile 2 all entries of the DataIDList get the low byte of data_id.
+
+extern int8_t e2e_add(uint32_t key, e2e_profile_t profile, uint16_t data_id);
+
+// ----------------------------------------------------------------------------
+// Sets the 16 data IDs of an entry with profile 2
+
+extern bool e2e_set_data_id_list(uint8_t n, const uint8_t *list);
+
+// ----------------------------------------------------------------------------
+// Profile 2 needs the counter to select the data ID, a CRC without a
+// counter is rejected there.
+
+extern bool e2e_set_layout(uint8_t n, uint8_t crc_byte, uint8_t counter_byte,
+		uint8_t counter_shift, uint8_t max_delta);
+
+// ----------------------------------------------------------------------------
+extern bool e2e_remove(uint8_t n);
+
+// ----------------------------------------------------------------------------
+extern void e2e_clear(void);
+
+// ----------------------------------------------------------------------------
+// Sets the counters of all entries to zero
+
+extern void e2e_reset(void);
+
+// ----------------------------------------------------------------------------
+extern uint8_t e2e_get_count(void);
+
+// ----------------------------------------------------------------------------
+extern const e2e_entry_t * e2e_get(uint8_t n);
+
+// ----------------------------------------------------------------------------
+// Checks a received message, has to see all messages
+
+extern void e2e_update(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+#if !SUPPORT_E2E
+	#define	e2e_update(msg)
+#endif
+
+#endif	// E2E_H
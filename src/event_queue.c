@@ -0,0 +1,75 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include "event_queue.h"
+
+#if (EVENT_QUEUE_SIZE & (EVENT_QUEUE_SIZE - 1)) != 0
+	#error	EVENT_QUEUE_SIZE must be a power of two
+#endif
+
+static event_t event_buffer[EVENT_QUEUE_SIZE];
+static uint8_t event_head;
+static uint8_t event_count;
+
+static uint16_t event_lost;
+
+// ----------------------------------------------------------------------------
+bool event_push(char type, char code, uint32_t key, int32_t value)
+{
+	if (event_count >= EVENT_QUEUE_SIZE) {
+		event_lost++;
+		return false;
+	}
+	
+	event_t *event = &event_buffer[(event_head + event_count) & (EVENT_QUEUE_SIZE - 1)];
+	event->type = type;
+	event->code = code;
+	event->key = key;
+	event->value = value;
+	
+	event_count++;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+const event_t * event_peek(void)
+{
+	if (event_count == 0)
+		return NULL;
+	
+	return &event_buffer[event_head];
+}
+
+// ----------------------------------------------------------------------------
+void event_commit(void)
+{
+	if (event_count == 0)
+		return;
+	
+	event_head = (event_head + 1) & (EVENT_QUEUE_SIZE - 1);
+	event_count--;
+}
+
+// ----------------------------------------------------------------------------
+uint16_t event_get_lost(void)
+{
+	return event_lost;
+}
@@ -0,0 +1,66 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	EVENT_QUEUE_H
+#define	EVENT_QUEUE_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Queue for events generated by the firmware itself
+ *
+ * Events are written to the host between the received messages. In the
+ * Lawicel protocol they are sent as "x" followed by the type, the code,
+ * the identifier (3 or 8 digits) and the value (8 digits), e.g.
+ * "xwm12300000064" (type 'w', code 'm', identifier 0x123, value 100).
+ *
+ * If the queue is full new events are lost and counted.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "config.h"
+
+// ----------------------------------------------------------------------------
+typedef struct {
+	char type;			//!< lower case letter of the extension, e.g. 'w'
+	char code;			//!< kind of event, defined by the extension
+	uint32_t key;		//!< identifier, see id_table_key() (or a number)
+	int32_t value;
+} event_t;
+
+// ----------------------------------------------------------------------------
+extern bool event_push(char type, char code, uint32_t key, int32_t value);
+
+// ----------------------------------------------------------------------------
+// Returns the oldest event or NULL if the queue is empty
+
+extern const event_t * event_peek(void);
+
+// ----------------------------------------------------------------------------
+extern void event_commit(void);
+
+// ----------------------------------------------------------------------------
+// Number of events lost because the queue was full
+
+extern uint16_t event_get_lost(void);
+
+#endif	// EVENT_QUEUE_H
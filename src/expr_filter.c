@@ -0,0 +1,533 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "expr_filter.h"
+
+// ----------------------------------------------------------------------------
+// Bytecode
+
+enum {
+	OP_END = 0,
+	OP_ID,			// lo (2), hi (2): standard identifier in range
+	OP_EXT_ID,		// lo (4), hi (4): extended identifier in range
+	OP_DLC,			// cmp, value
+	OP_BYTE,		// index, mask, cmp, value
+	OP_RTR,
+	OP_EXT,
+	OP_AND,
+	OP_OR,
+	OP_NOT,
+	OP_COUNT
+};
+
+enum {
+	CMP_EQ, CMP_NE, CMP_LT, CMP_LE, CMP_GT, CMP_GE
+};
+
+// estimated cycles of each instruction including the dispatch
+static const uint8_t op_cycles[OP_COUNT] PROGMEM = {
+	[OP_END] = 10,
+	[OP_ID] = 50,
+	[OP_EXT_ID] = 80,
+	[OP_DLC] = 35,
+	[OP_BYTE] = 50,
+	[OP_RTR] = 20,
+	[OP_EXT] = 20,
+	[OP_AND] = 20,
+	[OP_OR] = 20,
+	[OP_NOT] = 15,
+};
+
+// maximum depth of the stack (one bit per entry)
+#define	EXPR_STACK_DEPTH	16
+
+static uint8_t expr_code[EXPR_CODE_SIZE];
+static uint8_t expr_size;			// 0 = disabled
+static uint16_t expr_cycles;
+static uint16_t expr_dropped;
+
+static uint8_t ee_expr_size EEMEM = 0xff;
+static uint8_t ee_expr_code[EXPR_CODE_SIZE] EEMEM;
+
+// ----------------------------------------------------------------------------
+// Compiler
+
+typedef struct {
+	const char *start;
+	const char *s;
+	uint8_t *code;
+	uint8_t size;
+	uint8_t depth;
+	uint8_t max_depth;
+	uint16_t cycles;
+} expr_parser_t;
+
+static bool parse_or(expr_parser_t *p);
+
+// ----------------------------------------------------------------------------
+static void skip_space(expr_parser_t *p)
+{
+	while (*p->s == ' ')
+		p->s++;
+}
+
+// ----------------------------------------------------------------------------
+static bool accept(expr_parser_t *p, const char *token)
+{
+	skip_space(p);
+	
+	uint8_t length = strlen_P(token);
+	if (strncmp_P(p->s, token, length) != 0)
+		return false;
+	
+	p->s += length;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+static bool emit(expr_parser_t *p, uint8_t byte)
+{
+	if (p->size >= EXPR_CODE_SIZE - 1)		// space for OP_END
+		return false;
+	
+	p->code[p->size++] = byte;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+// Schreibt einen Befehl und passt die Tiefe des Stacks an (push = 1,
+// pop = -1)
+
+static bool emit_op(expr_parser_t *p, uint8_t op, int8_t stack)
+{
+	p->depth += stack;
+	if (p->depth > p->max_depth)
+		p->max_depth = p->depth;
+	
+	p->cycles += pgm_read_byte(&op_cycles[op]);
+	
+	return emit(p, op);
+}
+
+// ----------------------------------------------------------------------------
+static bool emit_value(expr_parser_t *p, uint32_t value, uint8_t bytes)
+{
+	while (bytes--) {
+		if (!emit(p, value))
+			return false;
+		value >>= 8;
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+static bool parse_number(expr_parser_t *p, uint32_t *value, uint8_t base, uint8_t *digits)
+{
+	uint8_t n = 0;
+	*value = 0;
+	
+	for (;; n++)
+	{
+		char c = tolower(p->s[n]);
+		uint8_t digit;
+		
+		if (c >= '0' && c <= '9')
+			digit = c - '0';
+		else if (base == 16 && c >= 'a' && c <= 'f')
+			digit = c - 'a' + 10;
+		else
+			break;
+		
+		*value = *value * base + digit;
+	}
+	
+	if (n == 0 || n > 8)
+		return false;
+	
+	p->s += n;
+	if (digits)
+		*digits = n;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+static bool parse_cmp(expr_parser_t *p, uint8_t *cmp)
+{
+	if (accept(p, PSTR("!=")))
+		*cmp = CMP_NE;
+	else if (accept(p, PSTR("<=")))
+		*cmp = CMP_LE;
+	else if (accept(p, PSTR(">=")))
+		*cmp = CMP_GE;
+	else if (accept(p, PSTR("==")) || accept(p, PSTR("=")))
+		*cmp = CMP_EQ;
+	else if (accept(p, PSTR("<")))
+		*cmp = CMP_LT;
+	else if (accept(p, PSTR(">")))
+		*cmp = CMP_GT;
+	else
+		return false;
+	
+	skip_space(p);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+static bool parse_test(expr_parser_t *p)
+{
+	uint32_t value;
+	uint8_t cmp;
+	
+	if (accept(p, PSTR("id")))
+	{
+		uint32_t hi;
+		uint8_t digits, digits_hi;
+		
+		if (!accept(p, PSTR("=")))
+			return false;
+		skip_space(p);
+		if (!parse_number(p, &value, 16, &digits))
+			return false;
+		
+		hi = value;
+		digits_hi = digits;
+		if (accept(p, PSTR("-"))) {
+			skip_space(p);
+			if (!parse_number(p, &hi, 16, &digits_hi) || hi < value)
+				return false;
+		}
+		
+		if (digits > 3 || digits_hi > 3) {
+			if (hi > 0x1fffffff)
+				return false;
+			return emit_op(p, OP_EXT_ID, 1) && emit_value(p, value, 4) && emit_value(p, hi, 4);
+		}
+		else {
+			if (hi > 0x7ff)
+				return false;
+			return emit_op(p, OP_ID, 1) && emit_value(p, value, 2) && emit_value(p, hi, 2);
+		}
+	}
+	else if (accept(p, PSTR("dlc")))
+	{
+		if (!parse_cmp(p, &cmp) || !parse_number(p, &value, 10, NULL) || value > 8)
+			return false;
+		
+		return emit_op(p, OP_DLC, 1) && emit(p, cmp) && emit(p, value);
+	}
+	else if (accept(p, PSTR("d")))
+	{
+		uint32_t index;
+		uint32_t mask = 0xff;
+		
+		if (!parse_number(p, &index, 10, NULL) || index > 7)
+			return false;
+		
+		if (accept(p, PSTR("."))) {
+			// bit test
+			if (!parse_number(p, &value, 10, NULL) || value > 7)
+				return false;
+			
+			mask = 1 << value;
+			cmp = CMP_NE;
+			value = 0;
+		}
+		else {
+			if (accept(p, PSTR(":"))) {
+				if (!parse_number(p, &mask, 16, NULL) || mask > 0xff)
+					return false;
+			}
+			if (!parse_cmp(p, &cmp) || !parse_number(p, &value, 16, NULL) || value > 0xff)
+				return false;
+		}
+		
+		return emit_op(p, OP_BYTE, 1) && emit(p, index) && emit(p, mask) &&
+				emit(p, cmp) && emit(p, value);
+	}
+	else if (accept(p, PSTR("rtr"))) {
+		return emit_op(p, OP_RTR, 1);
+	}
+	else if (accept(p, PSTR("ext"))) {
+		return emit_op(p, OP_EXT, 1);
+	}
+	
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+static bool parse_factor(expr_parser_t *p)
+{
+	if (accept(p, PSTR("!")))
+		return parse_factor(p) && emit_op(p, OP_NOT, 0);
+	
+	if (accept(p, PSTR("("))) {
+		if (!parse_or(p))
+			return false;
+		return accept(p, PSTR(")"));
+	}
+	
+	return parse_test(p);
+}
+
+// ----------------------------------------------------------------------------
+static bool parse_and(expr_parser_t *p)
+{
+	if (!parse_factor(p))
+		return false;
+	
+	while (accept(p, PSTR("&"))) {
+		if (!parse_factor(p) || !emit_op(p, OP_AND, -1))
+			return false;
+	}
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+static bool parse_or(expr_parser_t *p)
+{
+	if (!parse_and(p))
+		return false;
+	
+	while (accept(p, PSTR("|"))) {
+		if (!parse_and(p) || !emit_op(p, OP_OR, -1))
+			return false;
+	}
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+int8_t expr_compile(const char *str)
+{
+	uint8_t code[EXPR_CODE_SIZE];
+	expr_parser_t p = {
+		.start = str,
+		.s = str,
+		.code = code,
+	};
+	
+	bool ok = parse_or(&p);
+	skip_space(&p);
+	
+	if (!ok || *p.s != '\0' || p.max_depth > EXPR_STACK_DEPTH ||
+		p.cycles > EXPR_CYCLE_BUDGET)
+	{
+		uint8_t pos = p.s - p.start;
+		return (pos > 127) ? 127 : pos;
+	}
+	
+	code[p.size++] = OP_END;
+	p.cycles += pgm_read_byte(&op_cycles[OP_END]);
+	
+	// the RX path only sees the complete program
+	memcpy(expr_code, code, p.size);
+	expr_size = p.size;
+	expr_cycles = p.cycles;
+	expr_dropped = 0;
+	
+	return -1;
+}
+
+// ----------------------------------------------------------------------------
+void expr_disable(void)
+{
+	expr_size = 0;
+}
+
+// ----------------------------------------------------------------------------
+bool expr_is_enabled(void)
+{
+	return expr_size != 0;
+}
+
+// ----------------------------------------------------------------------------
+// Interpreter
+
+static bool expr_compare(uint8_t a, uint8_t cmp, uint8_t b)
+{
+	switch (cmp) {
+		case CMP_EQ: return a == b;
+		case CMP_NE: return a != b;
+		case CMP_LT: return a < b;
+		case CMP_LE: return a <= b;
+		case CMP_GT: return a > b;
+		default:     return a >= b;
+	}
+}
+
+// ----------------------------------------------------------------------------
+static uint32_t expr_read(const uint8_t *code, uint8_t bytes)
+{
+	uint32_t value = 0;
+	
+	while (bytes--)
+		value = (value << 8) | code[bytes];
+	
+	return value;
+}
+
+// ----------------------------------------------------------------------------
+bool expr_match(const can_t *msg)
+{
+	const uint8_t *pc = expr_code;
+	uint16_t stack = 0;		// top of the stack is bit 0
+	bool result;
+	
+	#if SUPPORT_EXTENDED_CANID
+	bool extended = msg->flags.extended;
+	#else
+	bool extended = false;
+	#endif
+	
+	for (;;)
+	{
+		switch (*pc++)
+		{
+			case OP_ID:
+				result = !extended && msg->id >= expr_read(pc, 2) &&
+						msg->id <= expr_read(pc + 2, 2);
+				pc += 4;
+				break;
+			
+			case OP_EXT_ID:
+				result = extended && msg->id >= expr_read(pc, 4) &&
+						msg->id <= expr_read(pc + 4, 4);
+				pc += 8;
+				break;
+			
+			case OP_DLC:
+				result = expr_compare(msg->length, pc[0], pc[1]);
+				pc += 2;
+				break;
+			
+			case OP_BYTE:
+				// bytes behind the DLC do not exist, the test is false
+				result = pc[0] < msg->length && !msg->flags.rtr &&
+						expr_compare(msg->data[pc[0]] & pc[1], pc[2], pc[3]);
+				pc += 4;
+				break;
+			
+			case OP_RTR:
+				result = msg->flags.rtr;
+				break;
+			
+			case OP_EXT:
+				result = extended;
+				break;
+			
+			case OP_AND:
+				result = (stack & 0x03) == 0x03;
+				stack >>= 2;
+				break;
+			
+			case OP_OR:
+				result = (stack & 0x03) != 0;
+				stack >>= 2;
+				break;
+			
+			case OP_NOT:
+				result = !(stack & 0x01);
+				stack >>= 1;
+				break;
+			
+			default:
+				return stack & 0x01;
+		}
+		
+		stack = (stack << 1) | result;
+	}
+}
+
+// ----------------------------------------------------------------------------
+bool expr_check(const can_t *msg)
+{
+	if (expr_size == 0 || expr_match(msg))
+		return true;
+	
+	expr_dropped++;
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t expr_get_size(void)
+{
+	return expr_size;
+}
+
+// ----------------------------------------------------------------------------
+uint16_t expr_get_cycles(void)
+{
+	return expr_cycles;
+}
+
+// ----------------------------------------------------------------------------
+uint16_t expr_get_dropped(void)
+{
+	return expr_dropped;
+}
+
+// ----------------------------------------------------------------------------
+void expr_save(void)
+{
+	eeprom_update_block(expr_code, ee_expr_code, expr_size);
+	eeprom_update_byte(&ee_expr_size, expr_size);
+}
+
+// ----------------------------------------------------------------------------
+void expr_load(void)
+{
+	uint8_t size = eeprom_read_byte(&ee_expr_size);
+	
+	if (size == 0 || size > EXPR_CODE_SIZE) {
+		expr_size = 0;
+		return;
+	}
+	
+	eeprom_read_block(expr_code, ee_expr_code, size);
+	
+	// the estimation is not stored, calculate it again
+	expr_cycles = 0;
+	for (uint8_t i = 0; i < size; )
+	{
+		uint8_t op = expr_code[i];
+		if (op >= OP_COUNT) {
+			expr_size = 0;
+			return;
+		}
+		expr_cycles += pgm_read_byte(&op_cycles[op]);
+		
+		switch (op) {
+			case OP_ID:     i += 5; break;
+			case OP_EXT_ID: i += 9; break;
+			case OP_DLC:    i += 3; break;
+			case OP_BYTE:   i += 5; break;
+			default:        i += 1; break;
+		}
+	}
+	
+	expr_size = size;
+}
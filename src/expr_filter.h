@@ -0,0 +1,102 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	EXPR_FILTER_H
+#define	EXPR_FILTER_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Filter expressions compiled to bytecode
+ *
+ * An expression like "id=100-1ff & d0.7 & dlc=8" is compiled into a
+ * postfix bytecode of at most EXPR_CODE_SIZE bytes which is evaluated
+ * for every received message. Messages for which the expression is false
+ * are dropped.
+ *
+ * Syntax:
+ * \code
+ * expr   := term { "|" term }
+ * term   := factor { "&" factor }
+ * factor := "!" factor | "(" expr ")" | test
+ * test   := "id=" hex [ "-" hex ]		(more than 3 digits: extended)
+ *         | "dlc" cmp dec
+ *         | "d" n [ ":" mask ] cmp hex	(data byte n, optionally masked)
+ *         | "d" n "." bit				(bit of data byte n is set)
+ *         | "rtr" | "ext"
+ * cmp    := "=" | "!=" | "<" | "<=" | ">" | ">="
+ * \endcode
+ *
+ * The compiler estimates the worst case number of CPU cycles of the
+ * program and rejects programs above EXPR_CYCLE_BUDGET.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+
+// ----------------------------------------------------------------------------
+// Compiles and activates the expression. On errors the old expression is
+// kept and the position of the error in str is returned, otherwise -1.
+
+extern int8_t expr_compile(const char *str);
+
+// ----------------------------------------------------------------------------
+extern void expr_disable(void);
+
+// ----------------------------------------------------------------------------
+extern bool expr_is_enabled(void);
+
+// ----------------------------------------------------------------------------
+// Evaluates the active expression without counting
+
+extern bool expr_match(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+// Returns true if the message should be forwarded
+
+extern bool expr_check(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+// Size of the active program in bytes
+
+extern uint8_t expr_get_size(void);
+
+// ----------------------------------------------------------------------------
+// Estimated number of cycles of the active program (worst case)
+
+extern uint16_t expr_get_cycles(void);
+
+// ----------------------------------------------------------------------------
+// Number of messages dropped by the expression
+
+extern uint16_t expr_get_dropped(void);
+
+// ----------------------------------------------------------------------------
+// Stores the active program in the EEPROM. expr_load() is called after
+// reset and activates it again.
+
+extern void expr_save(void);
+
+// ----------------------------------------------------------------------------
+extern void expr_load(void);
+
+#endif	// EXPR_FILTER_H
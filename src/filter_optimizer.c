@@ -0,0 +1,136 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include "filter_optimizer.h"
+
+// ----------------------------------------------------------------------------
+static uint32_t filter_full_mask(bool extended)
+{
+	return (extended) ? 0x1fffffff : 0x7ff;
+}
+
+// ----------------------------------------------------------------------------
+void filter_group_init(filter_group_t *group, uint32_t id, bool extended)
+{
+	group->mask = filter_full_mask(extended);
+	group->id = id & group->mask;
+	group->extended = extended;
+}
+
+// ----------------------------------------------------------------------------
+uint32_t filter_group_size(const filter_group_t *group)
+{
+	uint32_t free = ~group->mask & filter_full_mask(group->extended);
+	uint32_t size = 1;
+	
+	while (free) {
+		if (free & 1)
+			size <<= 1;
+		free >>= 1;
+	}
+	
+	return size;
+}
+
+// ----------------------------------------------------------------------------
+bool filter_group_covers(const filter_group_t *a, const filter_group_t *b)
+{
+	return (a->extended == b->extended &&
+			(b->mask & a->mask) == a->mask &&
+			(b->id & a->mask) == a->id);
+}
+
+// ----------------------------------------------------------------------------
+static void filter_group_merge(filter_group_t *result, const filter_group_t *a,
+		const filter_group_t *b)
+{
+	result->mask = a->mask & b->mask & ~(a->id ^ b->id);
+	result->id = a->id & result->mask;
+	result->extended = a->extended;
+}
+
+// ----------------------------------------------------------------------------
+// Entfernt alle Gruppen die von der Gruppe n bereits abgedeckt werden
+
+static uint8_t filter_remove_covered(filter_group_t *groups, uint8_t count, uint8_t n)
+{
+	uint8_t i = 0;
+	
+	while (i < count)
+	{
+		if (i != n && filter_group_covers(&groups[n], &groups[i])) {
+			count--;
+			groups[i] = groups[count];
+			
+			// the group n may have been moved
+			if (n == count)
+				n = i;
+			continue;
+		}
+		i++;
+	}
+	
+	return count;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t filter_optimize(filter_group_t *groups, uint8_t count, uint8_t max)
+{
+	// remove duplicates
+	for (uint8_t i = 0; i < count; i++)
+		count = filter_remove_covered(groups, count, i);
+	
+	while (count > max)
+	{
+		uint8_t best_a = 0;
+		uint8_t best_b = 0;
+		int32_t best_cost = INT32_MAX;
+		
+		for (uint8_t a = 0; a < count; a++)
+		{
+			for (uint8_t b = a + 1; b < count; b++)
+			{
+				if (groups[a].extended != groups[b].extended)
+					continue;
+				
+				filter_group_t merged;
+				filter_group_merge(&merged, &groups[a], &groups[b]);
+				
+				// additional identifiers let through by the merged filter
+				int32_t cost = filter_group_size(&merged) -
+						filter_group_size(&groups[a]) - filter_group_size(&groups[b]);
+				
+				if (cost < best_cost) {
+					best_cost = cost;
+					best_a = a;
+					best_b = b;
+				}
+			}
+		}
+		
+		if (best_cost == INT32_MAX)
+			return 0;		// only filters of different types left
+		
+		filter_group_merge(&groups[best_a], &groups[best_a], &groups[best_b]);
+		count = filter_remove_covered(groups, count, best_a);
+	}
+	
+	return count;
+}
@@ -0,0 +1,69 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	FILTER_OPTIMIZER_H
+#define	FILTER_OPTIMIZER_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Calculates hardware filters for a list of identifiers
+ *
+ * Starting with one filter for each identifier, the two filters whose
+ * combination lets through the fewest additional identifiers are merged
+ * until the given number of filters is reached (greedy merging). The
+ * mask of a merged filter contains only the bits equal in both filters.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+
+// ----------------------------------------------------------------------------
+typedef struct {
+	uint32_t id;
+	uint32_t mask;
+	bool extended;
+} filter_group_t;
+
+// ----------------------------------------------------------------------------
+// Fills the entry with a filter for exactly one identifier
+
+extern void filter_group_init(filter_group_t *group, uint32_t id, bool extended);
+
+// ----------------------------------------------------------------------------
+// Number of identifiers let through by the filter
+
+extern uint32_t filter_group_size(const filter_group_t *group);
+
+// ----------------------------------------------------------------------------
+// Returns true if all identifiers let through by b are also let through
+// by a
+
+extern bool filter_group_covers(const filter_group_t *a, const filter_group_t *b);
+
+// ----------------------------------------------------------------------------
+// Reduces the count filters in groups to at most max filters. Returns the
+// new number of filters or 0 if this is not possible (standard and
+// extended identifiers are never merged).
+
+extern uint8_t filter_optimize(filter_group_t *groups, uint8_t count, uint8_t max);
+
+#endif	// FILTER_OPTIMIZER_H
@@ -0,0 +1,216 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "gateway.h"
+#include "tx_queue.h"
+
+#if SUPPORT_GATEWAY
+
+static gateway_rule_t gateway_rule[GATEWAY_COUNT];
+static uint8_t gateway_count;
+
+// ----------------------------------------------------------------------------
+int8_t gateway_add(const capture_trigger_t *match)
+{
+	if (gateway_count >= GATEWAY_COUNT)
+		return -1;
+	
+	gateway_rule_t *rule = &gateway_rule[gateway_count];
+	
+	memset(rule, 0, sizeof(gateway_rule_t));
+	rule->match = *match;
+	rule->scale_byte = GATEWAY_NO_SCALE;
+	
+	return gateway_count++;
+}
+
+// ----------------------------------------------------------------------------
+bool gateway_set_id(uint8_t n, uint32_t id, uint32_t mask)
+{
+	if (n >= gateway_count)
+		return false;
+	
+	gateway_rule[n].id = id & mask;
+	gateway_rule[n].id_mask = mask;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+bool gateway_set_patch(uint8_t n, const uint8_t *data, const uint8_t *mask)
+{
+	if (n >= gateway_count)
+		return false;
+	
+	for (uint8_t i = 0; i < 8; i++) {
+		gateway_rule[n].patch[i] = data[i] & mask[i];
+		gateway_rule[n].patch_mask[i] = mask[i];
+	}
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+bool gateway_set_scale(uint8_t n, uint8_t byte, uint8_t length,
+		bool big_endian, int16_t factor, int16_t offset)
+{
+	if (n >= gateway_count)
+		return false;
+	
+	if (byte != GATEWAY_NO_SCALE && (length == 0 || length > 2 || byte + length > 8))
+		return false;
+	
+	gateway_rule_t *rule = &gateway_rule[n];
+	
+	rule->scale_byte = byte;
+	rule->scale_length = length;
+	rule->scale_big_endian = big_endian;
+	rule->scale_factor = factor;
+	rule->scale_offset = offset;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+bool gateway_remove(uint8_t n)
+{
+	if (n >= gateway_count)
+		return false;
+	
+	gateway_count--;
+	memmove(&gateway_rule[n], &gateway_rule[n + 1],
+			(gateway_count - n) * sizeof(gateway_rule_t));
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+void gateway_clear(void)
+{
+	gateway_count = 0;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t gateway_get_count(void)
+{
+	return gateway_count;
+}
+
+// ----------------------------------------------------------------------------
+const gateway_rule_t * gateway_get(uint8_t n)
+{
+	return &gateway_rule[n];
+}
+
+// ----------------------------------------------------------------------------
+// Skaliert ein vorzeichenloses Feld, das Ergebnis wird auf den
+// Wertebereich des Feldes begrenzt
+
+static void gateway_scale(const gateway_rule_t *rule, uint8_t *data)
+{
+	uint8_t length = rule->scale_length;
+	uint8_t *p = &data[rule->scale_byte];
+	uint16_t raw = 0;
+	
+	if (rule->scale_big_endian) {
+		for (uint8_t i = 0; i < length; i++)
+			raw = (raw << 8) | p[i];
+	}
+	else {
+		for (uint8_t i = length; i > 0; i--)
+			raw = (raw << 8) | p[i - 1];
+	}
+	
+	int32_t value = (((int32_t) raw * rule->scale_factor) >> 8) + rule->scale_offset;
+	int32_t max = (length == 2) ? 0xffff : 0xff;
+	
+	if (value < 0)
+		raw = 0;
+	else if (value > max)
+		raw = max;
+	else
+		raw = value;
+	
+	if (rule->scale_big_endian) {
+		for (uint8_t i = length; i > 0; i--, raw >>= 8)
+			p[i - 1] = raw;
+	}
+	else {
+		for (uint8_t i = 0; i < length; i++, raw >>= 8)
+			p[i] = raw;
+	}
+}
+
+// ----------------------------------------------------------------------------
+void gateway_update(const can_t *msg)
+{
+	if (msg->flags.rtr)
+		return;
+	
+	for (uint8_t i = 0; i < gateway_count; i++)
+	{
+		gateway_rule_t *rule = &gateway_rule[i];
+		
+		if (!capture_match(&rule->match, msg))
+			continue;
+		
+		can_t copy = *msg;
+		
+		copy.id = (copy.id & ~rule->id_mask) | rule->id;
+		
+		for (uint8_t j = 0; j < copy.length; j++)
+			copy.data[j] = (copy.data[j] & ~rule->patch_mask[j]) | rule->patch[j];
+		
+		if (rule->scale_byte + rule->scale_length <= copy.length)
+			gateway_scale(rule, copy.data);
+		
+		// the copy keeps the time stamp of the reception, the TX queue
+		// reports it together with the end of the transmission
+		const tx_options_t options = {
+			.queue = GATEWAY_TX_QUEUE,
+			.timeout = 0,
+			.one_shot = false,
+			.tag = TX_TAG_GATEWAY | i
+		};
+		
+		if (tx_queue_send(&copy, &options))
+			tx_queue_pump();
+		
+		rule->hits++;
+	}
+}
+
+// ----------------------------------------------------------------------------
+void gateway_tx_done(uint8_t n, uint32_t received, uint32_t sent)
+{
+	if (n >= gateway_count)
+		return;
+	
+	gateway_rule_t *rule = &gateway_rule[n];
+	uint32_t latency = (sent - received) * 4;
+	
+	rule->latency = (latency > 0xffff) ? 0xffff : latency;
+	if (rule->latency > rule->latency_max)
+		rule->latency_max = rule->latency;
+}
+
+#endif	// SUPPORT_GATEWAY
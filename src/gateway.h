@@ -0,0 +1,129 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	GATEWAY_H
+#define	GATEWAY_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Rewriting and retransmission of received messages
+ *
+ * Each rule matches received messages like a trigger of the capture. A
+ * matching message is modified and put into the TX queue directly from
+ * the receive path:
+ *
+ *  - the bits of the identifier selected by id_mask are replaced
+ *  - the bits of the data bytes selected by patch_mask are replaced
+ *  - an unsigned field of 1 or 2 bytes is scaled with factor / 256 and an
+ *    offset, the result is limited to the size of the field (the field is
+ *    limited to 16 bit to keep the calculation in 32 bit)
+ *
+ * For each rule the hits and the time between the reception of the
+ * message and the end of the transmission of the copy are recorded. Both
+ * are taken from the time stamps of the MObs (CANTIM), so the latency
+ * includes the waiting time in the TX queue and the arbitration but not
+ * the polling interval of the main loop. Values above one overflow of
+ * CANTIM are not valid.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+#include "capture.h"
+
+#define	GATEWAY_NO_SCALE	0xff
+
+// the number of the rule is reported in the tag of the TX queue
+#if GATEWAY_COUNT > 16
+	#error	GATEWAY_COUNT too large
+#endif
+
+#if SUPPORT_GATEWAY && !SUPPORT_TIMESTAMPS
+	#error	the gateway needs SUPPORT_TIMESTAMPS
+#endif
+
+// ----------------------------------------------------------------------------
+typedef struct {
+	capture_trigger_t match;
+	uint32_t id;
+	uint32_t id_mask;		//!< bits of the identifier taken from id
+	uint8_t patch[8];
+	uint8_t patch_mask[8];
+	uint8_t scale_byte;		//!< first byte of the field or GATEWAY_NO_SCALE
+	uint8_t scale_length;	//!< 1 or 2 bytes
+	bool scale_big_endian;
+	int16_t scale_factor;	//!< 256 = 1.0
+	int16_t scale_offset;
+	
+	uint32_t hits;
+	uint16_t latency;		//!< latency of the last copy in us
+	uint16_t latency_max;
+} gateway_rule_t;
+
+// ----------------------------------------------------------------------------
+// Adds a rule which retransmits the matching messages unchanged. Returns
+// the number of the rule or -1 if the table is full.
+
+extern int8_t gateway_add(const capture_trigger_t *match);
+
+// ----------------------------------------------------------------------------
+extern bool gateway_set_id(uint8_t n, uint32_t id, uint32_t mask);
+
+// ----------------------------------------------------------------------------
+extern bool gateway_set_patch(uint8_t n, const uint8_t *data, const uint8_t *mask);
+
+// ----------------------------------------------------------------------------
+// With byte = GATEWAY_NO_SCALE the scaling is disabled.
+
+extern bool gateway_set_scale(uint8_t n, uint8_t byte, uint8_t length,
+		bool big_endian, int16_t factor, int16_t offset);
+
+// ----------------------------------------------------------------------------
+extern bool gateway_remove(uint8_t n);
+
+// ----------------------------------------------------------------------------
+extern void gateway_clear(void);
+
+// ----------------------------------------------------------------------------
+extern uint8_t gateway_get_count(void);
+
+// ----------------------------------------------------------------------------
+extern const gateway_rule_t * gateway_get(uint8_t n);
+
+// ----------------------------------------------------------------------------
+// Checks the rules for a received message
+
+extern void gateway_update(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+// Called by the TX queue when the copy of rule n was transmitted, both
+// times in ticks of systime_ticks()
+
+extern void gateway_tx_done(uint8_t n, uint32_t received, uint32_t sent);
+
+// ----------------------------------------------------------------------------
+#if !SUPPORT_GATEWAY
+	#define	gateway_update(msg)
+	#define	gateway_tx_done(n, received, sent)
+#endif
+
+#endif	// GATEWAY_H
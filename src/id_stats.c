@@ -0,0 +1,103 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "id_stats.h"
+#include "systime.h"
+
+#if (ID_STATS_SIZE & (ID_STATS_SIZE - 1)) != 0
+	#error	ID_STATS_SIZE must be a power of two
+#endif
+
+static uint32_t stats_keys[ID_STATS_SIZE];
+static id_stats_t stats[ID_STATS_SIZE];
+
+static uint16_t stats_evictions;
+
+// ----------------------------------------------------------------------------
+void id_stats_clear(void)
+{
+	id_table_clear(stats_keys, ID_STATS_SIZE);
+	stats_evictions = 0;
+}
+
+// ----------------------------------------------------------------------------
+void id_stats_update(const can_t *msg, uint8_t filter)
+{
+	id_table_result_t result;
+	uint8_t slot = id_table_insert(stats_keys, ID_STATS_SIZE,
+			id_table_key(msg), &result);
+	
+	id_stats_t *entry = &stats[slot];
+	uint16_t now = systime_ms();
+	
+	if (result != ID_TABLE_FOUND)
+	{
+		if (result == ID_TABLE_EVICTED)
+			stats_evictions++;
+		
+		memset(entry, 0, sizeof(id_stats_t));
+		entry->min = 0xffff;
+	}
+	else {
+		uint16_t interval = now - entry->time;
+		
+		entry->sum += interval;
+		if (interval < entry->min)
+			entry->min = interval;
+		if (interval > entry->max)
+			entry->max = interval;
+	}
+	
+	entry->count++;
+	entry->time = now;
+	entry->length = msg->length;
+	#if CAN_RX_BUFFER_SIZE == 0
+	entry->filter = filter;
+	#endif
+}
+
+// ----------------------------------------------------------------------------
+uint32_t id_stats_get_key(uint8_t n)
+{
+	return stats_keys[n];
+}
+
+// ----------------------------------------------------------------------------
+const id_stats_t * id_stats_get(uint8_t n)
+{
+	return &stats[n];
+}
+
+// ----------------------------------------------------------------------------
+uint16_t id_stats_get_mean(const id_stats_t *entry)
+{
+	if (entry->count < 2)
+		return 0;
+	
+	return entry->sum / (entry->count - 1);
+}
+
+// ----------------------------------------------------------------------------
+uint16_t id_stats_get_evictions(void)
+{
+	return stats_evictions;
+}
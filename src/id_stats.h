@@ -0,0 +1,83 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	ID_STATS_H
+#define	ID_STATS_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Statistics for each received identifier
+ *
+ * For up to ID_STATS_SIZE identifiers the number of messages, the time
+ * between them and the last length and filter code are collected. All
+ * received messages are counted, also those dropped later by the
+ * software filters. The filter code (the MOb) is only known without the
+ * receive buffer of the CAN library (CAN_RX_BUFFER_SIZE == 0).
+ *
+ * Times are measured in ms with systime_ms(), intervals longer than 65 s
+ * are not measured correctly.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+#include "id_table.h"
+
+// ----------------------------------------------------------------------------
+typedef struct {
+	uint32_t count;
+	uint32_t sum;			//!< sum of all intervals
+	uint16_t time;			//!< time of the last message
+	uint16_t min;			//!< shortest interval
+	uint16_t max;			//!< longest interval
+	uint8_t length;			//!< DLC of the last message
+#if CAN_RX_BUFFER_SIZE == 0
+	uint8_t filter;			//!< filter code of the last message
+#endif
+} id_stats_t;
+
+// ----------------------------------------------------------------------------
+extern void id_stats_clear(void);
+
+// ----------------------------------------------------------------------------
+extern void id_stats_update(const can_t *msg, uint8_t filter);
+
+// ----------------------------------------------------------------------------
+// Returns the key (see id_table_key()) of the entry n or ID_TABLE_EMPTY
+// if the entry is not used. n = 0..ID_STATS_SIZE-1
+
+extern uint32_t id_stats_get_key(uint8_t n);
+
+// ----------------------------------------------------------------------------
+extern const id_stats_t * id_stats_get(uint8_t n);
+
+// ----------------------------------------------------------------------------
+// Mean interval in ms, 0 if less than two messages were received
+
+extern uint16_t id_stats_get_mean(const id_stats_t *stats);
+
+// ----------------------------------------------------------------------------
+// Number of identifiers which replaced another one in the table
+
+extern uint16_t id_stats_get_evictions(void);
+
+#endif	// ID_STATS_H
@@ -0,0 +1,86 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include "id_table.h"
+
+// ----------------------------------------------------------------------------
+// Folds the four bytes of the key, the multiplication spreads the upper
+// bits of standard identifiers over the whole byte.
+
+static uint8_t id_table_hash(uint32_t key, uint8_t size)
+{
+	uint8_t hash = (uint8_t) key ^ ((uint8_t) (key >> 8) * 0x9d) ^
+			(uint8_t) (key >> 16) ^ (uint8_t) (key >> 24);
+	
+	return hash & (size - 1);
+}
+
+// ----------------------------------------------------------------------------
+void id_table_clear(uint32_t *keys, uint8_t size)
+{
+	for (uint8_t i = 0; i < size; i++)
+		keys[i] = ID_TABLE_EMPTY;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t id_table_find(const uint32_t *keys, uint8_t size, uint32_t key)
+{
+	uint8_t slot = id_table_hash(key, size);
+	
+	for (uint8_t i = 0; i < ID_TABLE_PROBES && i < size; i++)
+	{
+		if (keys[slot] == key)
+			return slot;
+		if (keys[slot] == ID_TABLE_EMPTY)
+			break;
+		
+		slot = (slot + 1) & (size - 1);
+	}
+	
+	return ID_TABLE_NONE;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t id_table_insert(uint32_t *keys, uint8_t size, uint32_t key,
+		id_table_result_t *result)
+{
+	uint8_t home = id_table_hash(key, size);
+	uint8_t slot = home;
+	
+	for (uint8_t i = 0; i < ID_TABLE_PROBES && i < size; i++)
+	{
+		if (keys[slot] == key) {
+			*result = ID_TABLE_FOUND;
+			return slot;
+		}
+		if (keys[slot] == ID_TABLE_EMPTY) {
+			keys[slot] = key;
+			*result = ID_TABLE_NEW;
+			return slot;
+		}
+		
+		slot = (slot + 1) & (size - 1);
+	}
+	
+	keys[home] = key;
+	*result = ID_TABLE_EVICTED;
+	
+	return home;
+}
@@ -0,0 +1,83 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	ID_TABLE_H
+#define	ID_TABLE_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Small hash tables with the CAN identifier as key
+ *
+ * Only the keys are stored here, the user keeps the values in an array
+ * of the same size and uses the returned slot as index. A key is searched
+ * in ID_TABLE_PROBES consecutive slots. If none of them is free the first
+ * one is reused, so the table never gets full but may forget identifiers
+ * (eviction).
+ *
+ * The size of the tables must be a power of two.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+
+#define	ID_TABLE_PROBES		4
+
+#define	ID_TABLE_EMPTY		0xffffffff
+#define	ID_TABLE_NONE		0xff
+
+// ----------------------------------------------------------------------------
+typedef enum {
+	ID_TABLE_FOUND,		//!< key was already in the table
+	ID_TABLE_NEW,		//!< key was added to a free slot
+	ID_TABLE_EVICTED	//!< key replaced the key of another identifier
+} id_table_result_t;
+
+// ----------------------------------------------------------------------------
+// Combines identifier and type of the message to a key
+
+static inline uint32_t id_table_key(const can_t *msg)
+{
+	#if SUPPORT_EXTENDED_CANID
+	if (msg->flags.extended)
+		return msg->id | 0x80000000;
+	#endif
+	
+	return msg->id;
+}
+
+// ----------------------------------------------------------------------------
+extern void id_table_clear(uint32_t *keys, uint8_t size);
+
+// ----------------------------------------------------------------------------
+// Returns the slot of the key or ID_TABLE_NONE if it is not in the table
+
+extern uint8_t id_table_find(const uint32_t *keys, uint8_t size, uint32_t key);
+
+// ----------------------------------------------------------------------------
+// Returns the slot of the key. If the key is not in the table it is
+// added, result tells whether the values of the slot are valid.
+
+extern uint8_t id_table_insert(uint32_t *keys, uint8_t size, uint32_t key,
+		id_table_result_t *result);
+
+#endif	// ID_TABLE_H
@@ -0,0 +1,192 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "idfilter.h"
+
+static uint8_t idfilter_bitmap[2048 / 8];
+static uint16_t idfilter_standard_count;
+
+static uint32_t idfilter_extended[IDFILTER_EXTENDED_SIZE];
+static uint8_t idfilter_extended_count;
+
+static idfilter_mode_t idfilter_mode;
+static uint16_t idfilter_dropped;
+
+// ----------------------------------------------------------------------------
+// Returns the position of the identifier in the table or the position
+// where it has to be inserted.
+
+static uint8_t idfilter_search(uint32_t id)
+{
+	uint8_t low = 0;
+	uint8_t high = idfilter_extended_count;
+	
+	while (low < high)
+	{
+		uint8_t mid = (low + high) / 2;
+		
+		if (idfilter_extended[mid] < id)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	
+	return low;
+}
+
+// ----------------------------------------------------------------------------
+void idfilter_set_mode(idfilter_mode_t mode)
+{
+	idfilter_mode = mode;
+}
+
+// ----------------------------------------------------------------------------
+idfilter_mode_t idfilter_get_mode(void)
+{
+	return idfilter_mode;
+}
+
+// ----------------------------------------------------------------------------
+void idfilter_clear(void)
+{
+	memset(idfilter_bitmap, 0, sizeof(idfilter_bitmap));
+	idfilter_standard_count = 0;
+	idfilter_extended_count = 0;
+}
+
+// ----------------------------------------------------------------------------
+bool idfilter_add(uint32_t id, bool extended)
+{
+	if (!extended)
+	{
+		if (id > 0x7ff)
+			return false;
+		
+		uint8_t mask = 1 << (id & 7);
+		if (!(idfilter_bitmap[id >> 3] & mask)) {
+			idfilter_bitmap[id >> 3] |= mask;
+			idfilter_standard_count++;
+		}
+		return true;
+	}
+	
+	if (id > 0x1fffffff)
+		return false;
+	
+	uint8_t pos = idfilter_search(id);
+	if (pos < idfilter_extended_count && idfilter_extended[pos] == id)
+		return true;
+	
+	if (idfilter_extended_count >= IDFILTER_EXTENDED_SIZE)
+		return false;
+	
+	memmove(&idfilter_extended[pos + 1], &idfilter_extended[pos],
+			(idfilter_extended_count - pos) * sizeof(uint32_t));
+	idfilter_extended[pos] = id;
+	idfilter_extended_count++;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+bool idfilter_remove(uint32_t id, bool extended)
+{
+	if (!idfilter_contains(id, extended))
+		return false;
+	
+	if (!extended) {
+		idfilter_bitmap[id >> 3] &= ~(1 << (id & 7));
+		idfilter_standard_count--;
+	}
+	else {
+		uint8_t pos = idfilter_search(id);
+		
+		idfilter_extended_count--;
+		memmove(&idfilter_extended[pos], &idfilter_extended[pos + 1],
+				(idfilter_extended_count - pos) * sizeof(uint32_t));
+	}
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+bool idfilter_contains(uint32_t id, bool extended)
+{
+	if (!extended) {
+		if (id > 0x7ff)
+			return false;
+		
+		return (idfilter_bitmap[id >> 3] & (1 << (id & 7))) != 0;
+	}
+	
+	uint8_t pos = idfilter_search(id);
+	return (pos < idfilter_extended_count && idfilter_extended[pos] == id);
+}
+
+// ----------------------------------------------------------------------------
+bool idfilter_check(const can_t *msg)
+{
+	if (idfilter_mode == IDFILTER_OFF)
+		return true;
+	
+	bool found;
+	#if SUPPORT_EXTENDED_CANID
+	if (msg->flags.extended)
+		found = idfilter_contains(msg->id, true);
+	else
+	#endif
+	{
+		// kurzer Weg fuer Standard-IDs, nur ein Zugriff auf die Bitmap
+		uint16_t id = msg->id;
+		found = (idfilter_bitmap[id >> 3] & (1 << (id & 7))) != 0;
+	}
+	
+	if (found == (idfilter_mode == IDFILTER_ALLOW))
+		return true;
+	
+	idfilter_dropped++;
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+uint16_t idfilter_get_standard_count(void)
+{
+	return idfilter_standard_count;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t idfilter_get_extended_count(void)
+{
+	return idfilter_extended_count;
+}
+
+// ----------------------------------------------------------------------------
+uint32_t idfilter_get_extended(uint8_t n)
+{
+	return idfilter_extended[n];
+}
+
+// ----------------------------------------------------------------------------
+uint16_t idfilter_get_dropped(void)
+{
+	return idfilter_dropped;
+}
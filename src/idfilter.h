@@ -0,0 +1,93 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	IDFILTER_H
+#define	IDFILTER_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Software filter for received messages
+ *
+ * Second stage behind the 15 MObs of the CAN controller. Standard
+ * identifiers are kept in a bitmap with one bit for each of the 2048
+ * identifiers, extended identifiers in a sorted table which is searched
+ * binary. Depending on the mode only the listed identifiers are passed
+ * (allow) or all others (deny). Rejected messages are dropped before they
+ * are queued for the output.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+
+// ----------------------------------------------------------------------------
+typedef enum {
+	IDFILTER_OFF = 0,
+	IDFILTER_ALLOW = 1,
+	IDFILTER_DENY = 2
+} idfilter_mode_t;
+
+// ----------------------------------------------------------------------------
+extern void idfilter_set_mode(idfilter_mode_t mode);
+
+// ----------------------------------------------------------------------------
+extern idfilter_mode_t idfilter_get_mode(void);
+
+// ----------------------------------------------------------------------------
+// Removes all identifiers from the lists
+
+extern void idfilter_clear(void);
+
+// ----------------------------------------------------------------------------
+// Adds an identifier. Returns false if the identifier is invalid or the
+// table for extended identifiers is full.
+
+extern bool idfilter_add(uint32_t id, bool extended);
+
+// ----------------------------------------------------------------------------
+extern bool idfilter_remove(uint32_t id, bool extended);
+
+// ----------------------------------------------------------------------------
+extern bool idfilter_contains(uint32_t id, bool extended);
+
+// ----------------------------------------------------------------------------
+// Returns true if the message should be forwarded
+
+extern bool idfilter_check(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+extern uint16_t idfilter_get_standard_count(void);
+
+// ----------------------------------------------------------------------------
+extern uint8_t idfilter_get_extended_count(void);
+
+// ----------------------------------------------------------------------------
+// Returns the n-th extended identifier in ascending order
+
+extern uint32_t idfilter_get_extended(uint8_t n);
+
+// ----------------------------------------------------------------------------
+// Number of messages dropped by the filter
+
+extern uint16_t idfilter_get_dropped(void);
+
+#endif	// IDFILTER_H
@@ -0,0 +1,420 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "isotp.h"
+#include "id_table.h"
+#include "event_queue.h"
+#include "tx_queue.h"
+#include "systime.h"
+
+#if SUPPORT_ISOTP
+
+// protocol control information
+#define	PCI_SINGLE			0
+#define	PCI_FIRST			1
+#define	PCI_CONSECUTIVE		2
+#define	PCI_FLOW_CONTROL	3
+
+#define	FC_CONTINUE			0
+#define	FC_WAIT				1
+#define	FC_OVERFLOW			2
+
+#if ISOTP_TX_SIZE > 255
+	#error	ISOTP_TX_SIZE must not be larger than 255
+#endif
+
+typedef enum {
+	RX_IDLE,
+	RX_RECEIVING,
+	RX_DONE				// PDU waits for the host
+} isotp_rx_state_t;
+
+typedef enum {
+	TX_IDLE,
+	TX_WAIT_FC,
+	TX_SENDING
+} isotp_tx_state_t;
+
+typedef struct {
+	isotp_config_t config;
+	bool open;
+	
+	uint8_t rx_state;
+	uint8_t rx_sn;
+	uint8_t rx_block;		// frames until the next flow control
+	uint16_t rx_length;
+	uint16_t rx_pos;
+	uint16_t rx_deadline;
+	uint8_t rx_buffer[ISOTP_RX_SIZE];
+	
+	uint8_t tx_state;
+	uint8_t tx_sn;
+	uint8_t tx_block_size;
+	uint8_t tx_block;
+	uint8_t tx_length;
+	uint8_t tx_pos;
+	uint16_t tx_deadline;
+	uint16_t tx_st_min;		// in ticks of 4 us
+	uint32_t tx_next;
+	uint8_t tx_buffer[ISOTP_TX_SIZE];
+} isotp_channel_t;
+
+static isotp_channel_t isotp_channel[ISOTP_CHANNELS];
+
+static const tx_options_t isotp_tx_options = {
+	.queue = ISOTP_TX_QUEUE,
+	.timeout = 0,
+	.one_shot = false
+};
+
+// ----------------------------------------------------------------------------
+bool isotp_open(uint8_t channel, const isotp_config_t *config)
+{
+	if (channel >= ISOTP_CHANNELS || config->tx_key == config->rx_key)
+		return false;
+	
+	isotp_channel_t *ch = &isotp_channel[channel];
+	
+	ch->config = *config;
+	ch->rx_state = RX_IDLE;
+	ch->tx_state = TX_IDLE;
+	ch->open = true;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+void isotp_close(uint8_t channel)
+{
+	if (channel < ISOTP_CHANNELS)
+		isotp_channel[channel].open = false;
+}
+
+// ----------------------------------------------------------------------------
+const isotp_config_t * isotp_get_config(uint8_t channel)
+{
+	if (channel >= ISOTP_CHANNELS || !isotp_channel[channel].open)
+		return NULL;
+	
+	return &isotp_channel[channel].config;
+}
+
+// ----------------------------------------------------------------------------
+// Verschickt einen Frame mit der TX Identifier des Kanals. Die Daten
+// werden immer auf 8 Byte aufgefuellt.
+
+static void isotp_send_frame(isotp_channel_t *ch, const uint8_t *data, uint8_t length)
+{
+	can_t msg;
+	
+	msg.id = ch->config.tx_key & 0x1fffffff;
+	msg.flags.extended = (ch->config.tx_key & 0x80000000) ? 1 : 0;
+	msg.flags.rtr = 0;
+	msg.length = 8;
+	
+	memcpy(msg.data, data, length);
+	memset(&msg.data[length], ch->config.padding, 8 - length);
+	
+	tx_queue_send(&msg, &isotp_tx_options);
+	
+	// nicht auf den naechsten Durchlauf der Hauptschleife warten
+	tx_queue_pump();
+}
+
+// ----------------------------------------------------------------------------
+static void isotp_send_flow_control(isotp_channel_t *ch, uint8_t status)
+{
+	uint8_t data[3];
+	
+	data[0] = (PCI_FLOW_CONTROL << 4) | status;
+	data[1] = ch->config.block_size;
+	data[2] = ch->config.st_min;
+	
+	isotp_send_frame(ch, data, 3);
+}
+
+// ----------------------------------------------------------------------------
+bool isotp_send(uint8_t channel, const uint8_t *data, uint8_t length)
+{
+	if (channel >= ISOTP_CHANNELS)
+		return false;
+	
+	isotp_channel_t *ch = &isotp_channel[channel];
+	
+	if (!ch->open || ch->tx_state != TX_IDLE || length == 0 || length > ISOTP_TX_SIZE)
+		return false;
+	
+	uint8_t frame[8];
+	
+	if (length <= 7) {
+		frame[0] = (PCI_SINGLE << 4) | length;
+		memcpy(&frame[1], data, length);
+		isotp_send_frame(ch, frame, length + 1);
+		
+		event_push(ISOTP_EVENT, 's', channel, length);
+		return true;
+	}
+	
+	memcpy(ch->tx_buffer, data, length);
+	
+	frame[0] = (PCI_FIRST << 4);
+	frame[1] = length;
+	memcpy(&frame[2], data, 6);
+	isotp_send_frame(ch, frame, 8);
+	
+	ch->tx_length = length;
+	ch->tx_pos = 6;
+	ch->tx_sn = 1;
+	ch->tx_deadline = systime_ms() + ISOTP_TIMEOUT;
+	ch->tx_state = TX_WAIT_FC;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+// STmin: 0..127 ms oder 100..900 us (0xf1..0xf9), reservierte Werte
+// werden wie 127 ms behandelt
+
+static uint16_t isotp_st_min_ticks(uint8_t st_min)
+{
+	if (st_min <= 0x7f)
+		return st_min * 250;
+	else if (st_min >= 0xf1 && st_min <= 0xf9)
+		return (st_min - 0xf0) * 25;
+	else
+		return 127 * 250;
+}
+
+// ----------------------------------------------------------------------------
+static void isotp_receive_flow_control(isotp_channel_t *ch, uint8_t channel,
+		const can_t *msg)
+{
+	if (ch->tx_state != TX_WAIT_FC || msg->length < 3)
+		return;
+	
+	switch (msg->data[0] & 0x0f) {
+		case FC_CONTINUE:
+			ch->tx_block_size = msg->data[1];
+			ch->tx_block = msg->data[1];
+			ch->tx_st_min = isotp_st_min_ticks(msg->data[2]);
+			ch->tx_next = systime_ticks();
+			ch->tx_state = TX_SENDING;
+			break;
+		
+		case FC_WAIT:
+			ch->tx_deadline = systime_ms() + ISOTP_TIMEOUT;
+			break;
+		
+		default:
+			ch->tx_state = TX_IDLE;
+			event_push(ISOTP_EVENT, 'a', channel, ch->tx_pos);
+			break;
+	}
+}
+
+// ----------------------------------------------------------------------------
+static void isotp_receive(isotp_channel_t *ch, uint8_t channel, const can_t *msg)
+{
+	const uint8_t *data = msg->data;
+	uint8_t length = msg->length;
+	uint16_t pdu_length;
+	
+	switch (data[0] >> 4)
+	{
+		case PCI_SINGLE:
+			pdu_length = data[0] & 0x0f;
+			if (pdu_length == 0 || pdu_length >= length)
+				break;
+			
+			if (ch->rx_state == RX_DONE) {
+				event_push(ISOTP_EVENT, 'o', channel, pdu_length);
+				break;
+			}
+			
+			memcpy(ch->rx_buffer, &data[1], pdu_length);
+			ch->rx_length = pdu_length;
+			ch->rx_state = RX_DONE;
+			break;
+		
+		case PCI_FIRST:
+			if (length < 8)
+				break;
+			
+			pdu_length = ((data[0] & 0x0f) << 8) | data[1];
+			if (pdu_length < 8)
+				break;
+			
+			if (ch->rx_state == RX_DONE || pdu_length > ISOTP_RX_SIZE) {
+				isotp_send_flow_control(ch, FC_OVERFLOW);
+				event_push(ISOTP_EVENT, 'o', channel, pdu_length);
+				break;
+			}
+			
+			// Flow Control sofort verschicken
+			isotp_send_flow_control(ch, FC_CONTINUE);
+			
+			memcpy(ch->rx_buffer, &data[2], 6);
+			ch->rx_length = pdu_length;
+			ch->rx_pos = 6;
+			ch->rx_sn = 1;
+			ch->rx_block = ch->config.block_size;
+			ch->rx_deadline = systime_ms() + ISOTP_TIMEOUT;
+			ch->rx_state = RX_RECEIVING;
+			break;
+		
+		case PCI_CONSECUTIVE:
+		{
+			if (ch->rx_state != RX_RECEIVING)
+				break;
+			
+			if ((data[0] & 0x0f) != ch->rx_sn) {
+				ch->rx_state = RX_IDLE;
+				event_push(ISOTP_EVENT, 'q', channel, data[0] & 0x0f);
+				break;
+			}
+			
+			uint16_t rest = ch->rx_length - ch->rx_pos;
+			if (rest > 7)
+				rest = 7;
+			if (rest >= length)
+				break;
+			
+			memcpy(&ch->rx_buffer[ch->rx_pos], &data[1], rest);
+			ch->rx_pos += rest;
+			ch->rx_sn = (ch->rx_sn + 1) & 0x0f;
+			
+			if (ch->rx_pos >= ch->rx_length) {
+				ch->rx_state = RX_DONE;
+				break;
+			}
+			
+			if (ch->config.block_size && --ch->rx_block == 0) {
+				isotp_send_flow_control(ch, FC_CONTINUE);
+				ch->rx_block = ch->config.block_size;
+			}
+			
+			ch->rx_deadline = systime_ms() + ISOTP_TIMEOUT;
+			break;
+		}
+		
+		case PCI_FLOW_CONTROL:
+			isotp_receive_flow_control(ch, channel, msg);
+			break;
+	}
+}
+
+// ----------------------------------------------------------------------------
+bool isotp_check(const can_t *msg)
+{
+	if (msg->flags.rtr || msg->length == 0)
+		return true;
+	
+	uint32_t key = id_table_key(msg);
+	
+	for (uint8_t i = 0; i < ISOTP_CHANNELS; i++)
+	{
+		isotp_channel_t *ch = &isotp_channel[i];
+		
+		if (ch->open && ch->config.rx_key == key) {
+			isotp_receive(ch, i, msg);
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+void isotp_poll(void)
+{
+	for (uint8_t i = 0; i < ISOTP_CHANNELS; i++)
+	{
+		isotp_channel_t *ch = &isotp_channel[i];
+		
+		if (!ch->open)
+			continue;
+		
+		if (ch->rx_state == RX_RECEIVING && systime_elapsed(ch->rx_deadline)) {
+			ch->rx_state = RX_IDLE;
+			event_push(ISOTP_EVENT, 'c', i, ch->rx_pos);
+		}
+		
+		if (ch->tx_state == TX_WAIT_FC && systime_elapsed(ch->tx_deadline)) {
+			ch->tx_state = TX_IDLE;
+			event_push(ISOTP_EVENT, 'b', i, ch->tx_pos);
+		}
+		
+		// naechsten Consecutive Frame erst nach STmin und wenn der
+		// vorherige die Queue verlassen hat
+		if (ch->tx_state != TX_SENDING ||
+			(int32_t) (systime_ticks() - ch->tx_next) < 0 ||
+			tx_queue_get_depth(ISOTP_TX_QUEUE) != 0)
+			continue;
+		
+		uint8_t frame[8];
+		uint8_t count = ch->tx_length - ch->tx_pos;
+		if (count > 7)
+			count = 7;
+		
+		frame[0] = (PCI_CONSECUTIVE << 4) | ch->tx_sn;
+		memcpy(&frame[1], &ch->tx_buffer[ch->tx_pos], count);
+		isotp_send_frame(ch, frame, count + 1);
+		
+		ch->tx_pos += count;
+		ch->tx_sn = (ch->tx_sn + 1) & 0x0f;
+		ch->tx_next = systime_ticks() + ch->tx_st_min;
+		
+		if (ch->tx_pos >= ch->tx_length) {
+			ch->tx_state = TX_IDLE;
+			event_push(ISOTP_EVENT, 's', i, ch->tx_length);
+		}
+		else if (ch->tx_block_size && --ch->tx_block == 0) {
+			ch->tx_deadline = systime_ms() + ISOTP_TIMEOUT;
+			ch->tx_state = TX_WAIT_FC;
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+const uint8_t * isotp_peek(uint8_t *channel, uint16_t *length)
+{
+	for (uint8_t i = 0; i < ISOTP_CHANNELS; i++)
+	{
+		isotp_channel_t *ch = &isotp_channel[i];
+		
+		if (ch->open && ch->rx_state == RX_DONE) {
+			*channel = i;
+			*length = ch->rx_length;
+			return ch->rx_buffer;
+		}
+	}
+	
+	return NULL;
+}
+
+// ----------------------------------------------------------------------------
+void isotp_commit(uint8_t channel)
+{
+	isotp_channel[channel].rx_state = RX_IDLE;
+}
+
+#endif	// SUPPORT_ISOTP
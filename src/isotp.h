@@ -0,0 +1,128 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	ISOTP_H
+#define	ISOTP_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	ISO-TP (ISO 15765-2) transport on the device
+ *
+ * A channel is configured by a pair of identifiers: messages are sent
+ * with the TX identifier, the frames of the ECU are received with the RX
+ * identifier. Incoming segmented transfers are reassembled locally and the
+ * flow control frame is sent by the device itself. Frames with the RX
+ * identifier are not forwarded, the host gets the complete PDU instead
+ * (see isotp_peek()).
+ *
+ * The First Frame is handled by rx_queue_poll() as soon as the main loop
+ * fetches it from the CAN library, right after the trigger and the
+ * gateway and independent of free blocks of the pool. The flow control
+ * is queued and handed to a MOb at once. Its latency (end of the First
+ * Frame until it waits for arbitration) is the sum of:
+ *
+ *  - the interrupt latency of the CAN library, see trigger_out.h
+ *  - the rest of the current pass of the main loop. The output to the
+ *    host is the longest part, term_putc() waits for the FT245: a few ms
+ *    for a long answer of the shell (e.g. "get stats"), unlimited while
+ *    the host does not read at all.
+ *  - the receive functions for up to CAN_RX_BUFFER_SIZE messages received
+ *    before the First Frame
+ *  - a frame of ISOTP_TX_QUEUE still in its MOb, each queue has only one
+ *    message in transmission
+ *
+ * Unless the host blocks the USB connection this stays well below the
+ * N_Bs timeout of 1000 ms of ISO 15765-2.
+ *
+ * Outgoing payloads are segmented with the block size and the STmin
+ * requested by the flow control of the ECU.
+ *
+ * Errors and completed transmissions are reported as events of type 't'
+ * (see event_queue.h) with the channel as key:
+ *   's'	payload sent, value = length
+ *   'b'	no flow control within ISOTP_TIMEOUT (N_Bs)
+ *   'c'	no consecutive frame within ISOTP_TIMEOUT (N_Cr)
+ *   'q'	wrong sequence number, value = received number
+ *   'o'	PDU too long or buffer still in use, value = length
+ *   'a'	transmission aborted by the flow control of the ECU
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+
+#define	ISOTP_EVENT			't'
+
+// ----------------------------------------------------------------------------
+typedef struct {
+	uint32_t tx_key;		//!< identifier, see id_table_key()
+	uint32_t rx_key;
+	uint8_t block_size;		//!< block size sent in the flow control
+	uint8_t st_min;			//!< STmin sent in the flow control
+	uint8_t padding;		//!< all frames are padded to 8 bytes
+} isotp_config_t;
+
+// ----------------------------------------------------------------------------
+extern bool isotp_open(uint8_t channel, const isotp_config_t *config);
+
+// ----------------------------------------------------------------------------
+extern void isotp_close(uint8_t channel);
+
+// ----------------------------------------------------------------------------
+// Returns NULL if the channel is closed
+
+extern const isotp_config_t * isotp_get_config(uint8_t channel);
+
+// ----------------------------------------------------------------------------
+// Starts the transmission of a payload. Returns false if the channel is
+// closed, still busy or the payload is too long (ISOTP_TX_SIZE).
+
+extern bool isotp_send(uint8_t channel, const uint8_t *data, uint8_t length);
+
+// ----------------------------------------------------------------------------
+// Handles frames with the RX identifier of a channel. Returns false if the
+// message was consumed.
+
+extern bool isotp_check(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+// Sends the consecutive frames and checks the timeouts, has to be called
+// periodically.
+
+extern void isotp_poll(void);
+
+// ----------------------------------------------------------------------------
+// Returns a completely received PDU or NULL. The buffer stays valid until
+// isotp_commit() is called for the channel.
+
+extern const uint8_t * isotp_peek(uint8_t *channel, uint16_t *length);
+
+// ----------------------------------------------------------------------------
+extern void isotp_commit(uint8_t channel);
+
+// ----------------------------------------------------------------------------
+#if !SUPPORT_ISOTP
+	#define	isotp_check(msg)		true
+	#define	isotp_poll()
+#endif
+
+#endif	// ISOTP_H
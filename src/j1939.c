@@ -0,0 +1,382 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "j1939.h"
+#include "event_queue.h"
+#include "tx_queue.h"
+#include "systime.h"
+
+#if SUPPORT_J1939
+
+#define	PF_TP_CM			0xec
+#define	PF_TP_DT			0xeb
+
+// control bytes of TP.CM
+#define	CM_RTS				16
+#define	CM_CTS				17
+#define	CM_EOM_ACK			19
+#define	CM_BAM				32
+#define	CM_ABORT			255
+
+// abort reasons
+#define	ABORT_BUSY			1
+#define	ABORT_RESOURCES		2
+#define	ABORT_TIMEOUT		3
+#define	ABORT_SEQUENCE		7
+
+#if J1939_BUFFER_SIZE > 1785
+	#error	J1939_BUFFER_SIZE must not be larger than 1785 (255 packets)
+#endif
+
+#define	GLOBAL_ADDRESS		0xff
+
+typedef enum {
+	SESSION_FREE,
+	SESSION_RECEIVING,
+	SESSION_DONE			// message waits for the host
+} j1939_session_state_t;
+
+typedef struct {
+	uint8_t state;
+	uint8_t source;
+	uint8_t destination;
+	uint8_t packets;
+	uint8_t next;			// expected sequence number
+	uint8_t window;			// local receiver: packets left of the current CTS
+	uint8_t max_window;
+	bool local;				// the device is the receiver
+	uint16_t size;
+	uint16_t deadline;
+	uint32_t pgn;
+	uint8_t buffer[J1939_BUFFER_SIZE];
+} j1939_session_t;
+
+static j1939_session_t j1939_session[J1939_SESSIONS];
+
+static bool j1939_enabled;
+static uint8_t j1939_address = J1939_NO_ADDRESS;
+
+static const tx_options_t j1939_tx_options = {
+	.queue = J1939_TX_QUEUE,
+	.timeout = 0,
+	.one_shot = false
+};
+
+// ----------------------------------------------------------------------------
+void j1939_enable(uint8_t address)
+{
+	for (uint8_t i = 0; i < J1939_SESSIONS; i++)
+		j1939_session[i].state = SESSION_FREE;
+	
+	j1939_address = address;
+	j1939_enabled = true;
+}
+
+// ----------------------------------------------------------------------------
+void j1939_disable(void)
+{
+	j1939_enabled = false;
+}
+
+// ----------------------------------------------------------------------------
+bool j1939_is_enabled(void)
+{
+	return j1939_enabled;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t j1939_get_address(void)
+{
+	return j1939_address;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t j1939_get_active(void)
+{
+	uint8_t count = 0;
+	
+	for (uint8_t i = 0; i < J1939_SESSIONS; i++) {
+		if (j1939_session[i].state == SESSION_RECEIVING)
+			count++;
+	}
+	
+	return count;
+}
+
+// ----------------------------------------------------------------------------
+// Verschickt ein TP.CM mit Prioritaet 7 an die Adresse
+
+static void j1939_send_cm(uint8_t destination, uint8_t control, uint8_t b1,
+		uint8_t b2, uint8_t b3, uint8_t b4, uint32_t pgn)
+{
+	can_t msg;
+	
+	msg.id = (7UL << 26) | ((uint32_t) PF_TP_CM << 16) |
+			((uint16_t) destination << 8) | j1939_address;
+	msg.flags.extended = 1;
+	msg.flags.rtr = 0;
+	msg.length = 8;
+	msg.data[0] = control;
+	msg.data[1] = b1;
+	msg.data[2] = b2;
+	msg.data[3] = b3;
+	msg.data[4] = b4;
+	msg.data[5] = pgn;
+	msg.data[6] = pgn >> 8;
+	msg.data[7] = pgn >> 16;
+	
+	tx_queue_send(&msg, &j1939_tx_options);
+	tx_queue_pump();
+}
+
+// ----------------------------------------------------------------------------
+static void j1939_send_abort(uint8_t destination, uint8_t reason, uint32_t pgn)
+{
+	j1939_send_cm(destination, CM_ABORT, reason, 0xff, 0xff, 0xff, pgn);
+}
+
+// ----------------------------------------------------------------------------
+// Fordert die naechsten Pakete an
+
+static void j1939_send_cts(j1939_session_t *s)
+{
+	uint8_t count = s->packets - s->next + 1;
+	
+	if (count > s->max_window)
+		count = s->max_window;
+	
+	s->window = count;
+	j1939_send_cm(s->source, CM_CTS, count, s->next, 0xff, 0xff, s->pgn);
+}
+
+// ----------------------------------------------------------------------------
+static j1939_session_t * j1939_find(uint8_t source, uint8_t destination)
+{
+	for (uint8_t i = 0; i < J1939_SESSIONS; i++)
+	{
+		j1939_session_t *s = &j1939_session[i];
+		
+		if (s->state == SESSION_RECEIVING && s->source == source &&
+			s->destination == destination)
+			return s;
+	}
+	
+	return NULL;
+}
+
+// ----------------------------------------------------------------------------
+// Startet eine Uebertragung nach RTS oder BAM. Eine laufende Uebertragung
+// zwischen den gleichen Teilnehmern wird dabei ersetzt.
+
+static void j1939_start(const uint8_t *data, uint8_t source, uint8_t destination)
+{
+	uint16_t size = data[1] | (data[2] << 8);
+	uint8_t packets = data[3];
+	uint32_t pgn = data[5] | ((uint16_t) data[6] << 8) | ((uint32_t) data[7] << 16);
+	bool local = (data[0] == CM_RTS && destination == j1939_address);
+	
+	j1939_session_t *s = j1939_find(source, destination);
+	
+	if (s == NULL) {
+		for (uint8_t i = 0; i < J1939_SESSIONS; i++) {
+			if (j1939_session[i].state == SESSION_FREE) {
+				s = &j1939_session[i];
+				break;
+			}
+		}
+	}
+	
+	if (s == NULL || size > J1939_BUFFER_SIZE || size < 9 ||
+		packets != (size + 6) / 7)
+	{
+		if (local)
+			j1939_send_abort(source, (s == NULL) ? ABORT_BUSY : ABORT_RESOURCES, pgn);
+		
+		if (s != NULL)
+			s->state = SESSION_FREE;
+		
+		event_push(J1939_EVENT, 'o', source, size);
+		return;
+	}
+	
+	s->source = source;
+	s->destination = destination;
+	s->size = size;
+	s->packets = packets;
+	s->next = 1;
+	s->pgn = pgn;
+	s->local = local;
+	s->max_window = (data[4] == 0) ? 0xff : data[4];
+	s->deadline = systime_ms() + J1939_TIMEOUT;
+	s->state = SESSION_RECEIVING;
+	
+	if (local)
+		j1939_send_cts(s);
+}
+
+// ----------------------------------------------------------------------------
+static void j1939_receive_cm(const uint8_t *data, uint8_t source, uint8_t destination)
+{
+	j1939_session_t *s;
+	
+	switch (data[0])
+	{
+		case CM_RTS:
+			j1939_start(data, source, destination);
+			break;
+		
+		case CM_BAM:
+			if (destination == GLOBAL_ADDRESS)
+				j1939_start(data, source, destination);
+			break;
+		
+		case CM_CTS:
+			// vom Empfaenger: Uebertragung laeuft noch
+			s = j1939_find(destination, source);
+			if (s != NULL && !s->local)
+				s->deadline = systime_ms() + J1939_TIMEOUT;
+			break;
+		
+		case CM_ABORT:
+			s = j1939_find(source, destination);
+			if (s == NULL)
+				s = j1939_find(destination, source);
+			
+			if (s != NULL) {
+				s->state = SESSION_FREE;
+				event_push(J1939_EVENT, 'a', s->source, data[1]);
+			}
+			break;
+	}
+}
+
+// ----------------------------------------------------------------------------
+static void j1939_receive_dt(const can_t *msg, uint8_t source, uint8_t destination)
+{
+	j1939_session_t *s = j1939_find(source, destination);
+	
+	if (s == NULL || msg->length < 8)
+		return;
+	
+	uint8_t sequence = msg->data[0];
+	
+	if (sequence != s->next) {
+		if (s->local)
+			j1939_send_abort(source, ABORT_SEQUENCE, s->pgn);
+		
+		s->state = SESSION_FREE;
+		event_push(J1939_EVENT, 'q', source, sequence);
+		return;
+	}
+	
+	uint16_t pos = (uint16_t) (sequence - 1) * 7;
+	uint8_t count = (s->size - pos > 7) ? 7 : s->size - pos;
+	
+	memcpy(&s->buffer[pos], &msg->data[1], count);
+	s->next++;
+	s->deadline = systime_ms() + J1939_TIMEOUT;
+	
+	if (sequence == s->packets)
+	{
+		if (s->local) {
+			j1939_send_cm(source, CM_EOM_ACK, s->size, s->size >> 8,
+					s->packets, 0xff, s->pgn);
+		}
+		s->state = SESSION_DONE;
+	}
+	else if (s->local && --s->window == 0) {
+		j1939_send_cts(s);
+	}
+}
+
+// ----------------------------------------------------------------------------
+bool j1939_check(const can_t *msg)
+{
+	if (!j1939_enabled || !msg->flags.extended || msg->flags.rtr)
+		return true;
+	
+	uint8_t pf = msg->id >> 16;
+	uint8_t destination = msg->id >> 8;
+	uint8_t source = msg->id;
+	
+	if (pf == PF_TP_CM) {
+		if (msg->length >= 8)
+			j1939_receive_cm(msg->data, source, destination);
+	}
+	else if (pf == PF_TP_DT) {
+		j1939_receive_dt(msg, source, destination);
+	}
+	else {
+		return true;
+	}
+	
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+void j1939_poll(void)
+{
+	if (!j1939_enabled)
+		return;
+	
+	for (uint8_t i = 0; i < J1939_SESSIONS; i++)
+	{
+		j1939_session_t *s = &j1939_session[i];
+		
+		if (s->state != SESSION_RECEIVING || !systime_elapsed(s->deadline))
+			continue;
+		
+		if (s->local)
+			j1939_send_abort(s->source, ABORT_TIMEOUT, s->pgn);
+		
+		s->state = SESSION_FREE;
+		event_push(J1939_EVENT, 't', s->source, (uint16_t) (s->next - 1) * 7);
+	}
+}
+
+// ----------------------------------------------------------------------------
+uint8_t j1939_peek(j1939_message_t *message)
+{
+	for (uint8_t i = 0; i < J1939_SESSIONS; i++)
+	{
+		j1939_session_t *s = &j1939_session[i];
+		
+		if (s->state == SESSION_DONE) {
+			message->pgn = s->pgn;
+			message->source = s->source;
+			message->destination = s->destination;
+			message->length = s->size;
+			message->data = s->buffer;
+			return i;
+		}
+	}
+	
+	return 0xff;
+}
+
+// ----------------------------------------------------------------------------
+void j1939_commit(uint8_t session)
+{
+	j1939_session[session].state = SESSION_FREE;
+}
+
+#endif	// SUPPORT_J1939
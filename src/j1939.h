@@ -0,0 +1,114 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	J1939_H
+#define	J1939_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Reassembly of J1939 multi-packet messages
+ *
+ * Transfers of the transport protocol (TP.CM PGN 0xEC00 and TP.DT PGN
+ * 0xEB00) are reassembled on the device, both broadcasts (BAM) and
+ * connection mode (RTS/CTS). Up to J1939_SESSIONS transfers of at most
+ * J1939_BUFFER_SIZE bytes are tracked at the same time, identified by
+ * source and destination address.
+ *
+ * If the device has an address of its own, it answers an RTS to that
+ * address with CTS and End of Message Acknowledge. Otherwise the transfers
+ * are only monitored.
+ *
+ * While enabled the frames of the transport protocol are not forwarded,
+ * the host gets the complete message instead (see j1939_peek()). Errors
+ * are reported as events of type 'j' (see event_queue.h) with the source
+ * address as key:
+ *   'o'	too long or no free session, value = size
+ *   't'	timeout, value = bytes received
+ *   'q'	wrong sequence number, value = received number
+ *   'a'	aborted by a participant, value = reason
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+
+#define	J1939_EVENT			'j'
+
+// address used to only monitor the transfers
+#define	J1939_NO_ADDRESS	0xfe
+
+// ----------------------------------------------------------------------------
+typedef struct {
+	uint32_t pgn;
+	uint8_t source;
+	uint8_t destination;	//!< 0xff for broadcasts
+	uint16_t length;
+	const uint8_t *data;
+} j1939_message_t;
+
+// ----------------------------------------------------------------------------
+// Enables the reassembly, address is the own address of the device or
+// J1939_NO_ADDRESS.
+
+extern void j1939_enable(uint8_t address);
+
+// ----------------------------------------------------------------------------
+extern void j1939_disable(void);
+
+// ----------------------------------------------------------------------------
+extern bool j1939_is_enabled(void);
+
+// ----------------------------------------------------------------------------
+extern uint8_t j1939_get_address(void);
+
+// ----------------------------------------------------------------------------
+// Number of transfers in progress
+
+extern uint8_t j1939_get_active(void);
+
+// ----------------------------------------------------------------------------
+// Handles the frames of the transport protocol. Returns false if the
+// message was consumed.
+
+extern bool j1939_check(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+// Checks the timeouts, has to be called periodically.
+
+extern void j1939_poll(void);
+
+// ----------------------------------------------------------------------------
+// Returns the number of a session with a complete message or 0xff. The
+// message stays valid until j1939_commit() is called.
+
+extern uint8_t j1939_peek(j1939_message_t *message);
+
+// ----------------------------------------------------------------------------
+extern void j1939_commit(uint8_t session);
+
+// ----------------------------------------------------------------------------
+#if !SUPPORT_J1939
+	#define	j1939_check(msg)		true
+	#define	j1939_poll()
+#endif
+
+#endif	// J1939_H
@@ -45,6 +45,20 @@
 
 #include "usbcan_protocol.h"
 #include "shell_protocol.h"
+#include "rx_queue.h"
+#include "mob_manager.h"
+#include "tx_queue.h"
+#include "pool.h"
+#include "id_stats.h"
+#include "period_watch.h"
+#include "busload.h"
+#include "expr_filter.h"
+#include "signals.h"
+#include "isotp.h"
+#include "j1939.h"
+#include "request.h"
+#include "autoreply.h"
+#include "trigger_out.h"
 
 #include "can.h"
 #include "utils.h"
@@ -87,6 +101,8 @@ static mode_t mode_of_operation = DONGLE;
 
 uint8_t volatile f_timer = FALSE;
 
+volatile uint32_t systime_10ms = 0;
+
 static int putchar__(char c, FILE *stream) {
 	term_putc_cr(c);
 	return 0;
@@ -147,7 +163,7 @@ static void change_mode(mode_t mode)
 			LED_2_GREEN;
 			#endif
 			
-			can_disable_filter(CAN_ALL_FILTER);
+			mob_close_all();
 			break;
 		
 		case DONGLE:
@@ -159,16 +175,7 @@ static void change_mode(mode_t mode)
 			LED_2_OFF;
 			#endif
 			
-			can_filter_t filter = {
-				.mask = 0,
-				.id = 0,
-				.flags.extended = 0,
-				.flags.rtr = 0
-			};
-			
-			for (uint8_t i=11;i<15;i++) {
-				can_set_filter(i, &filter);
-			}
+			mob_open_catch_all();
 			break;
 		
 		default:
@@ -190,6 +197,9 @@ debugger_indicate_rx_traffic(void)
 {
 	static bool status = true;
 	
+	// zuerst, damit die Latenz des Triggers konstant bleibt
+	trigger_out_check();
+	
 	if (status) {
 		RESET(LED_RX);
 		SET(LED_RX_2);
@@ -298,6 +308,12 @@ int main(void)
 	
 	init_command_shell();
 	
+	pool_init();
+	tx_queue_init();
+	id_stats_clear();
+	expr_load();
+	signals_load();
+	
 	// Interrupts aktivieren
 	sei();
 	
@@ -315,7 +331,7 @@ int main(void)
 	
 	#endif
 	
-	can_init(BITRATE_125_KBPS);
+	mob_init(BITRATE_125_KBPS);
 	
 	while(1)
 	{
@@ -331,6 +347,15 @@ int main(void)
 			change_mode(tmode);
 		}
 		
+		// neue Nachrichten aus dem CAN Controller abholen
+		rx_queue_poll();
+		tx_queue_pump();
+		period_watch_poll();
+		isotp_poll();
+		j1939_poll();
+		request_poll();
+		autoreply_poll();
+		
 		if (mode == SHELL)
 		{
 			shell_handle_protocol();
@@ -353,6 +378,15 @@ ISR(TIMER1_OVF_vect)
 	static uint8_t counter = 0;
 	static uint8_t step = 0;
 	static bool up = true;
+	static uint8_t systime_counter = 0;
+	
+	// 20 * 0.512 ms = ~10 ms
+	systime_counter++;
+	if (systime_counter == 20) {
+		systime_counter = 0;
+		systime_10ms++;
+		busload_tick();
+	}
 	
 	counter++;
 	if (counter == 100) {
@@ -378,12 +412,40 @@ ISR(TIMER1_OVF_vect)
 #endif
 
 #if  HARDWARE_VERSION_MINOR >= 2
+// ----------------------------------------------------------------------------
+// Buslast mit den beiden Duo-LEDs anzeigen:
+//  < 25 %: gruen/aus, < 50 %: gruen/gruen, < 75 %: gruen/rot, sonst rot/rot
+
+static void show_busload(uint8_t load)
+{
+	if (load < 25) {
+		LED_1_GREEN;
+		LED_2_OFF;
+	}
+	else if (load < 50) {
+		LED_1_GREEN;
+		LED_2_GREEN;
+	}
+	else if (load < 75) {
+		LED_1_GREEN;
+		LED_2_RED;
+	}
+	else {
+		LED_1_RED;
+		LED_2_RED;
+	}
+}
+
 ISR(TIMER1_COMPA_vect)
 {
 	static uint16_t switch_counter = 0;
 	static bool select_mode = false;
 	static bool pressed = false;
 	static mode_t temp_mode;
+	static bool gauge = false;
+	
+	systime_10ms++;
+	busload_tick();
 	
 	if (select_mode)
 	{
@@ -481,6 +543,24 @@ ISR(TIMER1_COMPA_vect)
 			switch_counter = 0;
 			pressed = false;
 		}
+		
+		if (busload_get_gauge()) {
+			show_busload(busload_get_average());
+			gauge = true;
+		}
+		else if (gauge) {
+			// Anzeige des Modus wiederherstellen
+			gauge = false;
+			
+			if (mode_of_operation == SHELL) {
+				LED_1_OFF;
+				LED_2_GREEN;
+			}
+			else {
+				LED_1_GREEN;
+				LED_2_OFF;
+			}
+		}
 	}
 }
 #endif
@@ -0,0 +1,436 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include "mob_manager.h"
+
+#include <avr/io.h>
+
+#include "config.h"
+#include "utils.h"
+#include "systime.h"
+#include "rx_queue.h"
+
+static can_bitrate_t mob_bitrate = BITRATE_125_KBPS;
+
+static uint8_t mob_canbt[3];
+static bool mob_custom_bt = false;
+static can_mode_t mob_mode = NORMAL_MODE;
+
+// MObs 0..(tx_count - 1) are used for transmission
+static uint8_t mob_tx_count = MOB_TX_DEFAULT;
+
+// user filters
+static can_filter_t mob_filter[MOB_COUNT];
+static uint16_t mob_user;
+
+// MObs which are currently enabled for reception
+static uint16_t mob_rx;
+
+// MObs whose filter has to be written again
+static uint16_t mob_dirty;
+
+static bool mob_catch_all = false;
+
+static bool mob_staging = false;
+static bool mob_reinit = false;
+static bool mob_mode_changed = false;
+
+static uint16_t mob_blind_time;
+
+static const can_filter_t catch_all_filter = {
+	.mask = 0,
+	.id = 0,
+	.flags.extended = 0,
+	.flags.rtr = 0
+};
+
+// ----------------------------------------------------------------------------
+// Brings the filters in line with the partition
+
+static void mob_apply(void)
+{
+	for (uint8_t i = 0; i < MOB_COUNT; i++)
+	{
+		uint16_t bit = 1 << i;
+		bool update = (mob_dirty & bit) || !(mob_rx & bit);
+		
+		if (i < mob_tx_count)
+		{
+			// Only disable MObs used for reception, this would otherwise
+			// abort a pending transmission. User filters can't be set
+			// here, mob_set_partition() refuses to cover them.
+			if (mob_rx & bit) {
+				can_disable_filter(i);
+				mob_rx &= ~bit;
+			}
+		}
+		else if (mob_user & bit)
+		{
+			if (update) {
+				can_set_filter(i, &mob_filter[i]);
+				mob_rx |= bit;
+			}
+		}
+		else if (mob_catch_all)
+		{
+			if (update) {
+				can_set_filter(i, &catch_all_filter);
+				mob_rx |= bit;
+			}
+		}
+		else if (mob_rx & bit)
+		{
+			can_disable_filter(i);
+			mob_rx &= ~bit;
+		}
+	}
+	
+	mob_dirty = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Waits until the transmissions in MObs which become RX MObs are finished,
+// they would otherwise be overwritten by the new filter. Without bus or
+// in bus-off they never finish and are aborted after MOB_TX_DRAIN_MS.
+
+static void mob_drain(void)
+{
+	uint32_t start = systime_ticks();
+	
+	for (uint8_t i = mob_tx_count; i < MOB_COUNT; i++)
+	{
+		// enabled but not for reception => pending transmission
+		if (mob_rx & (1 << i))
+			continue;
+		
+		while (mob_is_busy(i))
+		{
+			if (systime_ticks() - start > MOB_TX_DRAIN_MS * 250UL) {
+				mob_abort(i);
+				break;
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+// Applies the changes immediately if no staged reconfiguration is active
+
+static void mob_update(void)
+{
+	if (!mob_staging)
+		mob_commit();
+}
+
+// ----------------------------------------------------------------------------
+void mob_init(can_bitrate_t bitrate)
+{
+	mob_bitrate = bitrate;
+	mob_custom_bt = false;
+	mob_reinit = true;
+	
+	mob_update();
+}
+
+// ----------------------------------------------------------------------------
+can_bitrate_t mob_get_bitrate(void)
+{
+	return mob_bitrate;
+}
+
+// ----------------------------------------------------------------------------
+void mob_set_bit_timing(const uint8_t *canbt)
+{
+	if (canbt) {
+		mob_canbt[0] = canbt[0];
+		mob_canbt[1] = canbt[1];
+		mob_canbt[2] = canbt[2];
+		mob_custom_bt = true;
+	}
+	else {
+		mob_custom_bt = false;
+	}
+	
+	mob_reinit = true;
+	mob_update();
+}
+
+// ----------------------------------------------------------------------------
+bool mob_has_custom_bit_timing(void)
+{
+	return mob_custom_bt;
+}
+
+// ----------------------------------------------------------------------------
+// The bit timing registers may only be written while the controller is
+// in standby mode.
+
+static void mob_write_bit_timing(void)
+{
+	CANGCON &= ~(1 << ENASTB);
+	while (CANGSTA & (1 << ENFG))
+		;
+	
+	CANBT1 = mob_canbt[0];
+	CANBT2 = mob_canbt[1];
+	CANBT3 = mob_canbt[2];
+	
+	CANGCON |= (1 << ENASTB);
+	while (!(CANGSTA & (1 << ENFG)))
+		;
+}
+
+// ----------------------------------------------------------------------------
+void mob_set_mode(can_mode_t mode)
+{
+	mob_mode = mode;
+	mob_mode_changed = true;
+	
+	mob_update();
+}
+
+// ----------------------------------------------------------------------------
+can_mode_t mob_get_mode(void)
+{
+	return mob_mode;
+}
+
+// ----------------------------------------------------------------------------
+void mob_begin(void)
+{
+	mob_staging = true;
+}
+
+// ----------------------------------------------------------------------------
+bool mob_is_staging(void)
+{
+	return mob_staging;
+}
+
+// ----------------------------------------------------------------------------
+uint16_t mob_commit(void)
+{
+	mob_staging = false;
+	
+	// fetch all messages which would otherwise be lost by can_init()
+	if (mob_reinit)
+		rx_queue_poll();
+	else
+		mob_drain();
+	
+	uint32_t start = systime_ticks();
+	
+	ENTER_CRITICAL_SECTION
+	if (mob_reinit)
+	{
+		// remember all MOBs are cleared by can_init()
+		can_init(mob_bitrate);
+		if (mob_custom_bt)
+			mob_write_bit_timing();
+		can_set_mode(mob_mode);
+		
+		mob_rx = 0;
+		mob_reinit = false;
+	}
+	else if (mob_mode_changed) {
+		can_set_mode(mob_mode);
+	}
+	mob_mode_changed = false;
+	
+	mob_apply();
+	LEAVE_CRITICAL_SECTION
+	
+	uint32_t ticks = systime_ticks() - start;
+	if (ticks > 0xffff / 4)
+		mob_blind_time = 0xffff;
+	else
+		mob_blind_time = ticks * 4;
+	
+	return mob_blind_time;
+}
+
+// ----------------------------------------------------------------------------
+uint16_t mob_get_blind_time(void)
+{
+	return mob_blind_time;
+}
+
+// ----------------------------------------------------------------------------
+bool mob_set_partition(uint8_t tx_count)
+{
+	if (tx_count == 0 || tx_count > TX_QUEUE_COUNT)
+		return false;
+	
+	// user filters would be lost
+	if (mob_user & ((1 << tx_count) - 1))
+		return false;
+	
+	mob_tx_count = tx_count;
+	mob_update();
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t mob_get_tx_count(void)
+{
+	return mob_tx_count;
+}
+
+// ----------------------------------------------------------------------------
+bool mob_set_filter(uint8_t number, const can_filter_t *filter)
+{
+	if (number < mob_tx_count || number >= MOB_COUNT)
+		return false;
+	
+	mob_filter[number] = *filter;
+	mob_user |= 1 << number;
+	mob_dirty |= 1 << number;
+	
+	mob_update();
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+bool mob_disable_filter(uint8_t number)
+{
+	if (number < mob_tx_count || number >= MOB_COUNT)
+		return false;
+	
+	// falls back to catch-all if active
+	mob_user &= ~(1 << number);
+	mob_dirty |= 1 << number;
+	
+	mob_update();
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+bool mob_is_busy(uint8_t number)
+{
+	if (number < 8)
+		return (CANEN2 & (1 << number)) != 0;
+	else
+		return (CANEN1 & (1 << (number - 8))) != 0;
+}
+
+// ----------------------------------------------------------------------------
+bool mob_is_receiving(uint8_t number)
+{
+	return (mob_rx & (1 << number)) != 0;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t mob_get_errors(uint8_t number)
+{
+	uint8_t status;
+	
+	// CANPAGE is also used by the CAN interrupt
+	ENTER_CRITICAL_SECTION
+	uint8_t page = CANPAGE;
+	CANPAGE = number << 4;
+	status = CANSTMOB;
+	CANPAGE = page;
+	LEAVE_CRITICAL_SECTION
+	
+	return status & ((1 << BERR) | (1 << SERR) | (1 << CERR) | (1 << FERR) | (1 << AERR));
+}
+
+// ----------------------------------------------------------------------------
+uint16_t mob_get_timestamp(uint8_t number)
+{
+	uint16_t stamp;
+	
+	ENTER_CRITICAL_SECTION
+	uint8_t page = CANPAGE;
+	CANPAGE = number << 4;
+	stamp = CANSTM;
+	CANPAGE = page;
+	LEAVE_CRITICAL_SECTION
+	
+	return stamp;
+}
+
+// ----------------------------------------------------------------------------
+uint32_t mob_stamp_to_ticks(uint16_t stamp)
+{
+	uint32_t now = systime_ticks();
+	uint16_t age = CANTIM - stamp;
+	
+	// CANTIM counts with f_clk / (8 * (CANTCON + 1)), systime with f_clk / 64
+	return now - (uint32_t) age * 8 * (CANTCON + 1) / (F_CPU / 250000UL);
+}
+
+// ----------------------------------------------------------------------------
+void mob_abort(uint8_t number)
+{
+	ENTER_CRITICAL_SECTION
+	uint8_t page = CANPAGE;
+	CANPAGE = number << 4;
+	CANCDMOB &= ~((1 << CONMOB1) | (1 << CONMOB0));
+	CANSTMOB = 0;
+	CANPAGE = page;
+	LEAVE_CRITICAL_SECTION
+}
+
+// ----------------------------------------------------------------------------
+void mob_open_catch_all(void)
+{
+	mob_set_catch_all(true);
+}
+
+// ----------------------------------------------------------------------------
+void mob_set_catch_all(bool enable)
+{
+	mob_catch_all = enable;
+	mob_update();
+}
+
+// ----------------------------------------------------------------------------
+bool mob_get_catch_all(void)
+{
+	return mob_catch_all;
+}
+
+// ----------------------------------------------------------------------------
+void mob_close_all(void)
+{
+	mob_catch_all = false;
+	mob_user = 0;
+	
+	mob_update();
+}
+
+// ----------------------------------------------------------------------------
+mob_role_t mob_get_role(uint8_t number)
+{
+	uint16_t bit = 1 << number;
+	
+	if (number < mob_tx_count)
+		return MOB_TX;
+	else if (mob_user & bit)
+		return MOB_RX_USER;
+	else if (mob_catch_all)
+		return MOB_RX_CATCH_ALL;
+	else
+		return MOB_RX_UNUSED;
+}
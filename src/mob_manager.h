@@ -0,0 +1,194 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	MOB_MANAGER_H
+#define	MOB_MANAGER_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Configuration of the CAN controller and its 15 message objects
+ *
+ * MObs 0..(tx_count - 1) are reserved for transmission, the remaining MObs
+ * are used for reception. The AT90CAN compares a received message against
+ * the MObs in ascending order, so within the RX range a lower MOb number
+ * means a higher priority. RX MObs without a user filter receive all
+ * messages while the catch-all mode is active (dongle mode).
+ *
+ * can_send_message() of the CAN library takes any disabled MOb, so RX MObs
+ * without a filter may carry a transmission, too. The TX range only
+ * guarantees MObs for transmission. Users of can_send_message() have to
+ * follow the returned MOb with mob_is_busy() and mob_is_receiving() and
+ * not with its role.
+ *
+ * Bitrate, mode and user filters are kept in SRAM and restored whenever
+ * the controller has to be reinitialized. Between mob_begin() and
+ * mob_commit() all changes are only staged and then applied together
+ * with interrupts disabled, which keeps the time the controller is not
+ * able to receive as short as possible.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+
+#define	MOB_COUNT				15
+
+// ----------------------------------------------------------------------------
+// Initializes the CAN controller with the given bitrate. User filters
+// and the partition are preserved.
+
+extern void mob_init(can_bitrate_t bitrate);
+
+// ----------------------------------------------------------------------------
+extern can_bitrate_t mob_get_bitrate(void);
+
+// ----------------------------------------------------------------------------
+// Reinitializes the controller with the given values for CANBT1..3
+// instead of the bit timing of the selected bitrate. mob_init() switches
+// back to the standard bit timing.
+
+extern void mob_set_bit_timing(const uint8_t *canbt);
+
+// ----------------------------------------------------------------------------
+extern bool mob_has_custom_bit_timing(void);
+
+// ----------------------------------------------------------------------------
+// Sets the operation mode, the mode is restored after a reinitialization.
+
+extern void mob_set_mode(can_mode_t mode);
+
+// ----------------------------------------------------------------------------
+extern can_mode_t mob_get_mode(void);
+
+// ----------------------------------------------------------------------------
+// Starts a staged reconfiguration. Until mob_commit() is called changes
+// to the bitrate, the filters and the partition are only recorded.
+
+extern void mob_begin(void);
+
+// ----------------------------------------------------------------------------
+// Checks if changes are currently staged (between mob_begin() and
+// mob_commit())
+
+extern bool mob_is_staging(void);
+
+// ----------------------------------------------------------------------------
+// Applies all staged changes and returns the time in us in which the
+// controller was not able to receive.
+
+extern uint16_t mob_commit(void);
+
+// ----------------------------------------------------------------------------
+// Blind time of the last mob_commit() or mob_init() in us
+
+extern uint16_t mob_get_blind_time(void);
+
+// ----------------------------------------------------------------------------
+// Reserves the first tx_count MObs for transmission. Returns false if the
+// value is out of range (1..TX_QUEUE_COUNT, every TX queue uses at most one
+// MOb) or if user filters are set on MObs which would become TX MObs, the
+// partition is unchanged then.
+//
+// Transmissions still pending in MObs which become RX MObs get
+// MOB_TX_DRAIN_MS to finish when the change is applied and are aborted
+// afterwards.
+
+extern bool mob_set_partition(uint8_t tx_count);
+
+// ----------------------------------------------------------------------------
+extern uint8_t mob_get_tx_count(void);
+
+// ----------------------------------------------------------------------------
+// Sets a user filter. Only MObs of the RX range are allowed.
+
+extern bool mob_set_filter(uint8_t number, const can_filter_t *filter);
+
+// ----------------------------------------------------------------------------
+extern bool mob_disable_filter(uint8_t number);
+
+// ----------------------------------------------------------------------------
+// Checks if a MOb is enabled, i.e. has a pending transmission or reception.
+
+extern bool mob_is_busy(uint8_t number);
+
+// ----------------------------------------------------------------------------
+// Checks if a MOb is enabled for reception. A transmission in this MOb is
+// finished or was aborted when the filters were applied (see
+// mob_set_partition()).
+
+extern bool mob_is_receiving(uint8_t number);
+
+// ----------------------------------------------------------------------------
+// Returns the error flags (BERR, SERR, CERR, FERR and AERR) of CANSTMOB.
+
+extern uint8_t mob_get_errors(uint8_t number);
+
+// ----------------------------------------------------------------------------
+// Returns CANSTM of a MOb, the value of CANTIM at the end of the last
+// frame transmitted or received by the MOb.
+
+extern uint16_t mob_get_timestamp(uint8_t number);
+
+// ----------------------------------------------------------------------------
+// Converts a value of CANTIM (see mob_get_timestamp() or the timestamp of
+// a received message) into the time of systime_ticks(). The result is
+// only valid if CANTIM has not overflowed since, which depends on the
+// prescaler in CANTCON (32 ms without prescaler at 16 MHz).
+
+extern uint32_t mob_stamp_to_ticks(uint16_t stamp);
+
+// ----------------------------------------------------------------------------
+// Aborts a pending transmission and frees the MOb.
+
+extern void mob_abort(uint8_t number);
+
+// ----------------------------------------------------------------------------
+// Receive all messages with every RX MOb that has no user filter.
+
+extern void mob_open_catch_all(void);
+
+// ----------------------------------------------------------------------------
+// Enables or disables the catch-all mode, user filters are kept.
+
+extern void mob_set_catch_all(bool enable);
+
+// ----------------------------------------------------------------------------
+extern bool mob_get_catch_all(void);
+
+// ----------------------------------------------------------------------------
+// Disables all filters, including the user filters.
+
+extern void mob_close_all(void);
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Role of a MOb
+ */
+typedef enum {
+	MOB_TX,				//!< reserved for transmission
+	MOB_RX_USER,		//!< RX MOb with a user filter
+	MOB_RX_CATCH_ALL,	//!< RX MOb receiving all messages
+	MOB_RX_UNUSED		//!< RX MOb without filter
+} mob_role_t;
+
+extern mob_role_t mob_get_role(uint8_t number);
+
+#endif	// MOB_MANAGER_H
@@ -0,0 +1,220 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include "period_watch.h"
+#include "id_table.h"
+#include "event_queue.h"
+#include "systime.h"
+
+#if (PERIOD_WATCH_SIZE & (PERIOD_WATCH_SIZE - 1)) != 0
+	#error	PERIOD_WATCH_SIZE must be a power of two
+#endif
+
+typedef enum {
+	WATCH_LEARNING,
+	WATCH_ARMED,
+	WATCH_MISSING,
+	WATCH_IGNORED		// not enough messages during the training
+} watch_entry_state_t;
+
+// min and max are only needed during the training, afterwards the same
+// memory holds period and tolerance
+typedef struct {
+	uint16_t last;			// time of the last message
+	union {
+		uint16_t min;		// shortest interval
+		uint16_t period;
+	};
+	union {
+		uint16_t max;		// longest interval
+		uint16_t tolerance;
+	};
+	uint8_t state;
+} watch_entry_t;
+
+static uint32_t watch_keys[PERIOD_WATCH_SIZE];
+static watch_entry_t watch_entry[PERIOD_WATCH_SIZE];
+
+static period_watch_state_t watch_state;
+static uint16_t watch_training_end;
+static uint16_t watch_last_poll;
+
+// ----------------------------------------------------------------------------
+bool period_watch_start(uint16_t training)
+{
+	if (training == 0 || training > 30000)
+		return false;
+	
+	id_table_clear(watch_keys, PERIOD_WATCH_SIZE);
+	
+	watch_training_end = systime_ms() + training;
+	watch_state = PERIOD_WATCH_TRAINING;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+void period_watch_stop(void)
+{
+	watch_state = PERIOD_WATCH_OFF;
+}
+
+// ----------------------------------------------------------------------------
+period_watch_state_t period_watch_get_state(void)
+{
+	return watch_state;
+}
+
+// ----------------------------------------------------------------------------
+static void period_watch_learn(const can_t *msg, uint16_t now)
+{
+	id_table_result_t result;
+	uint8_t slot = id_table_insert(watch_keys, PERIOD_WATCH_SIZE,
+			id_table_key(msg), &result);
+	
+	watch_entry_t *entry = &watch_entry[slot];
+	
+	if (result != ID_TABLE_FOUND) {
+		entry->state = WATCH_LEARNING;
+		entry->min = 0xffff;
+		entry->max = 0;
+	}
+	else {
+		uint16_t interval = now - entry->last;
+		
+		if (interval < entry->min)
+			entry->min = interval;
+		if (interval > entry->max)
+			entry->max = interval;
+	}
+	
+	entry->last = now;
+}
+
+// ----------------------------------------------------------------------------
+void period_watch_update(const can_t *msg)
+{
+	uint16_t now = systime_ms();
+	
+	if (watch_state == PERIOD_WATCH_TRAINING) {
+		period_watch_learn(msg, now);
+		return;
+	}
+	else if (watch_state != PERIOD_WATCH_ACTIVE) {
+		return;
+	}
+	
+	uint32_t key = id_table_key(msg);
+	uint8_t slot = id_table_find(watch_keys, PERIOD_WATCH_SIZE, key);
+	if (slot == ID_TABLE_NONE)
+		return;
+	
+	watch_entry_t *entry = &watch_entry[slot];
+	uint16_t interval = now - entry->last;
+	
+	if (entry->state == WATCH_MISSING) {
+		event_push(PERIOD_WATCH_EVENT, 'r', key, interval);
+		entry->state = WATCH_ARMED;
+	}
+	else if (entry->state == WATCH_ARMED && entry->period > entry->tolerance &&
+			 interval < entry->period - entry->tolerance) {
+		event_push(PERIOD_WATCH_EVENT, 'e', key, interval);
+	}
+	
+	entry->last = now;
+}
+
+// ----------------------------------------------------------------------------
+static void period_watch_arm(void)
+{
+	for (uint8_t i = 0; i < PERIOD_WATCH_SIZE; i++)
+	{
+		watch_entry_t *entry = &watch_entry[i];
+		
+		if (watch_keys[i] == ID_TABLE_EMPTY)
+			continue;
+		
+		if (entry->max == 0) {
+			// weniger als zwei Nachrichten empfangen
+			entry->state = WATCH_IGNORED;
+			continue;
+		}
+		
+		uint16_t period = ((uint32_t) entry->min + entry->max) / 2;
+		uint16_t jitter = (entry->max - entry->min) / 2;
+		
+		entry->period = period;
+		entry->tolerance = jitter + (uint32_t) period * PERIOD_WATCH_TOLERANCE / 100;
+		entry->state = WATCH_ARMED;
+	}
+	
+	watch_state = PERIOD_WATCH_ACTIVE;
+}
+
+// ----------------------------------------------------------------------------
+void period_watch_poll(void)
+{
+	if (watch_state == PERIOD_WATCH_OFF)
+		return;
+	
+	// only check once every 10 ms
+	uint16_t now = systime_ms();
+	if ((uint16_t) (now - watch_last_poll) < 10)
+		return;
+	watch_last_poll = now;
+	
+	if (watch_state == PERIOD_WATCH_TRAINING) {
+		if (systime_elapsed(watch_training_end))
+			period_watch_arm();
+		return;
+	}
+	
+	for (uint8_t i = 0; i < PERIOD_WATCH_SIZE; i++)
+	{
+		watch_entry_t *entry = &watch_entry[i];
+		
+		if (watch_keys[i] == ID_TABLE_EMPTY || entry->state != WATCH_ARMED)
+			continue;
+		
+		uint16_t elapsed = now - entry->last;
+		if (elapsed > (uint32_t) entry->period + entry->tolerance) {
+			if (event_push(PERIOD_WATCH_EVENT, 'm', watch_keys[i], elapsed))
+				entry->state = WATCH_MISSING;
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+bool period_watch_get(uint8_t n, uint32_t *key, uint16_t *period,
+		uint16_t *tolerance, bool *missing)
+{
+	watch_entry_t *entry = &watch_entry[n];
+	
+	if (watch_state != PERIOD_WATCH_ACTIVE || watch_keys[n] == ID_TABLE_EMPTY ||
+		entry->state == WATCH_IGNORED)
+		return false;
+	
+	*key = watch_keys[n];
+	*period = entry->period;
+	*tolerance = entry->tolerance;
+	*missing = (entry->state == WATCH_MISSING);
+	
+	return true;
+}
@@ -0,0 +1,84 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	PERIOD_WATCH_H
+#define	PERIOD_WATCH_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Supervision of cyclic messages
+ *
+ * During a training window the shortest and longest interval of each
+ * identifier are measured. Afterwards the period is taken as the middle
+ * of both, the allowed deviation as half of the jitter plus
+ * PERIOD_WATCH_TOLERANCE percent of the period.
+ *
+ * Deviations are reported as events of type 'w' (see event_queue.h):
+ * 'm' the message is missing (value = ms since the last message), 'e' it
+ * arrived too early (value = interval) and 'r' it reappeared after it was
+ * missing (value = length of the gap).
+ *
+ * Identifiers not seen during the training are ignored.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+
+#define	PERIOD_WATCH_EVENT		'w'
+
+// ----------------------------------------------------------------------------
+typedef enum {
+	PERIOD_WATCH_OFF,
+	PERIOD_WATCH_TRAINING,
+	PERIOD_WATCH_ACTIVE
+} period_watch_state_t;
+
+// ----------------------------------------------------------------------------
+// Forgets all identifiers and starts a training window of the given
+// length (max. 30000 ms)
+
+extern bool period_watch_start(uint16_t training);
+
+// ----------------------------------------------------------------------------
+extern void period_watch_stop(void);
+
+// ----------------------------------------------------------------------------
+extern period_watch_state_t period_watch_get_state(void);
+
+// ----------------------------------------------------------------------------
+extern void period_watch_update(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+// Ends the training and checks for missing messages, has to be called
+// regularly from the main loop.
+
+extern void period_watch_poll(void);
+
+// ----------------------------------------------------------------------------
+// Returns true if the slot n (0..PERIOD_WATCH_SIZE-1) holds a supervised
+// identifier
+
+extern bool period_watch_get(uint8_t n, uint32_t *key, uint16_t *period,
+		uint16_t *tolerance, bool *missing);
+
+#endif	// PERIOD_WATCH_H
@@ -0,0 +1,124 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include "pool.h"
+
+#include "utils.h"
+
+pool_block_t pool_blocks[POOL_SIZE];
+
+static uint8_t pool_free_list;
+static uint8_t pool_free_count;
+
+static uint8_t pool_used[2];
+static uint8_t pool_peak[2];
+static uint8_t pool_reserve[2] = { POOL_RX_RESERVE, POOL_TX_RESERVE };
+static uint16_t pool_failed[2];
+
+// ----------------------------------------------------------------------------
+void pool_init(void)
+{
+	for (uint8_t i = 0; i < POOL_SIZE - 1; i++)
+		pool_blocks[i].next = i + 1;
+	pool_blocks[POOL_SIZE - 1].next = POOL_NONE;
+	
+	pool_free_list = 0;
+	pool_free_count = POOL_SIZE;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t pool_alloc(pool_owner_t owner)
+{
+	pool_owner_t other = (owner == POOL_RX) ? POOL_TX : POOL_RX;
+	
+	// blocks still reserved for the other direction
+	uint8_t reserved = 0;
+	if (pool_used[other] < pool_reserve[other])
+		reserved = pool_reserve[other] - pool_used[other];
+	
+	if (pool_free_count <= reserved) {
+		pool_failed[owner]++;
+		return POOL_NONE;
+	}
+	
+	uint8_t block = pool_free_list;
+	pool_free_list = pool_blocks[block].next;
+	pool_free_count--;
+	
+	pool_blocks[block].next = POOL_NONE;
+	
+	pool_used[owner]++;
+	if (pool_used[owner] > pool_peak[owner])
+		pool_peak[owner] = pool_used[owner];
+	
+	return block;
+}
+
+// ----------------------------------------------------------------------------
+void pool_free(pool_owner_t owner, uint8_t block)
+{
+	pool_blocks[block].next = pool_free_list;
+	pool_free_list = block;
+	pool_free_count++;
+	
+	pool_used[owner]--;
+}
+
+// ----------------------------------------------------------------------------
+bool pool_set_reserve(uint8_t rx, uint8_t tx)
+{
+	if ((uint16_t) rx + tx > POOL_SIZE)
+		return false;
+	
+	pool_reserve[POOL_RX] = rx;
+	pool_reserve[POOL_TX] = tx;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t pool_get_reserve(pool_owner_t owner)
+{
+	return pool_reserve[owner];
+}
+
+// ----------------------------------------------------------------------------
+uint8_t pool_get_free(void)
+{
+	return pool_free_count;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t pool_get_used(pool_owner_t owner)
+{
+	return pool_used[owner];
+}
+
+// ----------------------------------------------------------------------------
+uint8_t pool_get_peak(pool_owner_t owner)
+{
+	return pool_peak[owner];
+}
+
+// ----------------------------------------------------------------------------
+uint16_t pool_get_failed(pool_owner_t owner)
+{
+	return pool_failed[owner];
+}
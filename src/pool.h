@@ -0,0 +1,107 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	POOL_H
+#define	POOL_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Shared memory pool for the RX and TX queues
+ *
+ * The pool consists of POOL_SIZE blocks with one message each. Both
+ * directions allocate from the same pool, a minimum number of blocks is
+ * reserved for each direction so that one direction can not starve the
+ * other one completely.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+
+#define	POOL_NONE		0xff
+
+#if POOL_SIZE >= POOL_NONE
+	#error	POOL_SIZE too large
+#endif
+
+// ----------------------------------------------------------------------------
+typedef enum {
+	POOL_RX = 0,
+	POOL_TX = 1
+} pool_owner_t;
+
+// ----------------------------------------------------------------------------
+typedef struct {
+	can_t msg;
+	uint8_t next;			//!< next block in the queue or POOL_NONE
+	union {
+		uint8_t filter;		//!< RX: filter code returned by can_get_message()
+		uint8_t flags;		//!< TX: options of the message
+	};
+	uint16_t deadline;		//!< TX: the message is discarded after this time
+} pool_block_t;
+
+extern pool_block_t pool_blocks[POOL_SIZE];
+
+// ----------------------------------------------------------------------------
+static inline pool_block_t * pool_get(uint8_t block)
+{
+	return &pool_blocks[block];
+}
+
+// ----------------------------------------------------------------------------
+extern void pool_init(void);
+
+// ----------------------------------------------------------------------------
+// Returns the index of a free block or POOL_NONE
+
+extern uint8_t pool_alloc(pool_owner_t owner);
+
+// ----------------------------------------------------------------------------
+extern void pool_free(pool_owner_t owner, uint8_t block);
+
+// ----------------------------------------------------------------------------
+// Sets the number of blocks reserved for each direction. Returns false if
+// the sum exceeds the size of the pool.
+
+extern bool pool_set_reserve(uint8_t rx, uint8_t tx);
+
+// ----------------------------------------------------------------------------
+extern uint8_t pool_get_reserve(pool_owner_t owner);
+
+// ----------------------------------------------------------------------------
+extern uint8_t pool_get_free(void);
+
+// ----------------------------------------------------------------------------
+extern uint8_t pool_get_used(pool_owner_t owner);
+
+// ----------------------------------------------------------------------------
+// Maximum number of blocks used at the same time
+
+extern uint8_t pool_get_peak(pool_owner_t owner);
+
+// ----------------------------------------------------------------------------
+// Number of failed allocations
+
+extern uint16_t pool_get_failed(pool_owner_t owner);
+
+#endif	// POOL_H
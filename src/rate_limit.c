@@ -0,0 +1,176 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "rate_limit.h"
+#include "id_table.h"
+#include "systime.h"
+
+#if (RATE_STATE_SIZE & (RATE_STATE_SIZE - 1)) != 0
+	#error	RATE_STATE_SIZE must be a power of two
+#endif
+
+#define	RATE_NO_RULE	0xff
+
+typedef struct {
+	uint16_t count;
+	uint16_t time;		// last time a message was forwarded
+} rate_state_t;
+
+static rate_limit_rule_t rate_rules[RATE_RULE_COUNT];
+static uint8_t rate_rule_count;
+
+static uint32_t rate_keys[RATE_STATE_SIZE];
+static rate_state_t rate_state[RATE_STATE_SIZE];
+
+static uint16_t rate_dropped;
+
+// ----------------------------------------------------------------------------
+static uint8_t rate_limit_find_rule(const can_t *msg)
+{
+	#if SUPPORT_EXTENDED_CANID
+	bool extended = msg->flags.extended;
+	#else
+	bool extended = false;
+	#endif
+	
+	for (uint8_t i = 0; i < rate_rule_count; i++)
+	{
+		const rate_limit_rule_t *rule = &rate_rules[i];
+		
+		if (rule->extended == extended && msg->id >= rule->first && msg->id <= rule->last)
+			return i;
+	}
+	
+	return RATE_NO_RULE;
+}
+
+// ----------------------------------------------------------------------------
+bool rate_limit_add(const rate_limit_rule_t *rule)
+{
+	uint32_t max = (rule->extended) ? 0x1fffffff : 0x7ff;
+	
+	if (rate_rule_count >= RATE_RULE_COUNT || rule->value == 0 ||
+		rule->first > rule->last || rule->last > max)
+		return false;
+	
+	rate_rules[rate_rule_count++] = *rule;
+	
+	// the cached rules are no longer valid
+	id_table_clear(rate_keys, RATE_STATE_SIZE);
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+bool rate_limit_remove(uint8_t n)
+{
+	if (n >= rate_rule_count)
+		return false;
+	
+	rate_rule_count--;
+	memmove(&rate_rules[n], &rate_rules[n + 1],
+			(rate_rule_count - n) * sizeof(rate_limit_rule_t));
+	
+	id_table_clear(rate_keys, RATE_STATE_SIZE);
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+void rate_limit_clear(void)
+{
+	rate_rule_count = 0;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t rate_limit_get_count(void)
+{
+	return rate_rule_count;
+}
+
+// ----------------------------------------------------------------------------
+const rate_limit_rule_t * rate_limit_get(uint8_t n)
+{
+	if (n >= rate_rule_count)
+		return NULL;
+	
+	return &rate_rules[n];
+}
+
+// ----------------------------------------------------------------------------
+bool rate_limit_check(const can_t *msg)
+{
+	if (rate_rule_count == 0)
+		return true;
+	
+	// only identifiers with a rule get a state, all others would evict them
+	uint8_t n = rate_limit_find_rule(msg);
+	if (n == RATE_NO_RULE)
+		return true;
+	
+	id_table_result_t result;
+	uint8_t slot = id_table_insert(rate_keys, RATE_STATE_SIZE,
+			id_table_key(msg), &result);
+	
+	rate_state_t *state = &rate_state[slot];
+	uint16_t now = systime_ms();
+	
+	if (result != ID_TABLE_FOUND)
+	{
+		state->count = 0;
+		state->time = now;
+		
+		// Only the first message of a new identifier is forwarded. If the
+		// state of another identifier was evicted, forwarding would let
+		// identifiers which evict each other pass without any limit.
+		if (result == ID_TABLE_NEW)
+			return true;
+		
+		rate_dropped++;
+		return false;
+	}
+	
+	const rate_limit_rule_t *rule = &rate_rules[n];
+	
+	if (rule->type == RATE_LIMIT_DECIMATE) {
+		if (++state->count < rule->value) {
+			rate_dropped++;
+			return false;
+		}
+		state->count = 0;
+	}
+	else {
+		if ((uint16_t) (now - state->time) < rule->value) {
+			rate_dropped++;
+			return false;
+		}
+		state->time = now;
+	}
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+uint16_t rate_limit_get_dropped(void)
+{
+	return rate_dropped;
+}
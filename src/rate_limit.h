@@ -0,0 +1,88 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	RATE_LIMIT_H
+#define	RATE_LIMIT_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Reduce the rate of received messages per identifier
+ *
+ * Up to RATE_RULE_COUNT rules apply to a range of identifiers. Each
+ * identifier of the range is handled separately: either only every n-th
+ * message is forwarded (decimation) or at most one message within the
+ * given interval.
+ *
+ * The rules are searched for every message, only identifiers with a rule
+ * get a state in a hash table of RATE_STATE_SIZE entries. The first
+ * message of an identifier is forwarded. If more identifiers with a rule
+ * are active than the table holds they evict each other; a message which
+ * evicts another identifier is dropped and starts a new state, so the
+ * limit is never exceeded.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+
+// ----------------------------------------------------------------------------
+typedef enum {
+	RATE_LIMIT_DECIMATE = 0,	//!< forward every n-th message
+	RATE_LIMIT_INTERVAL = 1		//!< at most one message per n ms
+} rate_limit_type_t;
+
+typedef struct {
+	uint32_t first;
+	uint32_t last;
+	bool extended;
+	rate_limit_type_t type;
+	uint16_t value;
+} rate_limit_rule_t;
+
+// ----------------------------------------------------------------------------
+// Returns false if the rule is invalid or all rules are used
+
+extern bool rate_limit_add(const rate_limit_rule_t *rule);
+
+// ----------------------------------------------------------------------------
+extern bool rate_limit_remove(uint8_t n);
+
+// ----------------------------------------------------------------------------
+extern void rate_limit_clear(void);
+
+// ----------------------------------------------------------------------------
+extern uint8_t rate_limit_get_count(void);
+
+// ----------------------------------------------------------------------------
+extern const rate_limit_rule_t * rate_limit_get(uint8_t n);
+
+// ----------------------------------------------------------------------------
+// Returns true if the message should be forwarded
+
+extern bool rate_limit_check(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+// Number of messages dropped by the rules
+
+extern uint16_t rate_limit_get_dropped(void);
+
+#endif	// RATE_LIMIT_H
@@ -0,0 +1,279 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "request.h"
+#include "id_table.h"
+#include "event_queue.h"
+#include "tx_queue.h"
+#include "mob_manager.h"
+#include "systime.h"
+
+#if SUPPORT_REQUEST
+
+#define	NONE		0xff
+
+static request_t request_table[REQUEST_COUNT];
+static request_stats_t request_stats[REQUEST_COUNT];
+static uint16_t request_next_time[REQUEST_COUNT];
+static bool request_done[REQUEST_COUNT];	// entries with interval 0
+static uint8_t request_count;
+
+static bool request_running;
+static uint8_t request_last = NONE;		// entry sent last
+static uint8_t request_pending = NONE;	// entry waiting for the response
+static bool request_on_bus;			// request_sent is valid
+static uint32_t request_sent;		// ticks, end of the request frame
+static uint16_t request_deadline;
+
+static request_result_t request_result[REQUEST_RESULTS];
+static uint8_t request_result_head;
+static uint8_t request_result_count;
+
+
+// ----------------------------------------------------------------------------
+int8_t request_add(const request_t *request)
+{
+	if (request_count >= REQUEST_COUNT)
+		return -1;
+	
+	request_table[request_count] = *request;
+	memset(&request_stats[request_count], 0, sizeof(request_stats_t));
+	request_next_time[request_count] = systime_ms();
+	request_done[request_count] = false;
+	
+	return request_count++;
+}
+
+// ----------------------------------------------------------------------------
+bool request_remove(uint8_t n)
+{
+	if (n >= request_count)
+		return false;
+	
+	// die Tabelle aendert sich, laufende Anfrage vergessen
+	request_pending = NONE;
+	
+	request_count--;
+	memmove(&request_table[n], &request_table[n + 1], (request_count - n) * sizeof(request_t));
+	memmove(&request_stats[n], &request_stats[n + 1], (request_count - n) * sizeof(request_stats_t));
+	memmove(&request_next_time[n], &request_next_time[n + 1], (request_count - n) * sizeof(uint16_t));
+	memmove(&request_done[n], &request_done[n + 1], (request_count - n) * sizeof(bool));
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+void request_clear(void)
+{
+	request_count = 0;
+	request_pending = NONE;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t request_get_count(void)
+{
+	return request_count;
+}
+
+// ----------------------------------------------------------------------------
+const request_t * request_get(uint8_t n)
+{
+	return &request_table[n];
+}
+
+// ----------------------------------------------------------------------------
+const request_stats_t * request_get_stats(uint8_t n)
+{
+	return &request_stats[n];
+}
+
+// ----------------------------------------------------------------------------
+void request_start(void)
+{
+	uint16_t now = systime_ms();
+	
+	for (uint8_t i = 0; i < request_count; i++) {
+		request_next_time[i] = now;
+		request_done[i] = false;
+	}
+	
+	request_last = NONE;
+	request_pending = NONE;
+	request_running = true;
+}
+
+// ----------------------------------------------------------------------------
+void request_stop(void)
+{
+	request_running = false;
+	request_pending = NONE;
+}
+
+// ----------------------------------------------------------------------------
+bool request_is_running(void)
+{
+	return request_running;
+}
+
+// ----------------------------------------------------------------------------
+bool request_check(const can_t *msg)
+{
+	if (request_pending == NONE ||
+		request_table[request_pending].response_key != id_table_key(msg))
+		return true;
+	
+	// the response may be read before tx_queue_pump() noticed the
+	// transmission of the request
+	if (!request_on_bus)
+		tx_queue_pump();
+	if (!request_on_bus)
+		return true;
+	
+	// from the end of the request to the time stamp of the response
+	#if SUPPORT_TIMESTAMPS
+	uint32_t received = mob_stamp_to_ticks(msg->timestamp);
+	#else
+	uint32_t received = systime_ticks();
+	#endif
+	uint32_t latency = (received - request_sent) * 4;
+	uint8_t n = request_pending;
+	
+	request_pending = NONE;
+	request_stats[n].responses++;
+	request_stats[n].latency = latency;
+	
+	// request_poll() sendet nur wenn ein Eintrag frei ist
+	uint8_t pos = request_result_head + request_result_count;
+	if (pos >= REQUEST_RESULTS)
+		pos -= REQUEST_RESULTS;
+	
+	request_result[pos].entry = n;
+	request_result[pos].latency = latency;
+	request_result[pos].msg = *msg;
+	request_result_count++;
+	
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+// Sucht reihum den naechsten faelligen Eintrag
+
+static uint8_t request_find_due(void)
+{
+	uint8_t n = request_last;
+	
+	for (uint8_t i = 0; i < request_count; i++)
+	{
+		n = (n + 1 >= request_count) ? 0 : n + 1;
+		
+		if (request_table[n].interval == 0) {
+			if (!request_done[n])
+				return n;
+		}
+		else if (systime_elapsed(request_next_time[n])) {
+			return n;
+		}
+	}
+	
+	return NONE;
+}
+
+// ----------------------------------------------------------------------------
+void request_poll(void)
+{
+	if (!request_running)
+		return;
+	
+	if (request_pending != NONE)
+	{
+		if (!systime_elapsed(request_deadline))
+			return;
+		
+		request_stats[request_pending].timeouts++;
+		event_push(REQUEST_EVENT, 't', request_pending,
+				request_table[request_pending].timeout);
+		request_pending = NONE;
+	}
+	
+	// keine Antwort annehmen fuer die kein Platz ist
+	if (request_result_count >= REQUEST_RESULTS)
+		return;
+	
+	uint8_t n = request_find_due();
+	if (n == NONE)
+		return;
+	
+	const request_t *request = &request_table[n];
+	const tx_options_t options = {
+		.queue = REQUEST_TX_QUEUE,
+		.timeout = 0,
+		.one_shot = false,
+		.tag = TX_TAG_REQUEST | n
+	};
+	
+	request_on_bus = false;
+	if (!tx_queue_send(&request->msg, &options))
+		return;
+	tx_queue_pump();
+	
+	uint16_t now = systime_ms();
+	
+	request_deadline = now + request->timeout;
+	request_next_time[n] = now + request->interval;
+	request_done[n] = true;
+	request_last = n;
+	request_pending = n;
+}
+
+// ----------------------------------------------------------------------------
+void request_tx_done(uint8_t n, uint32_t time)
+{
+	if (n != request_pending)
+		return;
+	
+	request_sent = time;
+	request_on_bus = true;
+}
+
+// ----------------------------------------------------------------------------
+const request_result_t * request_peek(void)
+{
+	if (request_result_count == 0)
+		return NULL;
+	
+	return &request_result[request_result_head];
+}
+
+// ----------------------------------------------------------------------------
+void request_commit(void)
+{
+	if (request_result_count == 0)
+		return;
+	
+	request_result_head++;
+	if (request_result_head >= REQUEST_RESULTS)
+		request_result_head = 0;
+	
+	request_result_count--;
+}
+
+#endif	// SUPPORT_REQUEST
@@ -0,0 +1,140 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	REQUEST_H
+#define	REQUEST_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Request engine for polling OBD-II PIDs or UDS DIDs
+ *
+ * The host uploads a table of request frames together with the identifier
+ * of the response, a timeout and a repeat interval. While running, the
+ * requests are sent one after another: the next request follows directly
+ * after the response or the timeout of the previous one. An entry with an
+ * interval of 0 is only sent once after request_start().
+ *
+ * The response is returned as a result together with the number of the
+ * entry and the time between the end of the request frame on the bus (the
+ * time stamp of the MOb when the TX queue sees the transmission) and the
+ * time stamp of the response. Responses are matched by their identifier
+ * only, one request is outstanding at a time. A missing response is
+ * reported as event of type 'q' (see event_queue.h) with code 't', the
+ * number of the entry as key and the timeout as value.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+
+#define	REQUEST_EVENT			'q'
+
+// the number of the entry is reported in the tag of the TX queue
+#if REQUEST_COUNT > 16
+	#error	REQUEST_COUNT too large
+#endif
+
+// ----------------------------------------------------------------------------
+typedef struct {
+	can_t msg;				//!< request frame
+	uint32_t response_key;	//!< identifier of the response, see id_table_key()
+	uint16_t timeout;		//!< ms
+	uint16_t interval;		//!< ms, 0 = once
+} request_t;
+
+// ----------------------------------------------------------------------------
+typedef struct {
+	uint8_t entry;
+	uint32_t latency;		//!< us
+	can_t msg;				//!< response
+} request_result_t;
+
+// ----------------------------------------------------------------------------
+typedef struct {
+	uint16_t responses;
+	uint16_t timeouts;
+	uint32_t latency;		//!< of the last response in us
+} request_stats_t;
+
+// ----------------------------------------------------------------------------
+// Returns the number of the new entry or -1 if the table is full
+
+extern int8_t request_add(const request_t *request);
+
+// ----------------------------------------------------------------------------
+extern bool request_remove(uint8_t n);
+
+// ----------------------------------------------------------------------------
+extern void request_clear(void);
+
+// ----------------------------------------------------------------------------
+extern uint8_t request_get_count(void);
+
+// ----------------------------------------------------------------------------
+extern const request_t * request_get(uint8_t n);
+
+// ----------------------------------------------------------------------------
+extern const request_stats_t * request_get_stats(uint8_t n);
+
+// ----------------------------------------------------------------------------
+extern void request_start(void);
+
+// ----------------------------------------------------------------------------
+extern void request_stop(void);
+
+// ----------------------------------------------------------------------------
+extern bool request_is_running(void);
+
+// ----------------------------------------------------------------------------
+// Matches a received message against the outstanding request. Returns
+// false if the message is the response.
+
+extern bool request_check(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+// Sends the next request and checks the timeout, has to be called
+// periodically.
+
+extern void request_poll(void);
+
+// ----------------------------------------------------------------------------
+// Called by the TX queue when the request of entry n was transmitted,
+// time in ticks of systime_ticks()
+
+extern void request_tx_done(uint8_t n, uint32_t time);
+
+// ----------------------------------------------------------------------------
+// Returns the oldest result or NULL
+
+extern const request_result_t * request_peek(void);
+
+// ----------------------------------------------------------------------------
+extern void request_commit(void);
+
+// ----------------------------------------------------------------------------
+#if !SUPPORT_REQUEST
+	#define	request_check(msg)			true
+	#define	request_poll()
+	#define	request_tx_done(n, time)
+#endif
+
+#endif	// REQUEST_H
@@ -0,0 +1,181 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include "rx_queue.h"
+
+#include "config.h"
+#include "utils.h"
+#include "idfilter.h"
+#include "change_filter.h"
+#include "rate_limit.h"
+#include "id_stats.h"
+#include "period_watch.h"
+#include "busload.h"
+#include "capture.h"
+#include "expr_filter.h"
+#include "signals.h"
+#include "isotp.h"
+#include "j1939.h"
+#include "request.h"
+#include "autoreply.h"
+#include "e2e.h"
+#include "gateway.h"
+#include "trigger_out.h"
+
+static uint8_t rx_head = POOL_NONE;
+static uint8_t rx_tail = POOL_NONE;
+
+#if SUPPORT_TIMESTAMPS
+static uint16_t rx_reordered;
+
+// ----------------------------------------------------------------------------
+// Inserts the block in front of all queued messages with a later
+// timestamp. can_get_message() delivers the messages in the order of the
+// MObs and not in the order of their reception, so messages received
+// shortly after each other by different MObs may be swapped.
+
+static void rx_queue_insert(uint8_t block)
+{
+	pool_block_t *entry = pool_get(block);
+	
+	// compare timestamps with respect to the overflow of CANTIM
+	if (rx_tail == POOL_NONE ||
+		(int16_t) (entry->msg.timestamp - pool_get(rx_tail)->msg.timestamp) >= 0)
+	{
+		// normal case: append the message
+		if (rx_tail == POOL_NONE)
+			rx_head = block;
+		else
+			pool_get(rx_tail)->next = block;
+		rx_tail = block;
+		return;
+	}
+	
+	uint8_t prev = POOL_NONE;
+	uint8_t pos = rx_head;
+	
+	while ((int16_t) (entry->msg.timestamp - pool_get(pos)->msg.timestamp) >= 0) {
+		prev = pos;
+		pos = pool_get(pos)->next;
+	}
+	
+	entry->next = pos;
+	if (prev == POOL_NONE)
+		rx_head = block;
+	else
+		pool_get(prev)->next = block;
+	
+	rx_reordered++;
+}
+
+// ----------------------------------------------------------------------------
+uint16_t rx_queue_get_reordered(void)
+{
+	return rx_reordered;
+}
+
+#else
+
+// ----------------------------------------------------------------------------
+static void rx_queue_insert(uint8_t block)
+{
+	if (rx_tail == POOL_NONE)
+		rx_head = block;
+	else
+		pool_get(rx_tail)->next = block;
+	rx_tail = block;
+}
+
+#endif
+
+// ----------------------------------------------------------------------------
+void rx_queue_poll(void)
+{
+	while (can_check_message())
+	{
+		can_t msg;
+		
+		uint8_t filter = can_get_message(&msg);
+		if (filter == 0)
+			break;
+		
+		// Trigger und Weiterleitung zuerst, damit die Latenz gering bleibt.
+		// Danach ISO-TP, die Flow Control muss innerhalb von N_Bs beim
+		// Steuergeraet sein.
+		trigger_out_update(&msg);
+		gateway_update(&msg);
+		bool forward = isotp_check(&msg);
+		
+		busload_add(&msg);
+		capture_record(&msg);
+		id_stats_update(&msg, filter);
+		period_watch_update(&msg);
+		autoreply_update(&msg);
+		e2e_update(&msg);
+		
+		if (!forward ||
+			!request_check(&msg) ||
+			!j1939_check(&msg) ||
+			!signals_check(&msg) ||
+			!idfilter_check(&msg) ||
+			!expr_check(&msg) ||
+			!rate_limit_check(&msg) ||
+			!change_filter_check(&msg)) {
+			continue;
+		}
+		
+		// Erst fuer die Ausgabe wird ein Block gebraucht. Ist keiner frei
+		// (langsamer Host), geht nur die Ausgabe dieser Nachricht verloren,
+		// pool_alloc() zaehlt sie als Fehlschlag.
+		uint8_t block = pool_alloc(POOL_RX);
+		if (block == POOL_NONE)
+			continue;
+		
+		rx_entry_t *slot = pool_get(block);
+		slot->msg = msg;
+		slot->filter = filter;
+		
+		rx_queue_insert(block);
+	}
+}
+
+// ----------------------------------------------------------------------------
+const rx_entry_t * rx_queue_peek(void)
+{
+	if (rx_head == POOL_NONE)
+		return NULL;
+	
+	return pool_get(rx_head);
+}
+
+// ----------------------------------------------------------------------------
+void rx_queue_commit(void)
+{
+	uint8_t block = rx_head;
+	
+	if (block == POOL_NONE)
+		return;
+	
+	rx_head = pool_get(block)->next;
+	if (rx_head == POOL_NONE)
+		rx_tail = POOL_NONE;
+	
+	pool_free(POOL_RX, block);
+}
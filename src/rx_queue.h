@@ -0,0 +1,67 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	RX_QUEUE_H
+#define	RX_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "pool.h"
+
+// ----------------------------------------------------------------------------
+// Received message (msg) together with the filter code that accepted it
+// (filter)
+
+typedef pool_block_t rx_entry_t;
+
+// ----------------------------------------------------------------------------
+// Moves new messages from the CAN controller into the queue. Every message
+// is fetched from the library and passed to the analysis functions
+// (statistics, supervision, ISO-TP, ...) first, only the messages for the
+// host are copied into a block of the pool. Messages rejected by the
+// software filters (idfilter.h, expr_filter.h) or the rate limiting
+// (rate_limit.h) and unchanged messages (change_filter.h) are dropped, as
+// are messages for which no block is free (see pool_get_failed()).
+
+extern void rx_queue_poll(void);
+
+// ----------------------------------------------------------------------------
+// Returns a pointer to the oldest message without removing it from the
+// queue or NULL if the queue is empty. The entry stays valid until
+// rx_queue_commit() is called.
+
+extern const rx_entry_t * rx_queue_peek(void);
+
+// ----------------------------------------------------------------------------
+// Releases the entry returned by the last call to rx_queue_peek().
+
+extern void rx_queue_commit(void);
+
+#if SUPPORT_TIMESTAMPS
+// ----------------------------------------------------------------------------
+// Number of messages that had to be moved in front of a message received
+// later to restore the order of reception.
+
+extern uint16_t rx_queue_get_reordered(void);
+#endif
+
+#endif	// RX_QUEUE_H
@@ -35,6 +35,32 @@
 #include "can.h"
 #include "utils.h"
 
+#include "rx_queue.h"
+#include "mob_manager.h"
+#include "tx_queue.h"
+#include "autobaud.h"
+#include "pool.h"
+#include "idfilter.h"
+#include "change_filter.h"
+#include "rate_limit.h"
+#include "id_stats.h"
+#include "period_watch.h"
+#include "event_queue.h"
+#include "busload.h"
+#include "capture.h"
+#include "filter_optimizer.h"
+#include "expr_filter.h"
+#include "signals.h"
+#include "isotp.h"
+#include "j1939.h"
+#include "request.h"
+#include "autoreply.h"
+#include "gateway.h"
+#include "trigger_out.h"
+#include "e2e.h"
+#include "id_table.h"
+#include "systime.h"
+
 // ----------------------------------------------------------------------------
 uint8_t show_help(char *param, char data);
 uint8_t show_man_page(char *param, char data);
@@ -44,16 +70,41 @@ uint8_t stop_output(char *param, char data);
 uint8_t send_can_messages(char *param, char data);
 uint8_t set_filter(char *param, char data);
 uint8_t set_bitrate(char *param, char data);
+uint8_t set_mobs(char *param, char data);
+uint8_t set_stage(char *param, char data);
+uint8_t set_pool(char *param, char data);
+uint8_t set_idfilter(char *param, char data);
+uint8_t set_change(char *param, char data);
+uint8_t set_rate(char *param, char data);
+uint8_t set_capture(char *param, char data);
+#if SUPPORT_SIGNALS
+uint8_t set_signal(char *param, char data);
+#endif
+#if SUPPORT_ISOTP
+uint8_t set_isotp(char *param, char data);
+#endif
+#if SUPPORT_REQUEST
+uint8_t set_request(char *param, char data);
+#endif
+#if SUPPORT_AUTOREPLY
+uint8_t set_reply(char *param, char data);
+#endif
+#if SUPPORT_E2E
+uint8_t set_e2e(char *param, char data);
+#endif
 uint8_t get_values(char *param, char data);
 uint8_t set_values(char *param, char data);
 uint8_t restart(char *param, char data);
-//uint8_t gateway(char *param, char data);
+#if SUPPORT_GATEWAY
+uint8_t gateway(char *param, char data);
+#endif
 //uint8_t led_control(char *param, char data);
 uint8_t print_hex(char *param, char data);
 uint8_t clear_screen(char *param, char data);
 uint8_t print_version(char *param, char data);
 
 uint8_t send_bulk_messages(char *param, char data);
+uint8_t run_benchmark(char *param, char data);
 // ----------------------------------------------------------------------------
 
 #define strncmp_flash(sram,sflash,n) strncmp_P(sram,PSTR(sflash),n)
@@ -75,7 +126,9 @@ static const char s_send_can2[] PROGMEM	= ">";
 static const char s_get[] PROGMEM		= "get";
 static const char s_set[] PROGMEM		= "set";
 
-//static const char s_gateway[] PROGMEM	= "gateway";
+#if SUPPORT_GATEWAY
+static const char s_gateway[] PROGMEM	= "gateway";
+#endif
 
 static const char s_start[] PROGMEM		= "start";
 static const char s_stop[] PROGMEM		= "stop";
@@ -84,6 +137,8 @@ static const char s_bulk[] PROGMEM		= "bulk";
 
 static const char s_version[] PROGMEM	= "version";
 
+static const char s_bench[] PROGMEM		= "bench";
+
 // ----------------------------------------------------------------------------
 
 const ShellProgram shell_program_list[] = {
@@ -100,7 +155,9 @@ const ShellProgram shell_program_list[] = {
 	
 	{ s_get,		3,	get_values		},
 	{ s_set,		3,	set_values		},
-//	{ s_gateway,	7,	gateway			},
+	#if SUPPORT_GATEWAY
+	{ s_gateway,	7,	gateway			},
+	#endif
 	
 	{ s_start,		5,	start_output	},
 	{ s_stop,		4,	stop_output		},
@@ -108,6 +165,8 @@ const ShellProgram shell_program_list[] = {
 	{ s_bulk,		4,	send_bulk_messages },
 	
 	{ s_version,	7,	print_version	},
+	
+	{ s_bench,		5,	run_benchmark	},
 };
 
 uint8_t shell_program_list_length = sizeof(shell_program_list)/sizeof(ShellProgram);
@@ -151,14 +210,18 @@ uint8_t show_help(char *param, char data)
 					"start  - restarts output\n" \
 					"stop   - stops output immediately\n" \
 					"led    - control LED status\n" \
-					"clear  - clear screen\n" \
+					"clear  - clear screen\n");
+		#if SUPPORT_GATEWAY
+		term_puts_P("gateway - rewrite and retransmit messages\n");
+		#endif
+		term_puts_P("bench  - measure the filter expression\n" \
 					"exit   - restart AVR\n" \
 					"\nTo get more information about a specific command type \"help %name%\"\n");
 	}
 	else {
 		if (!strncmp_P(s, s_send_can, 4)) {
 			vt100_setattr(1);
-			term_puts_P("send id length [rtr|data]\n\n");
+			term_puts_P("send [-p queue] [-t ms] [-1] id length [rtr|data]\n\n");
 			vt100_setattr(0);
 			
 			term_puts_P("Example:\n" \
@@ -166,7 +229,15 @@ uint8_t show_help(char *param, char data)
 			"bytes of data you have to type:\n" \
 			"  $ send 123 4 abcd5678\n"
 			"For better readability the arguments and the data tuples can "
-			"be separated by optional whitespaces.\n"
+			"be separated by optional whitespaces.\n\n"
+			"The message is put into the given TX queue (0 = highest "
+			"priority). Without -p the queue is selected by the CAN Id.\n"
+			"With -t the message is discarded if it could not be sent "
+			"within the given time in ms (up to 30000). -1 aborts the "
+			"transmission after the first error (one-shot). The error is "
+			"noticed by the main loop, until then the controller repeats "
+			"the frame automatically, so it may appear on the bus more "
+			"than once.\n"
 			);
 		}
 		else if (!strncmp_P(s, s_get, 3)) {
@@ -176,33 +247,428 @@ uint8_t show_help(char *param, char data)
 			
 			term_puts_P(
 			"Prints information about the specified filter. Without a given number " \
-			"the command generates a table with an overview of all filter.\n"
+			"the command generates a table with an overview of all filter.\n\n"
 			);
+			
+			vt100_setattr(1);
+			term_puts_P("get mobs\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Shows which message-objects are used for transmission " \
+			"and reception.\n\n");
+			
+			vt100_setattr(1);
+			term_puts_P("get idfilter\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Lists the identifiers of the software filter.\n\n");
+			
+			vt100_setattr(1);
+			term_puts_P("get rate\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Lists the rules of the rate limiting.\n\n");
+			
+			vt100_setattr(1);
+			term_puts_P("get stats [count|rate]\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Shows the statistics of all received identifiers, " \
+			"sorted by the number of messages or by the mean interval " \
+			"(times in ms). \"set stats clear\" resets them.\n\n");
+			
+			vt100_setattr(1);
+			term_puts_P("get watch\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Shows the learned period and allowed deviation of " \
+			"the supervised cyclic messages.\n\n");
+			
+			vt100_setattr(1);
+			term_puts_P("get busload\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Shows the load of the bus in percent during the last " \
+			"100 ms, the average of about one second and the peak. Only " \
+			"frames received or sent by the device are counted: with " \
+			"hardware filters or lost messages the value is too low.\n\n");
+			
+			vt100_setattr(1);
+			term_puts_P("get capture [dump]\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Shows the state of the capture or all recorded " \
+			"messages, the triggering message is marked with \"*\".\n\n");
+			
+			vt100_setattr(1);
+			term_puts_P("get expr\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Shows size and estimated cycles of the filter " \
+			"expression, \"bench\" measures it.\n\n");
+			
+			#if SUPPORT_SIGNALS
+			vt100_setattr(1);
+			term_puts_P("get signals\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Lists the signals decoded on the device.\n\n");
+			#endif
+			
+			#if SUPPORT_ISOTP
+			vt100_setattr(1);
+			term_puts_P("get isotp\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Shows the configuration of the ISO-TP channels.\n\n");
+			#endif
+			
+			#if SUPPORT_J1939
+			vt100_setattr(1);
+			term_puts_P("get j1939\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Shows the state of the J1939 reassembly.\n\n");
+			#endif
+			
+			#if SUPPORT_REQUEST
+			vt100_setattr(1);
+			term_puts_P("get request\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Shows the entries of the request engine with the " \
+			"number of responses, timeouts and the last latency.\n\n");
+			#endif
+			
+			#if SUPPORT_AUTOREPLY
+			vt100_setattr(1);
+			term_puts_P("get reply\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Shows the rules for automatic replies.\n\n");
+			#endif
+			
+			vt100_setattr(1);
+			term_puts_P("get trigger\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Shows the mode of the trigger output and the " \
+			"number of matches.\n");
+			
+			#if SUPPORT_E2E
+			vt100_setattr(1);
+			term_puts_P("\nget e2e\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Shows the checked identifiers with the number of " \
+			"valid messages, CRC errors, repeated and lost messages.\n");
+			#endif
 		}
 		else if (!strncmp_P(s, s_set, 3)) {
+			uint8_t item = 0;
+			
 			vt100_setattr(1);
-			term_puts_P("set bitrate|filter ...\n\n");
+			term_puts_P("set bitrate|filter|mobs|stage|pool|idfilter|change|rate|stats|watch|busload|capture|expr");
+			#if SUPPORT_SIGNALS
+			term_puts_P("|signal");
+			#endif
+			#if SUPPORT_ISOTP
+			term_puts_P("|isotp");
+			#endif
+			#if SUPPORT_J1939
+			term_puts_P("|j1939");
+			#endif
+			#if SUPPORT_REQUEST
+			term_puts_P("|request");
+			#endif
+			#if SUPPORT_AUTOREPLY
+			term_puts_P("|reply");
+			#endif
+			term_puts_P("|trigger");
+			#if SUPPORT_E2E
+			term_puts_P("|e2e");
+			#endif
+			term_puts_P(" ...\n\n");
 			vt100_setattr(0);
 			
-			term_puts_P("1. ");
+			term_put_int(++item);
+			term_puts_P(". ");
 			vt100_setattr(1);
-			term_puts_P("set bitrate [125|250|500|1000]\n\n");
+			term_puts_P("set bitrate [125|250|500|1000|auto]\n\n");
 			vt100_setattr(0);
 			
-			term_puts_P("Set a new bitrate for the CAN bus.\n\n");
+			term_puts_P("Set a new bitrate for the CAN bus. The filters are " \
+			"kept, the time the bus was not monitored is printed.\n" \
+			"\"auto\" listens to the bus in listen-only mode with all " \
+			"known bitrates for up to 100 ms each. A rate receiving 3 " \
+			"messages without any error is taken immediately, otherwise " \
+			"the rate with the fewest errors (then the most messages) is " \
+			"kept. Without any message the old bitrate is restored.\n\n");
 			
-			term_puts_P("2. ");
+			term_put_int(++item);
+			term_puts_P(". ");
 			vt100_setattr(1);
 			term_puts_P("set filter number [disable|mask id]\n\n");
 			vt100_setattr(0);
 			
 			term_puts_P("To receive all messages you simply have to type:\n" \
 			"  $ set filter n 0 0\n" \
-			"n is a one of the message-objects (0..14).\n\n"
+			"n is a one of the message-objects reserved for reception " \
+			"(see \"get mobs\").\n\n"
 			);
 			
+			vt100_setattr(1);
+			term_puts_P("set filter auto id [id ...]\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Calculates filters for all reception message-objects " \
+			"which let through the given identifiers and as few others " \
+			"as possible. The number of accepted identifiers is an " \
+			"upper bound as the filters may overlap.\n\n");
+			
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set mobs n\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Reserve the message-objects 0..n-1 for transmission, " \
+			"the others are used for reception. Every TX queue sends " \
+			"from one MOb at a time, so n is at most the number of " \
+			"queues. Lower numbers are matched first. Filters on MObs of " \
+			"the new TX range have to be removed before. Pending " \
+			"transmissions in MObs which become RX MObs are aborted if " \
+			"they don't finish within a few ms.\n\n");
+			
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set stage begin|apply\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("After \"begin\" changes of bitrate, filters and mobs " \
+			"are collected and activated together by \"apply\".\n\n");
+			
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set pool rx tx\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Received and outgoing messages share one pool of " \
+			"buffers. The given number of buffers is reserved for " \
+			"each direction (see \"version\" for the usage).\n\n");
+			
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set idfilter off|allow|deny|clear\n" \
+						"set idfilter add|del id [id ...]\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Software filter behind the message-objects. With " \
+			"\"allow\" only messages with a listed identifier are " \
+			"shown, with \"deny\" all others. Identifiers with more than " \
+			"three digits are extended identifiers.\n\n");
+			
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set change on [keepalive]|off\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Only show messages whose length or data differ from " \
+			"the last message with the same identifier. With a keepalive " \
+			"(in ms) unchanged messages are repeated after this time.\n\n");
+			
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set rate add first last every|ms n\n" \
+						"set rate del n|clear\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Limits the rate of each identifier between first and " \
+			"last: \"every\" shows only every n-th message, \"ms\" at most " \
+			"one message per n ms. Example:\n" \
+			"  $ set rate add 100 1ff ms 100\n\n");
+			
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set watch ms|off\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Learns the period of all cyclic messages for the " \
+			"given time (max. 30000 ms). Afterwards missing, too early " \
+			"and reappearing messages are reported with \"!\".\n\n");
+			
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set busload reset|leds on|off\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("\"reset\" clears the peak. With \"leds on\" the " \
+			"duo LEDs show the bus load instead of the mode (green/off " \
+			"< 25 %, green/green < 50 %, green/red < 75 %, red/red).\n\n");
+			
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set capture a id mask [data [mask]]\n" \
+						"set capture b ms id mask [data [mask]]|off\n" \
+						"set capture post n|arm|off\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Records all messages into a ring buffer until trigger " \
+			"a (or a followed by b within the given time) fires and n " \
+			"further messages were received. Example:\n" \
+			"  $ set capture a 123 7ff aa00 ff00\n" \
+			"  $ set capture arm\n\n");
+			
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set expr expression|off|save\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Only shows messages matching the expression. Tests: " \
+			"id=hex[-hex], dlc=n, dN=hex, dN:mask=hex, dN.bit, rtr, ext " \
+			"(also !=, <, <=, >, >=), combined with &, |, ! and (). " \
+			"\"save\" keeps the expression after reset. Example:\n" \
+			"  $ set expr id=100-1ff & d0.7 & dlc=8\n\n");
+			
+			#if SUPPORT_SIGNALS
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set signal add id start length le|be u|s factor offset [decimals]\n" \
+			"   set signal limit n low high\n" \
+			"   set signal event n change|limit|both|off\n" \
+			"   set signal del n|clear|save|stream on|off\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Decodes a signal (DBC notation, max. 4 bytes) of the " \
+			"message and shows it after the data as n=value with value = " \
+			"(raw * factor + offset) / 10^decimals. Limits are given in " \
+			"units of the last decimal. Events are shown as \"!:\", " \
+			"\"stream on\" suppresses all messages. Example:\n" \
+			"  $ set signal add 123 8 16 le u 5 -400 1\n\n");
+			#endif
+			
+			#if SUPPORT_ISOTP
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set isotp open n tx rx [bs stmin padding]\n" \
+			"   set isotp close n\n" \
+			"   set isotp send n byte...\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Opens an ISO-TP channel. Segmented messages with the " \
+			"rx identifier are reassembled and acknowledged with a flow " \
+			"control (block size, STmin) by the device and shown as " \
+			"\"!: isotp n length > data\". Frames are padded to 8 bytes " \
+			"(default cc). \"send\" takes as many bytes as fit into the " \
+			"line (about 10). Example:\n" \
+			"  $ set isotp open 0 7e0 7e8\n" \
+			"  $ set isotp send 0 22 f1 90\n\n");
+			#endif
+			
+			#if SUPPORT_J1939
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set j1939 on [address]|off\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Reassembles J1939 multi-packet messages (BAM and " \
+			"RTS/CTS) and shows them as \"!: j1939 pgn source -> " \
+			"destination length > data\". With an address the device " \
+			"answers RTS to it with CTS.\n\n");
+			#endif
+			
+			#if SUPPORT_REQUEST
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set request add id response timeout interval byte...\n" \
+			"   set request del n|clear|start|stop\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Sends the requests of the table one after another " \
+			"and shows the responses as \"!: request n latency: " \
+			"message\" with the latency in us from the end of the " \
+			"request frame to the response. An interval of 0 sends the " \
+			"request only once. Example (OBD-II engine speed every " \
+			"100 ms):\n" \
+			"  $ set request add 7df 7e8 50 100 02 01 0c 00 00 00 00 00\n" \
+			"  $ set request start\n\n");
+			#endif
+			
+			#if SUPPORT_AUTOREPLY
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set reply data id mask [data [mask]]\n" \
+			"   set reply remote id mask\n" \
+			"   set reply n send id byte...\n" \
+			"   set reply n delay ms\n" \
+			"   set reply n counter byte mask|off\n" \
+			"   set reply n checksum byte sum|xor|off\n" \
+			"   set reply del n|clear\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Answers matching data or remote frames directly on " \
+			"the device. Before each reply the counter bits are " \
+			"incremented and the checksum over the other bytes is " \
+			"updated. Example:\n" \
+			"  $ set reply remote 321 7ff\n" \
+			"  $ set reply 0 send 321 00 00 00 00\n" \
+			"  $ set reply 0 counter 0 0f\n\n");
+			#endif
+			
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set trigger id mask [data [mask]]\n" \
+			"   set trigger pin|led1|led2 pulse|toggle\n" \
+			"   set trigger off\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Pulses or toggles an output when a matching message " \
+			"arrives. Without data bytes the identifier is compared in " \
+			"the receive interrupt, about 20 us after the end of the " \
+			"frame. With data bytes the message is checked in the main " \
+			"loop which may take some ms. \"pin\" is the spare pin PE1 " \
+			"(PDO). Example:\n" \
+			"  $ set trigger 123 7ff aa\n" \
+			"  $ set trigger pin pulse\n\n");
+			
+			#if SUPPORT_E2E
+			term_put_int(++item);
+			term_puts_P(". ");
+			vt100_setattr(1);
+			term_puts_P("set e2e add id 1|2 data_id\n" \
+			"   set e2e n layout crc_byte|off counter_byte|off low|high [max_delta]\n" \
+			"   set e2e n list id0 ... id15\n" \
+			"   set e2e del n|clear|reset\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Checks CRC and counter of the AUTOSAR E2E profiles " \
+			"1 and 2 (CRC in byte 0, counter in the low nibble of byte " \
+			"1) for all received messages, also for filtered ones. " \
+			"Profile 2 selects the data ID by the counter from a list " \
+			"of 16 bytes, \"add\" fills it with the low byte of data_id. " \
+			"Violations are shown as \"!: id e2e ...\". Example:\n" \
+			"  $ set e2e add 123 1 0042\n" \
+			"  $ set e2e 0 layout 7 6 high 2\n\n");
+			#endif
+			
 			#if  HARDWARE_VERSION_MINOR >= 2
-			term_puts_P("3. ");
+			term_put_int(++item);
+			term_puts_P(". ");
 			vt100_setattr(1);
 			term_puts_P("set term on|off\n\n");
 			vt100_setattr(0);
@@ -210,6 +676,26 @@ uint8_t show_help(char *param, char data)
 			term_puts_P("Activate/Deactivate a 120 Ohm terminating resistor.\n\n");
 			#endif
 		}
+		#if SUPPORT_GATEWAY
+		else if (!strncmp_P(s, s_gateway, 7)) {
+			vt100_setattr(1);
+			term_puts_P("gateway [add id mask [data [mask]]|del n|clear]\n" \
+			"gateway n id id mask\n" \
+			"gateway n patch byte value [mask]\n" \
+			"gateway n scale byte length le|be factor offset|off\n\n");
+			vt100_setattr(0);
+			
+			term_puts_P("Retransmits matching messages with the bits of the " \
+			"identifier and data selected by the masks replaced. A field " \
+			"of 1 or 2 bytes can be scaled by factor/256 + offset. " \
+			"Without arguments the rules are listed with the hits and the " \
+			"latency from the reception to the end of the transmission " \
+			"of the copy. Example:\n" \
+			"  $ gateway add 100 7ff\n" \
+			"  $ gateway 0 id 500 7ff\n" \
+			"  $ gateway 0 scale 0 2 le 512 0\n\n");
+		}
+		#endif
 		else {
 			error("no help page available for this command");
 		}
@@ -236,13 +722,50 @@ uint8_t stop_output(char *param, char data)
 }
 
 // ----------------------------------------------------------------------------
-// send id length [rtr|data]
+// send [-p queue] [-t timeout] [-1] id length [rtr|data]
 
 uint8_t send_can_messages(char *param, char data)
 {
 	if (param != NULL) {
 		char *s = get_parameter(param, 1);
 		uint8_t length = get_parameter_length(s);
+		tx_options_t options = {
+			.queue = TX_QUEUE_AUTO,
+			.timeout = 0,
+			.one_shot = false
+		};
+		
+		// optional arguments
+		while (length == 2 && s[0] == '-')
+		{
+			if (s[1] == 'p') {
+				s = get_next_parameter(s);
+				if (get_parameter_length(s) != 1 || ((uint8_t)( *s - '0')) >= TX_QUEUE_COUNT) {
+					error("Invalid queue");
+					return 1;
+				}
+				options.queue = *s - '0';
+			}
+			else if (s[1] == 't') {
+				s = get_next_parameter(s);
+				
+				uint32_t timeout;
+				if (!term_get_long(s, &timeout, 10) || timeout == 0 || timeout > 30000) {
+					error("Invalid timeout");
+					return 1;
+				}
+				options.timeout = timeout;
+			}
+			else if (s[1] == '1') {
+				options.one_shot = true;
+			}
+			else {
+				goto error;
+			}
+			
+			s = get_next_parameter(s);
+			length = get_parameter_length(s);
+		}
 		
 		can_t m;
 		if (length > 8 || length == 0)
@@ -317,7 +840,7 @@ uint8_t send_can_messages(char *param, char data)
 			}
 		}
 		
-		if (!can_send_message(&m))
+		if (!tx_queue_send(&m, &options))
 			error("Could not send message");
 		
 		return 1;
@@ -333,6 +856,89 @@ uint8_t send_can_messages(char *param, char data)
 // ----------------------------------------------------------------------------
 // filter number [e|ext|extended] [r|rtr] [disable|mask id]
 
+// ----------------------------------------------------------------------------
+// filter auto id [id ...]
+
+static void set_filter_auto(char *s)
+{
+	filter_group_t groups[FILTER_AUTO_MAX_IDS];
+	uint8_t count = 0;
+	uint8_t length = get_parameter_length(s);
+	
+	while (length)
+	{
+		uint32_t id;
+		if (length > 8 || !term_get_long(s, &id, 16)) {
+			error("Invalid characters in CAN-ID");
+			return;
+		}
+		if (count >= FILTER_AUTO_MAX_IDS) {
+			error("Too many identifiers");
+			return;
+		}
+		
+		filter_group_init(&groups[count++], id, length > 3);
+		
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+	}
+	
+	if (count == 0) {
+		error("No identifiers given");
+		return;
+	}
+	
+	// Identifier doppelt angegeben?
+	uint8_t requested = 0;
+	for (uint8_t i = 0; i < count; i++) {
+		uint8_t k = 0;
+		while (k < i && !filter_group_covers(&groups[k], &groups[i]))
+			k++;
+		if (k == i)
+			requested++;
+	}
+	
+	uint8_t first = mob_get_tx_count();
+	uint8_t n = filter_optimize(groups, count, MOB_COUNT - first);
+	if (n == 0) {
+		error("Not enough message-objects");
+		return;
+	}
+	
+	// program the filters, the remaining RX MObs are disabled. Merged
+	// filters may overlap, so the sum of their sizes is only an upper
+	// bound for the number of accepted identifiers. It is limited to the
+	// size of the identifier space to not overflow with many wide filters.
+	const uint32_t id_space = (1UL << 29) + (1UL << 11);
+	uint32_t accepted = 0;
+	for (uint8_t i = 0; i < MOB_COUNT - first; i++)
+	{
+		if (i < n) {
+			can_filter_t filter;
+			
+			filter.id = groups[i].id;
+			filter.mask = groups[i].mask;
+			filter.flags.extended = (groups[i].extended) ? 0x3 : 0x2;
+			filter.flags.rtr = 0;
+			
+			mob_set_filter(first + i, &filter);
+			accepted += filter_group_size(&groups[i]);
+			if (accepted > id_space)
+				accepted = id_space;
+			
+			printf_P(PSTR("%2d : %8lx %8lx\n"), first + i, filter.mask, filter.id);
+		}
+		else {
+			mob_disable_filter(first + i);
+		}
+	}
+	
+	printf_P(PSTR("%u filters for %u identifiers, at most %lu identifiers " \
+				  "accepted (max. %lu %% false accepts)\n"), n, requested, accepted,
+			100 - (uint32_t) requested * 100 / accepted);
+}
+
+// ----------------------------------------------------------------------------
 uint8_t set_filter(char *param, char data)
 {
 	char *s = get_next_parameter(param);
@@ -343,15 +949,26 @@ uint8_t set_filter(char *param, char data)
 		return 1;
 	}
 	
+	if (!strncmp_flash(s, "auto", 4) && length == 4) {
+		set_filter_auto(get_next_parameter(s));
+		return 1;
+	}
+	
 	// Filter anlegen
 	can_filter_t filter;
 	
 	int number;
-	if (sscanf_P(s, PSTR("%i"), &number) != 1 || number > 14) {
+	if (sscanf_P(s, PSTR("%i"), &number) != 1 || number < 0 ||
+		number > 14) {
 		error("Invaild filter number");
 		return 1;
 	}
 	
+	if (mob_get_role(number) == MOB_TX) {
+		error("MOb is reserved for transmission");
+		return 1;
+	}
+	
 	s = get_next_parameter(s);
 	length = get_parameter_length(s);
 	
@@ -404,7 +1021,7 @@ uint8_t set_filter(char *param, char data)
 		// im String steht.
 		length = get_parameter_length(s);
 		if (length == 7 && !strncmp_flash(s, "disable", 7)) {
-			if (!can_disable_filter(number)) {
+			if (!mob_disable_filter(number)) {
 				error("Could not disable filter");
 			}
 			return 1;
@@ -413,13 +1030,47 @@ uint8_t set_filter(char *param, char data)
 		return 1;
 	}
 	
-	if (!can_set_filter(number, &filter))
+	if (!mob_set_filter(number, &filter))
 		error("Could not set filter");
 	return 1;
 }
 
 // ----------------------------------------------------------------------------
-// bitrate [125|250|500|1000]
+static void print_blind_time(void)
+{
+	if (!mob_is_staging()) {
+		printf_P(PSTR("blind time: %u us\n"), mob_get_blind_time());
+	}
+}
+
+// ----------------------------------------------------------------------------
+// stage begin|apply
+
+uint8_t set_stage(char *param, char data)
+{
+	char *s = get_parameter(param, 1);
+	uint8_t length = get_parameter_length(s);
+	
+	if (!strncmp_flash(s, "begin", 5) && length == 5) {
+		mob_begin();
+	}
+	else if (!strncmp_flash(s, "apply", 5) && length == 5) {
+		mob_commit();
+		print_blind_time();
+	}
+	else {
+		error("Unknown option. Should be \"begin\" or \"apply\"");
+	}
+	return 1;
+}
+
+// ----------------------------------------------------------------------------
+static const uint16_t bitrate_kbps[] PROGMEM = {
+	10, 20, 50, 100, 125, 250, 500, 1000
+};
+
+// ----------------------------------------------------------------------------
+// bitrate [125|250|500|1000|auto]
 
 uint8_t set_bitrate(char *param, char data)
 {
@@ -431,6 +1082,27 @@ uint8_t set_bitrate(char *param, char data)
 		return 1;
 	}
 	
+	if (!strncmp_flash(s, "auto", 4) && length == 4)
+	{
+		can_mode_t mode = mob_get_mode();
+		
+		uint8_t rate = autobaud_detect();
+		if (rate == AUTOBAUD_NONE) {
+			error("No bitrate detected");
+			return 1;
+		}
+		
+		if (rate & AUTOBAUD_CUSTOM) {
+			printf_P(PSTR("detected custom bit timing %u\n"), rate & ~AUTOBAUD_CUSTOM);
+		}
+		else {
+			printf_P(PSTR("detected %u kbps\n"), pgm_read_word(&bitrate_kbps[rate]));
+		}
+		
+		mob_set_mode(mode);
+		return 1;
+	}
+	
 	// read bitrate
 	int bitrate;
 	if (sscanf_P(s, PSTR("%i"), &bitrate) != 1) {
@@ -439,15 +1111,17 @@ uint8_t set_bitrate(char *param, char data)
 	
 	// try to set bitrate
 	if (bitrate == 125)
-		can_init(BITRATE_125_KBPS);
+		mob_init(BITRATE_125_KBPS);
 	else if (bitrate == 250)
-		can_init(BITRATE_250_KBPS);
+		mob_init(BITRATE_250_KBPS);
 	else if (bitrate == 500)
-		can_init(BITRATE_500_KBPS);
+		mob_init(BITRATE_500_KBPS);
 	else if (bitrate == 1000)
-		can_init(BITRATE_1_MBPS);
+		mob_init(BITRATE_1_MBPS);
 	else
 		goto bitrate_error;
+	
+	print_blind_time();
 	return 1;
 	
 bitrate_error:
@@ -456,19 +1130,1135 @@ bitrate_error:
 }
 
 // ----------------------------------------------------------------------------
-// get filter [number]
+// mobs n
 
-uint8_t get_values(char *param, char data)
+uint8_t set_mobs(char *param, char data)
 {
 	char *s = get_parameter(param, 1);
-	uint8_t length = get_parameter_length(s);
 	
-	if (!length) {
-		// no parameters
-		return 1;
+	int number;
+	if (sscanf_P(s, PSTR("%i"), &number) != 1 || number < 1 || number > TX_QUEUE_COUNT) {
+		error("Invalid number of TX MObs (1.." STRING(TX_QUEUE_COUNT) ")");
 	}
-	
-	if (!strncmp_flash(s, "filter", 6) && length == 6)
+	else if (!mob_set_partition(number)) {
+		error("Filters set on MObs of the new TX range, remove them first");
+	}
+	return 1;
+}
+
+// ----------------------------------------------------------------------------
+// pool rx tx
+
+uint8_t set_pool(char *param, char data)
+{
+	char *s = get_parameter(param, 1);
+	
+	int rx, tx;
+	if (sscanf_P(s, PSTR("%i %i"), &rx, &tx) != 2 || rx < 0 || tx < 0 ||
+			!pool_set_reserve(rx, tx)) {
+		error("Invalid reservation (rx + tx must not exceed the pool size)");
+	}
+	return 1;
+}
+
+// ----------------------------------------------------------------------------
+// idfilter off|allow|deny|clear
+// idfilter add|del id [id ...]
+
+uint8_t set_idfilter(char *param, char data)
+{
+	char *s = get_parameter(param, 1);
+	uint8_t length = get_parameter_length(s);
+	
+	if (!strncmp_flash(s, "off", 3) && length == 3) {
+		idfilter_set_mode(IDFILTER_OFF);
+	}
+	else if (!strncmp_flash(s, "allow", 5) && length == 5) {
+		idfilter_set_mode(IDFILTER_ALLOW);
+	}
+	else if (!strncmp_flash(s, "deny", 4) && length == 4) {
+		idfilter_set_mode(IDFILTER_DENY);
+	}
+	else if (!strncmp_flash(s, "clear", 5) && length == 5) {
+		idfilter_clear();
+	}
+	else if ((!strncmp_flash(s, "add", 3) || !strncmp_flash(s, "del", 3)) && length == 3)
+	{
+		bool add = (s[0] == 'a');
+		
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		if (length == 0) {
+			error("Missing identifier");
+			return 1;
+		}
+		
+		while (length)
+		{
+			uint32_t id;
+			if (length > 8 || !term_get_long(s, &id, 16)) {
+				error("Invalid characters in CAN-ID");
+				return 1;
+			}
+			
+			bool extended = (length > 3);
+			if (add && !idfilter_add(id, extended)) {
+				error("Invalid identifier or table full");
+				return 1;
+			}
+			else if (!add && !idfilter_remove(id, extended)) {
+				error("Identifier not found");
+				return 1;
+			}
+			
+			s = get_next_parameter(s);
+			length = get_parameter_length(s);
+		}
+	}
+	else {
+		error("Unknown option");
+	}
+	
+	return 1;
+}
+
+// ----------------------------------------------------------------------------
+// change on [keepalive]|off
+
+uint8_t set_change(char *param, char data)
+{
+	char *s = get_parameter(param, 1);
+	uint8_t length = get_parameter_length(s);
+	
+	if (!strncmp_flash(s, "off", 3) && length == 3) {
+		change_filter_disable();
+	}
+	else if (!strncmp_flash(s, "on", 2) && length == 2) {
+		uint32_t keepalive = 0;
+		
+		s = get_next_parameter(s);
+		if (get_parameter_length(s) &&
+			(!term_get_long(s, &keepalive, 10) || keepalive > 60000)) {
+			error("Invalid keepalive (0..60000 ms)");
+			return 1;
+		}
+		change_filter_enable(keepalive);
+	}
+	else {
+		error("Unknown option. Should be \"on\" or \"off\"");
+	}
+	
+	return 1;
+}
+
+// ----------------------------------------------------------------------------
+// rate add first last every|ms n
+// rate del n|clear
+
+uint8_t set_rate(char *param, char data)
+{
+	char *s = get_parameter(param, 1);
+	uint8_t length = get_parameter_length(s);
+	
+	if (!strncmp_flash(s, "clear", 5) && length == 5) {
+		rate_limit_clear();
+	}
+	else if (!strncmp_flash(s, "del", 3) && length == 3) {
+		int number;
+		s = get_next_parameter(s);
+		if (sscanf_P(s, PSTR("%i"), &number) != 1 || !rate_limit_remove(number))
+			error("Invalid rule");
+	}
+	else if (!strncmp_flash(s, "add", 3) && length == 3)
+	{
+		rate_limit_rule_t rule;
+		uint32_t value;
+		
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		if (length == 0 || length > 8 || !term_get_long(s, &rule.first, 16))
+			goto error;
+		rule.extended = (length > 3);
+		
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		if (length == 0 || length > 8 || !term_get_long(s, &rule.last, 16))
+			goto error;
+		
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		if (!strncmp_flash(s, "every", 5) && length == 5)
+			rule.type = RATE_LIMIT_DECIMATE;
+		else if (!strncmp_flash(s, "ms", 2) && length == 2)
+			rule.type = RATE_LIMIT_INTERVAL;
+		else
+			goto error;
+		
+		s = get_next_parameter(s);
+		if (!term_get_long(s, &value, 10) || value > 60000)
+			goto error;
+		rule.value = value;
+		
+		if (!rate_limit_add(&rule))
+			error("Invalid rule or no free rule");
+	}
+	else {
+		goto error;
+	}
+	
+	return 1;
+	
+error:
+	error("Wrong format");
+	return 1;
+}
+
+// ----------------------------------------------------------------------------
+// Sortiert die Eintraege der Statistik absteigend nach Anzahl der Nachrichten
+// oder aufsteigend nach dem mittleren Abstand
+
+static uint8_t sort_stats(uint8_t *order, bool by_rate)
+{
+	uint8_t count = 0;
+	
+	for (uint8_t i = 0; i < ID_STATS_SIZE; i++)
+	{
+		if (id_stats_get_key(i) == ID_TABLE_EMPTY)
+			continue;
+		
+		const id_stats_t *entry = id_stats_get(i);
+		uint8_t pos = count;
+		
+		while (pos > 0)
+		{
+			const id_stats_t *prev = id_stats_get(order[pos - 1]);
+			
+			if (by_rate) {
+				uint16_t a = id_stats_get_mean(entry);
+				uint16_t b = id_stats_get_mean(prev);
+				
+				// Eintraege ohne Abstand (nur eine Nachricht) ans Ende
+				if (a == 0 || (b != 0 && b <= a))
+					break;
+			}
+			else if (prev->count >= entry->count) {
+				break;
+			}
+			
+			order[pos] = order[pos - 1];
+			pos--;
+		}
+		
+		order[pos] = i;
+		count++;
+	}
+	
+	return count;
+}
+
+// ----------------------------------------------------------------------------
+// Liest einen Trigger: id mask [data [mask]]
+
+static bool parse_trigger(char *s, capture_trigger_t *trigger)
+{
+	uint8_t length = get_parameter_length(s);
+	if (length == 0 || length > 8 || !term_get_long(s, &trigger->id, 16))
+		return false;
+	trigger->extended = (length > 3);
+	
+	s = get_next_parameter(s);
+	length = get_parameter_length(s);
+	if (length == 0 || length > 8 || !term_get_long(s, &trigger->mask, 16))
+		return false;
+	
+	// Datenbytes und deren Maske
+	s = get_next_parameter(s);
+	length = get_parameter_length(s);
+	if ((length & 0x01) || length > 16)
+		return false;
+	
+	trigger->length = length / 2;
+	for (uint8_t i = 0; i < trigger->length; i++) {
+		if (!isxdigit(s[2 * i]) || !isxdigit(s[2 * i + 1]))
+			return false;
+		trigger->data[i] = hex_to_byte(&s[2 * i]);
+		trigger->data_mask[i] = 0xff;
+	}
+	
+	s = get_next_parameter(s);
+	length = get_parameter_length(s);
+	if (length == 0)
+		return true;
+	if (length != trigger->length * 2)
+		return false;
+	
+	for (uint8_t i = 0; i < trigger->length; i++) {
+		if (!isxdigit(s[2 * i]) || !isxdigit(s[2 * i + 1]))
+			return false;
+		trigger->data_mask[i] = hex_to_byte(&s[2 * i]);
+	}
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+// capture a id mask [data [mask]]
+// capture b ms id mask [data [mask]]|off
+// capture post n|arm|off
+
+uint8_t set_capture(char *param, char data)
+{
+	char *s = get_parameter(param, 1);
+	uint8_t length = get_parameter_length(s);
+	capture_trigger_t trigger;
+	
+	if (!strncmp_flash(s, "a", 1) && length == 1) {
+		if (!parse_trigger(get_next_parameter(s), &trigger))
+			goto error;
+		capture_set_trigger_a(&trigger);
+	}
+	else if (!strncmp_flash(s, "b", 1) && length == 1) {
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		
+		uint32_t window;
+		if (!strncmp_flash(s, "off", 3) && length == 3) {
+			capture_set_trigger_b(NULL, 0);
+		}
+		else if (!term_get_long(s, &window, 10) || window > 30000 ||
+				 !parse_trigger(get_next_parameter(s), &trigger) ||
+				 !capture_set_trigger_b(&trigger, window)) {
+			goto error;
+		}
+	}
+	else if (!strncmp_flash(s, "post", 4) && length == 4) {
+		int number;
+		s = get_next_parameter(s);
+		if (sscanf_P(s, PSTR("%i"), &number) != 1 || number < 0 ||
+			number > 255 || !capture_set_post(number)) {
+			printf_P(PSTR("Invalid number (0..%u)\n"), CAPTURE_SIZE - 1);
+		}
+	}
+	else if (!strncmp_flash(s, "arm", 3) && length == 3) {
+		capture_arm();
+	}
+	else if (!strncmp_flash(s, "off", 3) && length == 3) {
+		capture_stop();
+	}
+	else {
+		goto error;
+	}
+	
+	return 1;
+	
+error:
+	error("Wrong format");
+	return 1;
+}
+
+#if SUPPORT_SIGNALS
+
+// ----------------------------------------------------------------------------
+// signal add id start length le|be u|s factor offset [decimals]
+// signal limit n low high
+// signal event n change|limit|both|off
+// signal del n|clear|save
+// signal stream on|off
+
+uint8_t set_signal(char *param, char data)
+{
+	char *s = get_parameter(param, 1);
+	uint8_t length = get_parameter_length(s);
+	int number;
+	
+	if (!strncmp_flash(s, "clear", 5) && length == 5) {
+		signals_clear();
+	}
+	else if (!strncmp_flash(s, "save", 4) && length == 4) {
+		signals_save();
+	}
+	else if (!strncmp_flash(s, "del", 3) && length == 3) {
+		s = get_next_parameter(s);
+		if (sscanf_P(s, PSTR("%i"), &number) != 1 || !signals_remove(number))
+			error("Invalid signal");
+	}
+	else if (!strncmp_flash(s, "stream", 6) && length == 6) {
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		
+		if (!strncmp_flash(s, "on", 2) && length == 2)
+			signals_set_streaming(true);
+		else if (!strncmp_flash(s, "off", 3) && length == 3)
+			signals_set_streaming(false);
+		else
+			error("Unknown option. Should be \"on\" or \"off\"");
+	}
+	else if (!strncmp_flash(s, "limit", 5) && length == 5) {
+		long low, high;
+		
+		s = get_next_parameter(s);
+		if (sscanf_P(s, PSTR("%i"), &number) != 1)
+			goto error;
+		s = get_next_parameter(s);
+		if (sscanf_P(s, PSTR("%li"), &low) != 1)
+			goto error;
+		s = get_next_parameter(s);
+		if (sscanf_P(s, PSTR("%li"), &high) != 1)
+			goto error;
+		
+		if (!signals_set_thresholds(number, low, high))
+			error("Invalid signal or limits");
+	}
+	else if (!strncmp_flash(s, "event", 5) && length == 5) {
+		uint8_t events = 0;
+		
+		s = get_next_parameter(s);
+		if (sscanf_P(s, PSTR("%i"), &number) != 1)
+			goto error;
+		
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		if (!strncmp_flash(s, "change", 6) && length == 6)
+			events = SIGNAL_ON_CHANGE;
+		else if (!strncmp_flash(s, "limit", 5) && length == 5)
+			events = SIGNAL_ON_THRESHOLD;
+		else if (!strncmp_flash(s, "both", 4) && length == 4)
+			events = SIGNAL_ON_CHANGE | SIGNAL_ON_THRESHOLD;
+		else if (strncmp_flash(s, "off", 3) || length != 3)
+			goto error;
+		
+		if (!signals_set_events(number, events))
+			error("Invalid signal");
+	}
+	else if (!strncmp_flash(s, "add", 3) && length == 3)
+	{
+		signal_t signal;
+		uint32_t value;
+		long offset;
+		
+		memset(&signal, 0, sizeof(signal));
+		
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		if (length == 0 || length > 8 || !term_get_long(s, &value, 16))
+			goto error;
+		signal.key = (length > 3) ? (value | 0x80000000) : value;
+		
+		s = get_next_parameter(s);
+		if (!term_get_long(s, &value, 10) || value > 63)
+			goto error;
+		signal.start = value;
+		
+		s = get_next_parameter(s);
+		if (!term_get_long(s, &value, 10) || value > 32)
+			goto error;
+		signal.length = value;
+		
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		if (!strncmp_flash(s, "be", 2) && length == 2)
+			signal.flags |= SIGNAL_BIG_ENDIAN;
+		else if (strncmp_flash(s, "le", 2) || length != 2)
+			goto error;
+		
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		if (!strncmp_flash(s, "s", 1) && length == 1)
+			signal.flags |= SIGNAL_SIGNED;
+		else if (strncmp_flash(s, "u", 1) || length != 1)
+			goto error;
+		
+		s = get_next_parameter(s);
+		if (sscanf_P(s, PSTR("%i"), &number) != 1)
+			goto error;
+		signal.factor = number;
+		
+		s = get_next_parameter(s);
+		if (sscanf_P(s, PSTR("%li"), &offset) != 1)
+			goto error;
+		signal.offset = offset;
+		
+		s = get_next_parameter(s);
+		if (get_parameter_length(s)) {
+			if (!term_get_long(s, &value, 10) || value > 6)
+				goto error;
+			signal.decimals = value;
+		}
+		
+		signal.low = INT32_MIN;
+		signal.high = INT32_MAX;
+		
+		int8_t n = signals_add(&signal);
+		if (n < 0)
+			error("Invalid signal (max. 4 bytes) or table full");
+		else
+			printf_P(PSTR("signal %d\n"), n);
+	}
+	else {
+		goto error;
+	}
+	
+	return 1;
+	
+error:
+	error("Wrong format");
+	return 1;
+}
+
+#endif
+
+#if SUPPORT_ISOTP || SUPPORT_REQUEST || SUPPORT_AUTOREPLY || SUPPORT_E2E
+
+// ----------------------------------------------------------------------------
+// Liest einen Identifier, mehr als drei Stellen ergeben einen extended
+// Identifier (Format von id_table_key())
+
+static bool get_key(char *s, uint32_t *key)
+{
+	uint8_t length = get_parameter_length(s);
+	
+	if (length == 0 || length > 8 || !term_get_long(s, key, 16))
+		return false;
+	
+	if (length > 3)
+		*key |= 0x80000000;
+	
+	return true;
+}
+
+#endif
+
+#if SUPPORT_ISOTP || SUPPORT_REQUEST || SUPPORT_AUTOREPLY || SUPPORT_GATEWAY || \
+	SUPPORT_E2E
+
+// ----------------------------------------------------------------------------
+static void put_key(uint32_t key)
+{
+	if (key & 0x80000000)
+		printf_P(PSTR("%08lx"), key & 0x1fffffff);
+	else
+		printf_P(PSTR("%3lx"), key);
+}
+
+#endif
+
+#if SUPPORT_ISOTP
+
+// ----------------------------------------------------------------------------
+// isotp open n tx rx [bs stmin padding]
+// isotp close n
+// isotp send n byte...
+
+uint8_t set_isotp(char *param, char data)
+{
+	char *s = get_parameter(param, 1);
+	uint8_t length = get_parameter_length(s);
+	uint32_t value;
+	uint8_t channel;
+	
+	char *t = get_next_parameter(s);
+	if (!term_get_long(t, &value, 10) || value >= ISOTP_CHANNELS)
+		goto error;
+	channel = value;
+	t = get_next_parameter(t);
+	
+	if (!strncmp_flash(s, "open", 4) && length == 4)
+	{
+		isotp_config_t config = {
+			.block_size = 0,
+			.st_min = 0,
+			.padding = 0xcc
+		};
+		
+		if (!get_key(t, &config.tx_key))
+			goto error;
+		t = get_next_parameter(t);
+		if (!get_key(t, &config.rx_key))
+			goto error;
+		
+		t = get_next_parameter(t);
+		if (get_parameter_length(t))
+		{
+			if (!term_get_long(t, &value, 16) || value > 0xff)
+				goto error;
+			config.block_size = value;
+			
+			t = get_next_parameter(t);
+			if (!term_get_long(t, &value, 16) || value > 0xff)
+				goto error;
+			config.st_min = value;
+			
+			t = get_next_parameter(t);
+			if (!term_get_long(t, &value, 16) || value > 0xff)
+				goto error;
+			config.padding = value;
+		}
+		
+		if (!isotp_open(channel, &config))
+			error("Identifiers must differ");
+	}
+	else if (!strncmp_flash(s, "close", 5) && length == 5)
+	{
+		isotp_close(channel);
+	}
+	else if (!strncmp_flash(s, "send", 4) && length == 4)
+	{
+		uint8_t buffer[ISOTP_TX_SIZE];
+		uint8_t count = 0;
+		
+		while (get_parameter_length(t))
+		{
+			if (count >= ISOTP_TX_SIZE || !term_get_long(t, &value, 16) || value > 0xff)
+				goto error;
+			buffer[count++] = value;
+			t = get_next_parameter(t);
+		}
+		
+		if (!isotp_send(channel, buffer, count))
+			error("Channel closed or busy");
+	}
+	else {
+		goto error;
+	}
+	
+	return 1;
+	
+error:
+	error("Wrong format");
+	return 1;
+}
+
+#endif
+
+#if SUPPORT_REQUEST
+
+// ----------------------------------------------------------------------------
+// request add id response timeout interval byte...
+// request del n|clear|start|stop
+
+uint8_t set_request(char *param, char data)
+{
+	char *s = get_parameter(param, 1);
+	uint8_t length = get_parameter_length(s);
+	
+	if (!strncmp_flash(s, "clear", 5) && length == 5) {
+		request_clear();
+	}
+	else if (!strncmp_flash(s, "start", 5) && length == 5) {
+		request_start();
+	}
+	else if (!strncmp_flash(s, "stop", 4) && length == 4) {
+		request_stop();
+	}
+	else if (!strncmp_flash(s, "del", 3) && length == 3) {
+		int number;
+		s = get_next_parameter(s);
+		if (sscanf_P(s, PSTR("%i"), &number) != 1 || !request_remove(number))
+			error("Invalid entry");
+	}
+	else if (!strncmp_flash(s, "add", 3) && length == 3)
+	{
+		request_t request;
+		uint32_t value;
+		
+		s = get_next_parameter(s);
+		if (!get_key(s, &value))
+			goto error;
+		request.msg.id = value & 0x1fffffff;
+		request.msg.flags.extended = (value & 0x80000000) ? 1 : 0;
+		request.msg.flags.rtr = 0;
+		
+		s = get_next_parameter(s);
+		if (!get_key(s, &request.response_key))
+			goto error;
+		
+		s = get_next_parameter(s);
+		if (!term_get_long(s, &value, 10) || value == 0 || value > 60000)
+			goto error;
+		request.timeout = value;
+		
+		s = get_next_parameter(s);
+		if (!term_get_long(s, &value, 10) || value > 60000)
+			goto error;
+		request.interval = value;
+		
+		uint8_t count = 0;
+		s = get_next_parameter(s);
+		while (get_parameter_length(s))
+		{
+			if (count >= 8 || !term_get_long(s, &value, 16) || value > 0xff)
+				goto error;
+			request.msg.data[count++] = value;
+			s = get_next_parameter(s);
+		}
+		request.msg.length = count;
+		
+		int8_t n = request_add(&request);
+		if (n < 0)
+			error("Table full");
+		else
+			printf_P(PSTR("request %d\n"), n);
+	}
+	else {
+		goto error;
+	}
+	
+	return 1;
+	
+error:
+	error("Wrong format");
+	return 1;
+}
+
+#endif
+
+#if SUPPORT_AUTOREPLY
+
+// ----------------------------------------------------------------------------
+// reply data id mask [data [mask]]
+// reply remote id mask
+// reply n send id byte...
+// reply n delay ms
+// reply n counter byte mask|off
+// reply n checksum byte sum|xor|off
+// reply del n|clear
+
+uint8_t set_reply(char *param, char data)
+{
+	char *s = get_parameter(param, 1);
+	uint8_t length = get_parameter_length(s);
+	uint32_t value;
+	
+	if (!strncmp_flash(s, "clear", 5) && length == 5) {
+		autoreply_clear();
+		return 1;
+	}
+	else if (!strncmp_flash(s, "del", 3) && length == 3) {
+		s = get_next_parameter(s);
+		if (!term_get_long(s, &value, 10) || !autoreply_remove(value))
+			error("Invalid rule");
+		return 1;
+	}
+	else if ((!strncmp_flash(s, "data", 4) && length == 4) ||
+			 (!strncmp_flash(s, "remote", 6) && length == 6))
+	{
+		capture_trigger_t trigger;
+		bool remote = (length == 6);
+		
+		if (!parse_trigger(get_next_parameter(s), &trigger) ||
+			(remote && trigger.length != 0))
+			goto error;
+		
+		int8_t n = autoreply_add(&trigger, remote);
+		if (n < 0)
+			error("Table full");
+		else
+			printf_P(PSTR("rule %d\n"), n);
+		return 1;
+	}
+	
+	// Einstellungen einer Regel
+	if (!term_get_long(s, &value, 10) || value >= autoreply_get_count())
+		goto error;
+	
+	uint8_t n = value;
+	const autoreply_rule_t *rule = autoreply_get(n);
+	uint16_t delay = rule->delay;
+	uint8_t counter_byte = rule->counter_byte;
+	uint8_t counter_mask = rule->counter_mask;
+	uint8_t checksum_byte = rule->checksum_byte;
+	uint8_t checksum_type = rule->checksum_type;
+	
+	s = get_next_parameter(s);
+	length = get_parameter_length(s);
+	char *t = get_next_parameter(s);
+	
+	if (!strncmp_flash(s, "send", 4) && length == 4)
+	{
+		can_t reply;
+		
+		if (!get_key(t, &value))
+			goto error;
+		reply.id = value & 0x1fffffff;
+		reply.flags.extended = (value & 0x80000000) ? 1 : 0;
+		reply.flags.rtr = 0;
+		reply.length = 0;
+		
+		t = get_next_parameter(t);
+		while (get_parameter_length(t))
+		{
+			if (reply.length >= 8 || !term_get_long(t, &value, 16) || value > 0xff)
+				goto error;
+			reply.data[reply.length++] = value;
+			t = get_next_parameter(t);
+		}
+		
+		autoreply_set_reply(n, &reply);
+		return 1;
+	}
+	else if (!strncmp_flash(s, "delay", 5) && length == 5)
+	{
+		if (!term_get_long(t, &value, 10) || value > 30000)
+			goto error;
+		delay = value;
+	}
+	else if (!strncmp_flash(s, "counter", 7) && length == 7)
+	{
+		if (!strncmp_flash(t, "off", 3) && get_parameter_length(t) == 3) {
+			counter_byte = AUTOREPLY_NONE;
+		}
+		else {
+			if (!term_get_long(t, &value, 10) || value > 7)
+				goto error;
+			counter_byte = value;
+			
+			t = get_next_parameter(t);
+			if (!term_get_long(t, &value, 16) || value == 0 || value > 0xff)
+				goto error;
+			counter_mask = value;
+		}
+	}
+	else if (!strncmp_flash(s, "checksum", 8) && length == 8)
+	{
+		if (!strncmp_flash(t, "off", 3) && get_parameter_length(t) == 3) {
+			checksum_byte = AUTOREPLY_NONE;
+		}
+		else {
+			if (!term_get_long(t, &value, 10) || value > 7)
+				goto error;
+			checksum_byte = value;
+			
+			t = get_next_parameter(t);
+			length = get_parameter_length(t);
+			if (!strncmp_flash(t, "sum", 3) && length == 3)
+				checksum_type = AUTOREPLY_SUM;
+			else if (!strncmp_flash(t, "xor", 3) && length == 3)
+				checksum_type = AUTOREPLY_XOR;
+			else
+				goto error;
+		}
+	}
+	else {
+		goto error;
+	}
+	
+	autoreply_set_options(n, delay, counter_byte, counter_mask, checksum_byte,
+			checksum_type);
+	return 1;
+	
+error:
+	error("Wrong format");
+	return 1;
+}
+
+#endif
+
+#if SUPPORT_E2E
+
+// ----------------------------------------------------------------------------
+// e2e add id 1|2 data_id
+// e2e n layout crc_byte|off counter_byte|off low|high [max_delta]
+// e2e n list id0 ... id15
+// e2e del n|clear|reset
+
+uint8_t set_e2e(char *param, char data)
+{
+	char *s = get_parameter(param, 1);
+	uint8_t length = get_parameter_length(s);
+	uint32_t value;
+	
+	if (!strncmp_flash(s, "clear", 5) && length == 5) {
+		e2e_clear();
+		return 1;
+	}
+	else if (!strncmp_flash(s, "reset", 5) && length == 5) {
+		e2e_reset();
+		return 1;
+	}
+	else if (!strncmp_flash(s, "del", 3) && length == 3) {
+		s = get_next_parameter(s);
+		if (!term_get_long(s, &value, 10) || !e2e_remove(value))
+			error("Invalid entry");
+		return 1;
+	}
+	else if (!strncmp_flash(s, "add", 3) && length == 3)
+	{
+		uint32_t key;
+		
+		s = get_next_parameter(s);
+		if (!get_key(s, &key))
+			goto error;
+		
+		s = get_next_parameter(s);
+		if (!term_get_long(s, &value, 10) || value == 0 || value > 2)
+			goto error;
+		e2e_profile_t profile = value;
+		
+		s = get_next_parameter(s);
+		if (!term_get_long(s, &value, 16) || value > 0xffff)
+			goto error;
+		
+		int8_t n = e2e_add(key, profile, value);
+		if (n < 0)
+			error("Table full or identifier already used");
+		else
+			printf_P(PSTR("entry %d\n"), n);
+		return 1;
+	}
+	
+	// Aufbau der Nachricht
+	if (!term_get_long(s, &value, 10) || value >= e2e_get_count())
+		goto error;
+	
+	uint8_t n = value;
+	uint8_t crc_byte;
+	uint8_t counter_byte;
+	uint8_t counter_shift;
+	uint8_t max_delta = 1;
+	
+	s = get_next_parameter(s);
+	length = get_parameter_length(s);
+	if (!strncmp_flash(s, "list", 4) && length == 4)
+	{
+		uint8_t list[16];
+		
+		for (uint8_t i = 0; i < 16; i++) {
+			s = get_next_parameter(s);
+			if (!term_get_long(s, &value, 16) || value > 0xff)
+				goto error;
+			list[i] = value;
+		}
+		
+		if (!e2e_set_data_id_list(n, list))
+			error("Only for profile 2");
+		return 1;
+	}
+	else if (strncmp_flash(s, "layout", 6) || length != 6)
+		goto error;
+	
+	s = get_next_parameter(s);
+	if (!strncmp_flash(s, "off", 3) && get_parameter_length(s) == 3)
+		crc_byte = E2E_NONE;
+	else if (term_get_long(s, &value, 10) && value <= 7)
+		crc_byte = value;
+	else
+		goto error;
+	
+	s = get_next_parameter(s);
+	if (!strncmp_flash(s, "off", 3) && get_parameter_length(s) == 3)
+		counter_byte = E2E_NONE;
+	else if (term_get_long(s, &value, 10) && value <= 7)
+		counter_byte = value;
+	else
+		goto error;
+	
+	s = get_next_parameter(s);
+	length = get_parameter_length(s);
+	if (!strncmp_flash(s, "low", 3) && length == 3)
+		counter_shift = 0;
+	else if (!strncmp_flash(s, "high", 4) && length == 4)
+		counter_shift = 4;
+	else
+		goto error;
+	
+	s = get_next_parameter(s);
+	if (get_parameter_length(s)) {
+		if (!term_get_long(s, &value, 10) || value == 0 || value > 14)
+			goto error;
+		max_delta = value;
+	}
+	
+	if (!e2e_set_layout(n, crc_byte, counter_byte, counter_shift, max_delta))
+		error("Profile 2 needs the counter for the CRC");
+	return 1;
+	
+error:
+	error("Wrong format");
+	return 1;
+}
+
+#endif
+
+#if SUPPORT_GATEWAY
+
+// ----------------------------------------------------------------------------
+static void list_gateway_rules(void)
+{
+	for (uint8_t i = 0; i < gateway_get_count(); i++)
+	{
+		const gateway_rule_t *rule = gateway_get(i);
+		
+		printf_P(PSTR("%u: "), i);
+		put_key(rule->match.extended ? (rule->match.id | 0x80000000) : rule->match.id);
+		printf_P(PSTR("/%lx -> %lx/%lx"), rule->match.mask, rule->id, rule->id_mask);
+		
+		if (rule->scale_byte != GATEWAY_NO_SCALE) {
+			printf_P(PSTR(", scale d%u*%d/256%+d"), rule->scale_byte,
+					rule->scale_factor, rule->scale_offset);
+		}
+		
+		printf_P(PSTR(", %lu hits, %u us (max. %u us)\n"), rule->hits,
+				rule->latency, rule->latency_max);
+	}
+}
+
+// ----------------------------------------------------------------------------
+// gateway
+// gateway add id mask [data [mask]]
+// gateway n id id mask
+// gateway n patch byte value [mask]
+// gateway n scale byte length le|be factor offset|off
+// gateway del n|clear
+
+uint8_t gateway(char *param, char data)
+{
+	char *s = get_parameter(param, 1);
+	uint8_t length = get_parameter_length(s);
+	uint32_t value;
+	
+	if (length == 0) {
+		list_gateway_rules();
+		return 1;
+	}
+	else if (!strncmp_flash(s, "clear", 5) && length == 5) {
+		gateway_clear();
+		return 1;
+	}
+	else if (!strncmp_flash(s, "del", 3) && length == 3) {
+		s = get_next_parameter(s);
+		if (!term_get_long(s, &value, 10) || !gateway_remove(value))
+			error("Invalid rule");
+		return 1;
+	}
+	else if (!strncmp_flash(s, "add", 3) && length == 3) {
+		capture_trigger_t trigger;
+		
+		if (!parse_trigger(get_next_parameter(s), &trigger))
+			goto error;
+		
+		int8_t n = gateway_add(&trigger);
+		if (n < 0)
+			error("Table full");
+		else
+			printf_P(PSTR("rule %d\n"), n);
+		return 1;
+	}
+	
+	// Einstellungen einer Regel
+	if (!term_get_long(s, &value, 10) || value >= gateway_get_count())
+		goto error;
+	
+	uint8_t n = value;
+	
+	s = get_next_parameter(s);
+	length = get_parameter_length(s);
+	char *t = get_next_parameter(s);
+	
+	if (!strncmp_flash(s, "id", 2) && length == 2)
+	{
+		uint32_t id, mask;
+		
+		if (!term_get_long(t, &id, 16))
+			goto error;
+		t = get_next_parameter(t);
+		if (!term_get_long(t, &mask, 16))
+			goto error;
+		
+		gateway_set_id(n, id, mask);
+	}
+	else if (!strncmp_flash(s, "patch", 5) && length == 5)
+	{
+		const gateway_rule_t *rule = gateway_get(n);
+		uint8_t patch[8], mask[8];
+		
+		memcpy(patch, rule->patch, 8);
+		memcpy(mask, rule->patch_mask, 8);
+		
+		if (!term_get_long(t, &value, 10) || value > 7)
+			goto error;
+		uint8_t byte = value;
+		
+		t = get_next_parameter(t);
+		if (!term_get_long(t, &value, 16) || value > 0xff)
+			goto error;
+		patch[byte] = value;
+		mask[byte] = 0xff;
+		
+		t = get_next_parameter(t);
+		if (get_parameter_length(t)) {
+			if (!term_get_long(t, &value, 16) || value > 0xff)
+				goto error;
+			mask[byte] = value;
+		}
+		
+		gateway_set_patch(n, patch, mask);
+	}
+	else if (!strncmp_flash(s, "scale", 5) && length == 5)
+	{
+		uint8_t byte, size;
+		bool big_endian;
+		int factor, offset;
+		
+		if (!strncmp_flash(t, "off", 3) && get_parameter_length(t) == 3) {
+			gateway_set_scale(n, GATEWAY_NO_SCALE, 0, false, 0, 0);
+			return 1;
+		}
+		
+		if (!term_get_long(t, &value, 10) || value > 7)
+			goto error;
+		byte = value;
+		
+		t = get_next_parameter(t);
+		if (!term_get_long(t, &value, 10))
+			goto error;
+		size = value;
+		
+		t = get_next_parameter(t);
+		length = get_parameter_length(t);
+		if (!strncmp_flash(t, "be", 2) && length == 2)
+			big_endian = true;
+		else if (!strncmp_flash(t, "le", 2) && length == 2)
+			big_endian = false;
+		else
+			goto error;
+		
+		t = get_next_parameter(t);
+		if (sscanf_P(t, PSTR("%i"), &factor) != 1)
+			goto error;
+		t = get_next_parameter(t);
+		if (sscanf_P(t, PSTR("%i"), &offset) != 1)
+			goto error;
+		
+		if (!gateway_set_scale(n, byte, size, big_endian, factor, offset))
+			error("Invalid field (1 or 2 bytes)");
+	}
+	else {
+		goto error;
+	}
+	
+	return 1;
+	
+error:
+	error("Wrong format");
+	return 1;
+}
+
+#endif
+
+// ----------------------------------------------------------------------------
+// get filter [number]
+
+uint8_t get_values(char *param, char data)
+{
+	char *s = get_parameter(param, 1);
+	uint8_t length = get_parameter_length(s);
+	
+	if (!length) {
+		// no parameters
+		return 1;
+	}
+	
+	if (!strncmp_flash(s, "filter", 6) && length == 6)
 	{
 		s = get_next_parameter(s);
 		length = get_parameter_length(s);
@@ -568,6 +2358,375 @@ uint8_t get_values(char *param, char data)
 			}
 		}
 	}
+	else if (!strncmp_flash(s, "mobs", 4) && length == 4)
+	{
+		for (uint8_t i = 0; i < MOB_COUNT; i++)
+		{
+			printf_P(PSTR("%2d : "), i);
+			
+			switch (mob_get_role(i)) {
+				case MOB_TX:
+					term_puts_P("tx\n");
+					break;
+				case MOB_RX_USER:
+					term_puts_P("rx, user filter\n");
+					break;
+				case MOB_RX_CATCH_ALL:
+					term_puts_P("rx, all frames\n");
+					break;
+				default:
+					term_puts_P("rx, unused\n");
+					break;
+			}
+		}
+	}
+	else if (!strncmp_flash(s, "idfilter", 8) && length == 8)
+	{
+		switch (idfilter_get_mode()) {
+			case IDFILTER_ALLOW:
+				term_puts_P("mode: allow\n");
+				break;
+			case IDFILTER_DENY:
+				term_puts_P("mode: deny\n");
+				break;
+			default:
+				term_puts_P("mode: off\n");
+				break;
+		}
+		
+		printf_P(PSTR("%u standard identifiers:\n"), idfilter_get_standard_count());
+		for (uint16_t id = 0; id < 0x800; id++) {
+			if (idfilter_contains(id, false))
+				printf_P(PSTR("  %03x\n"), id);
+		}
+		
+		printf_P(PSTR("%u extended identifiers:\n"), idfilter_get_extended_count());
+		for (uint8_t i = 0; i < idfilter_get_extended_count(); i++) {
+			printf_P(PSTR("  %08lx\n"), idfilter_get_extended(i));
+		}
+		
+		printf_P(PSTR("%u messages dropped\n"), idfilter_get_dropped());
+	}
+	else if (!strncmp_flash(s, "rate", 4) && length == 4)
+	{
+		for (uint8_t i = 0; i < rate_limit_get_count(); i++)
+		{
+			const rate_limit_rule_t *rule = rate_limit_get(i);
+			
+			if (rule->extended)
+				printf_P(PSTR("%2d : %08lx - %08lx "), i, rule->first, rule->last);
+			else
+				printf_P(PSTR("%2d : %03lx - %03lx "), i, rule->first, rule->last);
+			
+			if (rule->type == RATE_LIMIT_DECIMATE)
+				printf_P(PSTR("every %u\n"), rule->value);
+			else
+				printf_P(PSTR("%u ms\n"), rule->value);
+		}
+		
+		printf_P(PSTR("%u messages dropped\n"), rate_limit_get_dropped());
+	}
+	else if (!strncmp_flash(s, "stats", 5) && length == 5)
+	{
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		
+		uint8_t order[ID_STATS_SIZE];
+		uint8_t count = sort_stats(order, !strncmp_flash(s, "rate", 4) && length == 4);
+		
+		#if CAN_RX_BUFFER_SIZE == 0
+		term_puts_P("      id      count   min   max  mean dlc mob\n" \
+					"--------------------------------------------\n");
+		#else
+		term_puts_P("      id      count   min   max  mean dlc\n" \
+					"----------------------------------------\n");
+		#endif
+		
+		for (uint8_t i = 0; i < count; i++)
+		{
+			uint32_t key = id_stats_get_key(order[i]);
+			const id_stats_t *entry = id_stats_get(order[i]);
+			
+			if (key & 0x80000000)
+				printf_P(PSTR("%08lx "), key & 0x1fffffff);
+			else
+				printf_P(PSTR("     %03lx "), key);
+			
+			printf_P(PSTR("%10lu %5u %5u %5u   %u"), entry->count,
+					(entry->count > 1) ? entry->min : 0, entry->max,
+					id_stats_get_mean(entry), entry->length);
+			#if CAN_RX_BUFFER_SIZE == 0
+			printf_P(PSTR("  %2u"), entry->filter - 1);
+			#endif
+			term_putc_cr('\n');
+		}
+		
+		printf_P(PSTR("%u evictions\n"), id_stats_get_evictions());
+	}
+	else if (!strncmp_flash(s, "capture", 7) && length == 7)
+	{
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		
+		uint8_t count = capture_get_count();
+		uint8_t trigger = capture_get_trigger_position();
+		
+		if (!strncmp_flash(s, "dump", 4) && length == 4)
+		{
+			for (uint8_t i = 0; i < count; i++)
+			{
+				const capture_frame_t *frame = capture_get(i);
+				const can_t *msg = &frame->msg;
+				
+				printf_P(PSTR("%c %5u: "), (i == trigger) ? '*' : ' ', frame->time);
+				if (msg->flags.extended)
+					printf_P(PSTR("%08lx %u"), msg->id, msg->length);
+				else
+					printf_P(PSTR("%8lx %u"), msg->id, msg->length);
+				
+				if (msg->flags.rtr) {
+					term_puts_P(" rtr");
+				}
+				else {
+					if (msg->length)
+						term_puts_P(" >");
+					for (uint8_t k = 0; k < msg->length; k++) {
+						term_putc(' ');
+						term_put_hex(msg->data[k]);
+					}
+				}
+				term_putc_cr('\n');
+			}
+		}
+		else
+		{
+			switch (capture_get_state()) {
+				case CAPTURE_ARMED:
+					term_puts_P("armed");
+					break;
+				case CAPTURE_WAIT_B:
+					term_puts_P("trigger a seen, waiting for b");
+					break;
+				case CAPTURE_TRIGGERED:
+					term_puts_P("triggered");
+					break;
+				case CAPTURE_DONE:
+					term_puts_P("done");
+					break;
+				default:
+					term_puts_P("off");
+					break;
+			}
+			printf_P(PSTR(", %u messages recorded\n"), count);
+		}
+	}
+	else if (!strncmp_flash(s, "expr", 4) && length == 4)
+	{
+		if (!expr_is_enabled()) {
+			term_puts_P("no expression set\n");
+		}
+		else {
+			printf_P(PSTR("%u bytes, about %u cycles, %u messages dropped\n"),
+					expr_get_size(), expr_get_cycles(), expr_get_dropped());
+		}
+	}
+	else if (!strncmp_flash(s, "trigger", 7) && length == 7)
+	{
+		static const char s_modes[3][7] PROGMEM = { "off", "pulse", "toggle" };
+		static const char s_outputs[3][5] PROGMEM = { "pin", "led1", "led2" };
+		
+		printf_P(PSTR("%S on %S, %u matches\n"), s_modes[trigger_out_get_mode()],
+				s_outputs[trigger_out_get_output()], trigger_out_get_hits());
+	}
+	#if SUPPORT_E2E
+	else if (!strncmp_flash(s, "e2e", 3) && length == 3)
+	{
+		for (uint8_t i = 0; i < e2e_get_count(); i++)
+		{
+			const e2e_entry_t *entry = e2e_get(i);
+			
+			printf_P(PSTR("%u: "), i);
+			put_key(entry->key);
+			if (entry->profile == E2E_PROFILE_1) {
+				printf_P(PSTR(" profile 1, id %04x"), entry->data_id);
+			}
+			else {
+				term_puts_P(" profile 2, ids");
+				for (uint8_t j = 0; j < 16; j++) {
+					term_putc(' ');
+					term_put_hex(entry->data_id_list[j]);
+				}
+			}
+			term_puts_P(", crc ");
+			
+			if (entry->crc_byte == E2E_NONE)
+				term_puts_P("off");
+			else
+				printf_P(PSTR("%u"), entry->crc_byte);
+			
+			term_puts_P(", counter ");
+			if (entry->counter_byte == E2E_NONE)
+				term_puts_P("off");
+			else
+				printf_P(PSTR("%u %S"), entry->counter_byte,
+						entry->counter_shift ? PSTR("high") : PSTR("low"));
+			
+			printf_P(PSTR("\n   ok %u, crc %u, repeated %u, lost %u, length %u\n"),
+					entry->ok, entry->crc_errors, entry->repeated, entry->lost,
+					entry->length_errors);
+		}
+	}
+	#endif
+	#if SUPPORT_AUTOREPLY
+	else if (!strncmp_flash(s, "reply", 5) && length == 5)
+	{
+		for (uint8_t i = 0; i < autoreply_get_count(); i++)
+		{
+			const autoreply_rule_t *rule = autoreply_get(i);
+			
+			printf_P(PSTR("%u: %S "), i, rule->remote ? PSTR("rtr ") : PSTR("data"));
+			put_key(rule->match.extended ? (rule->match.id | 0x80000000) : rule->match.id);
+			printf_P(PSTR("/%lx"), rule->match.mask);
+			
+			if (!rule->active) {
+				term_puts_P(", no reply\n");
+				continue;
+			}
+			
+			term_puts_P(" -> ");
+			put_key(id_table_key(&rule->reply));
+			for (uint8_t j = 0; j < rule->reply.length; j++) {
+				term_putc(' ');
+				term_put_hex(rule->reply.data[j]);
+			}
+			printf_P(PSTR(", %u ms, %u hits\n"), rule->delay, rule->hits);
+		}
+	}
+	#endif
+	#if SUPPORT_REQUEST
+	else if (!strncmp_flash(s, "request", 7) && length == 7)
+	{
+		for (uint8_t i = 0; i < request_get_count(); i++)
+		{
+			const request_t *request = request_get(i);
+			const request_stats_t *stats = request_get_stats(i);
+			
+			printf_P(PSTR("%u: "), i);
+			put_key(id_table_key(&request->msg));
+			term_puts_P(" -> ");
+			put_key(request->response_key);
+			printf_P(PSTR(" every %5u ms: %5u ok, %5u timeouts, last %lu us\n"),
+					request->interval, stats->responses, stats->timeouts,
+					stats->latency);
+		}
+		
+		printf_P(PSTR("%S\n"), request_is_running() ? PSTR("running") : PSTR("stopped"));
+	}
+	#endif
+	#if SUPPORT_J1939
+	else if (!strncmp_flash(s, "j1939", 5) && length == 5)
+	{
+		if (!j1939_is_enabled()) {
+			term_puts_P("off\n");
+		}
+		else {
+			if (j1939_get_address() == J1939_NO_ADDRESS)
+				term_puts_P("monitoring");
+			else
+				printf_P(PSTR("address %02x"), j1939_get_address());
+			
+			printf_P(PSTR(", %u transfers in progress\n"), j1939_get_active());
+		}
+	}
+	#endif
+	#if SUPPORT_ISOTP
+	else if (!strncmp_flash(s, "isotp", 5) && length == 5)
+	{
+		for (uint8_t i = 0; i < ISOTP_CHANNELS; i++)
+		{
+			const isotp_config_t *config = isotp_get_config(i);
+			
+			printf_P(PSTR("%u: "), i);
+			if (config == NULL) {
+				term_puts_P("closed\n");
+				continue;
+			}
+			
+			put_key(config->tx_key);
+			term_puts_P(" -> ");
+			put_key(config->rx_key);
+			
+			printf_P(PSTR(", bs %u, stmin %02x, padding %02x\n"), config->block_size,
+					config->st_min, config->padding);
+		}
+	}
+	#endif
+	#if SUPPORT_SIGNALS
+	else if (!strncmp_flash(s, "signals", 7) && length == 7)
+	{
+		for (uint8_t i = 0; i < signals_get_count(); i++)
+		{
+			const signal_t *signal = signals_get(i);
+			
+			if (signal->key & 0x80000000)
+				printf_P(PSTR("%u: %08lx"), i, signal->key & 0x1fffffff);
+			else
+				printf_P(PSTR("%u: %3lx"), i, signal->key);
+			
+			printf_P(PSTR(" %2u|%-2u %S %c *%d %+ld /10^%u"), signal->start,
+					signal->length,
+					(signal->flags & SIGNAL_BIG_ENDIAN) ? PSTR("be") : PSTR("le"),
+					(signal->flags & SIGNAL_SIGNED) ? 's' : 'u',
+					signal->factor, signal->offset, signal->decimals);
+			
+			if (signal->flags & SIGNAL_ON_CHANGE)
+				term_puts_P(" change");
+			if (signal->flags & SIGNAL_ON_THRESHOLD)
+				printf_P(PSTR(" limit %ld..%ld"), signal->low, signal->high);
+			
+			term_putc_cr('\n');
+		}
+		
+		if (signals_get_streaming())
+			term_puts_P("streaming events only\n");
+	}
+	#endif
+	else if (!strncmp_flash(s, "busload", 7) && length == 7)
+	{
+		printf_P(PSTR("current: %3u %%\n" \
+					  "average: %3u %%\n" \
+					  "peak   : %3u %%\n"), busload_get_current(),
+				busload_get_average(), busload_get_peak());
+	}
+	else if (!strncmp_flash(s, "watch", 5) && length == 5)
+	{
+		if (period_watch_get_state() == PERIOD_WATCH_OFF) {
+			term_puts_P("supervision not active\n");
+			return 1;
+		}
+		else if (period_watch_get_state() == PERIOD_WATCH_TRAINING) {
+			term_puts_P("training...\n");
+			return 1;
+		}
+		
+		for (uint8_t i = 0; i < PERIOD_WATCH_SIZE; i++)
+		{
+			uint32_t key;
+			uint16_t period, tolerance;
+			bool missing;
+			
+			if (!period_watch_get(i, &key, &period, &tolerance, &missing))
+				continue;
+			
+			if (key & 0x80000000)
+				printf_P(PSTR("%08lx "), key & 0x1fffffff);
+			else
+				printf_P(PSTR("%8lx "), key);
+			
+			printf_P(PSTR("%5u ms +- %u%S\n"), period, tolerance,
+					missing ? PSTR(" missing") : PSTR(""));
+		}
+	}
 	
 	return 1;
 }
@@ -584,6 +2743,185 @@ uint8_t set_values(char *param, char data)
 	else if (!strncmp_flash(s, "filter", 6) && length == 6) {
 		set_filter(s, 0);
 	}
+	else if (!strncmp_flash(s, "mobs", 4) && length == 4) {
+		set_mobs(s, 0);
+	}
+	else if (!strncmp_flash(s, "stage", 5) && length == 5) {
+		set_stage(s, 0);
+	}
+	else if (!strncmp_flash(s, "pool", 4) && length == 4) {
+		set_pool(s, 0);
+	}
+	else if (!strncmp_flash(s, "idfilter", 8) && length == 8) {
+		set_idfilter(s, 0);
+	}
+	else if (!strncmp_flash(s, "change", 6) && length == 6) {
+		set_change(s, 0);
+	}
+	else if (!strncmp_flash(s, "rate", 4) && length == 4) {
+		set_rate(s, 0);
+	}
+	else if (!strncmp_flash(s, "watch", 5) && length == 5) {
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		
+		uint32_t training;
+		if (!strncmp_flash(s, "off", 3) && length == 3)
+			period_watch_stop();
+		else if (!term_get_long(s, &training, 10) || training > 30000 ||
+				 !period_watch_start(training))
+			error("Invalid training time (1..30000 ms)");
+	}
+	else if (!strncmp_flash(s, "capture", 7) && length == 7) {
+		set_capture(s, 0);
+	}
+	#if SUPPORT_SIGNALS
+	else if (!strncmp_flash(s, "signal", 6) && length == 6) {
+		set_signal(s, 0);
+	}
+	#endif
+	#if SUPPORT_ISOTP
+	else if (!strncmp_flash(s, "isotp", 5) && length == 5) {
+		set_isotp(s, 0);
+	}
+	#endif
+	#if SUPPORT_REQUEST
+	else if (!strncmp_flash(s, "request", 7) && length == 7) {
+		set_request(s, 0);
+	}
+	#endif
+	#if SUPPORT_AUTOREPLY
+	else if (!strncmp_flash(s, "reply", 5) && length == 5) {
+		set_reply(s, 0);
+	}
+	#endif
+	#if SUPPORT_E2E
+	else if (!strncmp_flash(s, "e2e", 3) && length == 3) {
+		set_e2e(s, 0);
+	}
+	#endif
+	else if (!strncmp_flash(s, "trigger", 7) && length == 7) {
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		
+		trigger_out_output_t output;
+		
+		if (!strncmp_flash(s, "off", 3) && length == 3) {
+			trigger_out_set_mode(TRIGGER_OUT_OFF, trigger_out_get_output());
+			return 1;
+		}
+		else if (!strncmp_flash(s, "pin", 3) && length == 3) {
+			output = TRIGGER_OUT_PIN;
+		}
+		else if (!strncmp_flash(s, "led1", 4) && length == 4) {
+			output = TRIGGER_OUT_LED1;
+		}
+		else if (!strncmp_flash(s, "led2", 4) && length == 4) {
+			output = TRIGGER_OUT_LED2;
+		}
+		else {
+			capture_trigger_t trigger;
+			
+			if (parse_trigger(s, &trigger))
+				trigger_out_set(&trigger);
+			else
+				error("Wrong format");
+			return 1;
+		}
+		
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		
+		trigger_out_mode_t mode;
+		if (!strncmp_flash(s, "pulse", 5) && length == 5)
+			mode = TRIGGER_OUT_PULSE;
+		else if (!strncmp_flash(s, "toggle", 6) && length == 6)
+			mode = TRIGGER_OUT_TOGGLE;
+		else {
+			error("Unknown option. Should be \"pulse\" or \"toggle\"");
+			return 1;
+		}
+		
+		if (!trigger_out_set_mode(mode, output))
+			error("Output not available");
+	}
+	#if SUPPORT_J1939
+	else if (!strncmp_flash(s, "j1939", 5) && length == 5) {
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		
+		if (!strncmp_flash(s, "off", 3) && length == 3) {
+			j1939_disable();
+		}
+		else if (!strncmp_flash(s, "on", 2) && length == 2) {
+			uint32_t address = J1939_NO_ADDRESS;
+			
+			s = get_next_parameter(s);
+			if (get_parameter_length(s) &&
+				(!term_get_long(s, &address, 16) || address > 0xfe)) {
+				error("Invalid address (0..fe)");
+				return 1;
+			}
+			j1939_enable(address);
+		}
+		else {
+			error("Unknown option. Should be \"on\" or \"off\"");
+		}
+	}
+	#endif
+	else if (!strncmp_flash(s, "expr", 4) && length == 4) {
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		
+		if (!strncmp_flash(s, "off", 3) && length == 3) {
+			expr_disable();
+		}
+		else if (!strncmp_flash(s, "save", 4) && length == 4) {
+			expr_save();
+		}
+		else {
+			int8_t pos = expr_compile(s);
+			if (pos >= 0) {
+				printf_P(PSTR("error at character %u: "), pos + 1);
+				error("Invalid expression or too slow");
+			}
+			else {
+				printf_P(PSTR("%u bytes, about %u cycles\n"),
+						expr_get_size(), expr_get_cycles());
+			}
+		}
+	}
+	else if (!strncmp_flash(s, "busload", 7) && length == 7) {
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		
+		if (!strncmp_flash(s, "reset", 5) && length == 5) {
+			busload_reset_peak();
+		}
+		else if (!strncmp_flash(s, "leds", 4) && length == 4) {
+			s = get_next_parameter(s);
+			length = get_parameter_length(s);
+			
+			if (!strncmp_flash(s, "on", 2) && length == 2)
+				busload_set_gauge(true);
+			else if (!strncmp_flash(s, "off", 3) && length == 3)
+				busload_set_gauge(false);
+			else
+				error("Unknown option. Should be \"on\" or \"off\"");
+		}
+		else {
+			error("Unknown option");
+		}
+	}
+	else if (!strncmp_flash(s, "stats", 5) && length == 5) {
+		s = get_next_parameter(s);
+		length = get_parameter_length(s);
+		
+		if (!strncmp_flash(s, "clear", 5) && length == 5)
+			id_stats_clear();
+		else
+			error("Unknown option. Should be \"clear\"");
+	}
 	#if  HARDWARE_VERSION_MINOR >= 2
 	else if (!strncmp_flash(s, "term", 4) && length == 4) {
 		s = get_next_parameter(s);
@@ -660,7 +2998,6 @@ uint8_t print_version(char *param, char data)
 	term_put_int(HARDWARE_VERSION_MINOR);
 	term_putc_cr('\n');
 	
-	#if CAN_RX_BUFFER_SIZE > 0 || CAN_TX_BUFFER_SIZE > 0
 	term_puts_P("\nbuild with:\n");
 	#if CAN_RX_BUFFER_SIZE > 0
 		term_puts_P("- ");
@@ -675,11 +3012,114 @@ uint8_t print_version(char *param, char data)
 			term_puts_P("- force tx order support\n");
 		#endif
 	#endif
+	
+	term_puts_P("- ");
+	term_put_int(TX_QUEUE_COUNT);
+	term_puts_P(" tx queues\n");
+	term_puts_P("- pool with ");
+	term_put_int(POOL_SIZE);
+	term_puts_P(" messages\n");
+	
+	term_puts_P("\nstatus:\n");
+	printf_P(PSTR("- pool: %u of %u messages free\n"), pool_get_free(), POOL_SIZE);
+	printf_P(PSTR("- rx: %u used, %u peak, %u reserved, %u dropped\n"),
+			pool_get_used(POOL_RX), pool_get_peak(POOL_RX),
+			pool_get_reserve(POOL_RX), pool_get_failed(POOL_RX));
+	printf_P(PSTR("- tx: %u used, %u peak, %u reserved, %u failed\n"),
+			pool_get_used(POOL_TX), pool_get_peak(POOL_TX),
+			pool_get_reserve(POOL_TX), pool_get_failed(POOL_TX));
+	for (uint8_t i = 0; i < TX_QUEUE_COUNT; i++) {
+		printf_P(PSTR("- tx queue %u: %u messages waiting\n"), i, tx_queue_get_depth(i));
+	}
+	printf_P(PSTR("- %u messages discarded after their deadline\n"), tx_queue_get_expired());
+	printf_P(PSTR("- %u one-shot messages aborted\n"), tx_queue_get_aborted());
+	
+	printf_P(PSTR("- %u events lost\n"), event_get_lost());
+	
+	if (change_filter_is_enabled()) {
+		printf_P(PSTR("- change-only: %u messages suppressed, %u evictions\n"),
+				change_filter_get_suppressed(), change_filter_get_evictions());
+	}
+	
+	#if SUPPORT_TIMESTAMPS
+	term_puts_P("- ");
+	printf_P(PSTR("%u"), rx_queue_get_reordered());
+	term_puts_P(" messages reordered by timestamp\n");
+	#endif
+	
+	return 1;
+}
+
+// ----------------------------------------------------------------------------
+// Misst die Laufzeit des Filterausdrucks mit verschiedenen Nachrichten
+
+#define	BENCH_FRAMES	1000
+
+uint8_t run_benchmark(char *param, char data)
+{
+	if (!expr_is_enabled()) {
+		error("No expression set (see \"set expr\")");
+		return 1;
+	}
+	
+	can_t msg;
+	msg.flags.rtr = 0;
+	#if SUPPORT_EXTENDED_CANID
+	msg.flags.extended = 0;
 	#endif
+	msg.length = 8;
+	for (uint8_t i = 0; i < 8; i++)
+		msg.data[i] = i * 0x11;
+	
+	uint16_t matches = 0;
+	uint32_t start = systime_ticks();
+	
+	for (uint16_t i = 0; i < BENCH_FRAMES; i++)
+	{
+		msg.id = i & 0x7ff;
+		msg.data[0] = i;
+		
+		if (expr_match(&msg))
+			matches++;
+	}
+	
+	uint32_t ticks = systime_ticks() - start;
+	
+	// 4 us per tick = 64 cycles
+	uint16_t cycles = ticks * 64 / BENCH_FRAMES;
+	uint32_t time = ticks * 4000 / BENCH_FRAMES;		// ns
+	
+	printf_P(PSTR("%u frames (%u matches): %u cycles per frame, estimated %u\n"),
+			BENCH_FRAMES, matches, cycles, expr_get_cycles());
+	
+	// shortest frame at 500 kbps: 47 bits = 94 us
+	printf_P(PSTR("%lu.%lu us per frame = %lu %% of the shortest frame at 500 kbps\n"),
+			time / 1000, (time % 1000) / 100, time / 940);
 	
 	return 1;
 }
 
+// ----------------------------------------------------------------------------
+// Wartet bis in der Queue wieder Platz ist. Ohne Bus oder im Bus-Off
+// wird nichts mehr gesendet, daher nach SEND_BLOCKING_TIMEOUT ms abbrechen.
+
+#define	SEND_BLOCKING_TIMEOUT	100
+
+static bool send_blocking(const can_t *msg)
+{
+	uint16_t deadline = systime_ms() + SEND_BLOCKING_TIMEOUT;
+	
+	while (!tx_queue_send(msg, NULL))
+	{
+		if (systime_elapsed(deadline))
+			return false;
+		tx_queue_pump();
+	}
+	
+	tx_queue_pump();
+	return true;
+}
+
 // ----------------------------------------------------------------------------
 uint8_t send_bulk_messages(char *param, char data)
 {
@@ -691,34 +3131,46 @@ uint8_t send_bulk_messages(char *param, char data)
 	msg.length = 8;
 	
 	msg.id = 0x200;
-	can_send_message( &msg );
+	if (!send_blocking(&msg))
+		goto error;
 	_delay_ms(2);
 	
 	msg.id = 0x1ff;
-	can_send_message( &msg );
+	if (!send_blocking(&msg))
+		goto error;
 	msg.id = 0x1fe;
-	can_send_message( &msg );
+	if (!send_blocking(&msg))
+		goto error;
 	msg.id = 0x1fd;
-	can_send_message( &msg );
+	if (!send_blocking(&msg))
+		goto error;
 	_delay_ms(1);
 	
 	msg.id = 0x1fc;
-	can_send_message( &msg );
+	if (!send_blocking(&msg))
+		goto error;
 	_delay_ms(1);
 	msg.id = 0x1fb;
-	can_send_message( &msg );
+	if (!send_blocking(&msg))
+		goto error;
 	_delay_ms(20);
 	
 	msg.id = 0x1fa;
-	can_send_message( &msg );
+	if (!send_blocking(&msg))
+		goto error;
 	_delay_ms(10);
 	
 	uint8_t i;
 	for (i = 0; i < 20; i++)
 	{
 		msg.id = 0x100 - i;
-		can_send_message( &msg );
+		if (!send_blocking(&msg))
+			goto error;
 	}
 	
 	return 1;
+	
+error:
+	error("Bus not available, aborted");
+	return 1;
 }
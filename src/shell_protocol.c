@@ -31,6 +31,128 @@
 #include "termio.h"
 #include "shell.h"
 #include "shell_programs.h"
+#include "rx_queue.h"
+#include "event_queue.h"
+#include "period_watch.h"
+#include "signals.h"
+#include "isotp.h"
+#include "j1939.h"
+#include "request.h"
+#include "e2e.h"
+
+// ----------------------------------------------------------------------------
+static void shell_put_event(const event_t *event)
+{
+	#if SUPPORT_SIGNALS
+	if (event->type == SIGNAL_EVENT)
+	{
+		uint8_t n = event->key;
+		
+		printf_P(PSTR("!: signal %u = "), n);
+		signals_print_value(n, event->value);
+		
+		switch (event->code) {
+			case 'h':
+				term_puts_P(" above limit");
+				break;
+			case 'l':
+				term_puts_P(" below limit");
+				break;
+			case 'n':
+				term_puts_P(" normal");
+				break;
+		}
+		
+		term_putc_cr('\n');
+		return;
+	}
+	#endif
+	
+	if (event->type == REQUEST_EVENT)
+	{
+		printf_P(PSTR("!: request %u no response within %ld ms"),
+				(uint8_t) event->key, event->value);
+		term_putc_cr('\n');
+		return;
+	}
+	
+	if (event->type == ISOTP_EVENT)
+	{
+		printf_P(PSTR("!: isotp %u "), (uint8_t) event->key);
+		
+		switch (event->code) {
+			case 's':
+				printf_P(PSTR("sent %ld bytes"), event->value);
+				break;
+			case 'b':
+				term_puts_P("no flow control");
+				break;
+			case 'c':
+				printf_P(PSTR("timeout after %ld bytes"), event->value);
+				break;
+			case 'q':
+				term_puts_P("wrong sequence number");
+				break;
+			case 'o':
+				printf_P(PSTR("overflow, %ld bytes"), event->value);
+				break;
+			case 'a':
+				term_puts_P("aborted by receiver");
+				break;
+		}
+		
+		term_putc_cr('\n');
+		return;
+	}
+	
+	if (event->key & 0x80000000)
+		printf_P(PSTR("!: %08lx "), event->key & 0x1fffffff);
+	else
+		printf_P(PSTR("!: %8lx "), event->key);
+	
+	if (event->type == PERIOD_WATCH_EVENT)
+	{
+		switch (event->code) {
+			case 'm':
+				printf_P(PSTR("missing for %ld ms"), event->value);
+				break;
+			case 'e':
+				printf_P(PSTR("too early, after %ld ms"), event->value);
+				break;
+			case 'r':
+				printf_P(PSTR("reappeared after %ld ms"), event->value);
+				break;
+		}
+	}
+	else if (event->type == E2E_EVENT)
+	{
+		term_puts_P("e2e ");
+		
+		switch (event->code) {
+			case 'c':
+				printf_P(PSTR("crc %02x, expected %02x"),
+						(uint8_t) (event->value >> 8), (uint8_t) event->value);
+				break;
+			case 'r':
+				printf_P(PSTR("counter %ld repeated"), event->value);
+				break;
+			case 'l':
+				printf_P(PSTR("%ld messages lost"), event->value);
+				break;
+			case 'i':
+				printf_P(PSTR("invalid counter %ld"), event->value);
+				break;
+			case 'd':
+				printf_P(PSTR("only %ld bytes"), event->value);
+				break;
+		}
+	}
+	else {
+		printf_P(PSTR("event %c%c %08lx"), event->type, event->code, event->value);
+	}
+	
+	term_putc_cr('\n');
+}
 
 // ----------------------------------------------------------------------------
 void shell_handle_protocol(void)
@@ -38,55 +160,123 @@ void shell_handle_protocol(void)
 	// Shell ausfuehren
 	command_shell();
 	
-	// eventl. vorhandene Nachrichten abrufen/ausgeben
-	if (can_check_message())
+	// Alarme vor den Nachrichten ausgeben
+	const event_t *event = event_peek();
+	if (event != NULL && term_tx_ready()) {
+		shell_put_event(event);
+		event_commit();
+	}
+	
+	#if SUPPORT_ISOTP
+	// empfangene ISO-TP Botschaften
+	uint8_t channel;
+	uint16_t pdu_length;
+	const uint8_t *pdu = isotp_peek(&channel, &pdu_length);
+	if (pdu != NULL && term_tx_ready())
+	{
+		printf_P(PSTR("!: isotp %u %u >"), channel, pdu_length);
+		for (uint16_t i = 0; i < pdu_length; i++) {
+			term_putc(' ');
+			term_put_hex(pdu[i]);
+		}
+		term_putc_cr('\n');
+		
+		isotp_commit(channel);
+	}
+	#endif
+	
+	#if SUPPORT_REQUEST
+	// Antworten der Request Engine
+	const request_result_t *result = request_peek();
+	if (result != NULL && term_tx_ready())
+	{
+		const can_t *message = &result->msg;
+		
+		printf_P(PSTR("!: request %u %lu us: "), result->entry, result->latency);
+		if (message->flags.extended)
+			printf_P(PSTR("%08lx %u >"), message->id, message->length);
+		else
+			printf_P(PSTR("%3lx %u >"), message->id, message->length);
+		
+		for (uint8_t i = 0; i < message->length; i++) {
+			term_putc(' ');
+			term_put_hex(message->data[i]);
+		}
+		term_putc_cr('\n');
+		
+		request_commit();
+	}
+	#endif
+	
+	#if SUPPORT_J1939
+	// zusammengesetzte J1939 Botschaften
+	j1939_message_t j1939;
+	uint8_t session = j1939_peek(&j1939);
+	if (session != 0xff && term_tx_ready())
+	{
+		printf_P(PSTR("!: j1939 %05lx %02x -> %02x %u >"), j1939.pgn,
+				j1939.source, j1939.destination, j1939.length);
+		for (uint16_t i = 0; i < j1939.length; i++) {
+			term_putc(' ');
+			term_put_hex(j1939.data[i]);
+		}
+		term_putc_cr('\n');
+		
+		j1939_commit(session);
+	}
+	#endif
+	
+	// eventl. vorhandene Nachrichten direkt aus der Queue ausgeben
+	const rx_entry_t *entry = rx_queue_peek();
+	if (entry != NULL && term_tx_ready())
 	{
-		can_t message;
+		const can_t *message = &entry->msg;
+		uint8_t length = message->length;
+		
+		#if CAN_RX_BUFFER_SIZE == 0
+		
+		uint8_t mob = entry->filter;
+		if (message->flags.extended) {
+			printf_P(PSTR("%x: %08lx %u"), mob - 1, message->id, length);
+		}
+		else {
+			uint16_t id = message->id;
+			printf_P(PSTR("%x: %8x %u"), mob - 1, id, length);
+		}
+		
+		#else
 		
-		// Nachricht abrufen
-		uint8_t mob = can_get_message(&message);
-		if (mob)
+		if (message->flags.extended) {
+			printf_P(PSTR("%6u: %08lx %u"), message->timestamp, message->id, length);
+		}
+		else {
+			uint16_t id = message->id;
+			printf_P(PSTR("%6u: %8x %u"), message->timestamp, id, length);
+		}
+		
+		#endif
+		
+		if (!message->flags.rtr)
 		{
-			uint8_t length = message.length;
-			
-			#if CAN_RX_BUFFER_SIZE == 0
-			
-			if (message.flags.extended) {
-				printf_P(PSTR("%x: %08lx %u"), mob - 1, message.id, length);
-			}
-			else {
-				uint16_t id = message.id;
-				printf_P(PSTR("%x: %8x %u"), mob - 1, id, length);
-			}
-			
-			#else
+			if (length)
+				term_puts_P(" >");
 			
-			if (message.flags.extended) {
-				printf_P(PSTR("%6u: %08lx %u"), message.timestamp, message.id, length);
-			}
-			else {
-				uint16_t id = message.id;
-				printf_P(PSTR("%6u: %8x %u"), message.timestamp, id, length);
-			}
-			
-			#endif
-			
-			if (!message.flags.rtr)
-			{
-				if (length)
-					term_puts_P(" >");
-				
-				for (uint8_t i=0;i<length;i++) {
-					term_putc(' ');
-					term_put_hex(message.data[i]);
-				}
-			}
-			else
-			{
-				term_puts_P(" rtr");
+			for (uint8_t i=0;i<length;i++) {
+				term_putc(' ');
+				term_put_hex(message->data[i]);
 			}
 			
-			term_putc_cr('\n');
+			// dekodierte Signale anhaengen
+			signals_print(message);
 		}
+		else
+		{
+			term_puts_P(" rtr");
+		}
+		
+		term_putc_cr('\n');
+		
+		// Eintrag erst nach der vollstaendigen Ausgabe freigeben
+		rx_queue_commit();
 	}
 }
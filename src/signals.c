@@ -0,0 +1,310 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include <avr/eeprom.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "signals.h"
+#include "id_table.h"
+#include "event_queue.h"
+#include "termio.h"
+
+#if SUPPORT_SIGNALS
+
+typedef struct {
+	uint8_t byte;			// first byte in the message
+	uint8_t count;			// number of bytes (1..4)
+	uint8_t shift;
+	uint32_t mask;
+} signal_plan_t;
+
+typedef struct {
+	int32_t value;
+	uint8_t zone;			// 0 = below low, 1 = normal, 2 = above high
+	bool valid;
+} signal_state_t;
+
+static signal_t signal_table[SIGNAL_COUNT];
+static signal_plan_t signal_plan[SIGNAL_COUNT];
+static signal_state_t signal_state[SIGNAL_COUNT];
+static uint8_t signal_count;
+
+static bool signal_streaming;
+
+static uint8_t ee_signal_count EEMEM = 0xff;
+static signal_t ee_signal_table[SIGNAL_COUNT] EEMEM;
+
+// ----------------------------------------------------------------------------
+// Berechnet Position und Maske eines Signals. Little Endian: Startbit ist
+// das LSB, die Bytes werden rueckwaerts gelesen. Big Endian: Startbit ist
+// das MSB (Nummerierung wie in DBC Dateien), die Bytes werden vorwaerts
+// gelesen.
+
+static bool signals_make_plan(const signal_t *signal, signal_plan_t *plan)
+{
+	uint8_t length = signal->length;
+	uint8_t bit = signal->start & 7;
+	
+	if (length == 0 || length > 32 || signal->start > 63)
+		return false;
+	
+	plan->byte = signal->start / 8;
+	
+	if (signal->flags & SIGNAL_BIG_ENDIAN) {
+		// bits of the first byte: bit .. 0
+		uint8_t rest = (length > bit + 1) ? length - (bit + 1) : 0;
+		
+		plan->count = 1 + (rest + 7) / 8;
+		plan->shift = (plan->count - 1) * 8 + bit + 1 - length;
+	}
+	else {
+		plan->count = (bit + length + 7) / 8;
+		plan->shift = bit;
+	}
+	
+	if (plan->count > 4 || plan->byte + plan->count > 8)
+		return false;
+	
+	plan->mask = (length == 32) ? 0xffffffff : ((1UL << length) - 1);
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+int8_t signals_add(const signal_t *signal)
+{
+	if (signal_count >= SIGNAL_COUNT || signal->decimals > 6)
+		return -1;
+	
+	if (!signals_make_plan(signal, &signal_plan[signal_count]))
+		return -1;
+	
+	signal_table[signal_count] = *signal;
+	signal_state[signal_count].valid = false;
+	
+	return signal_count++;
+}
+
+// ----------------------------------------------------------------------------
+bool signals_remove(uint8_t n)
+{
+	if (n >= signal_count)
+		return false;
+	
+	signal_count--;
+	memmove(&signal_table[n], &signal_table[n + 1], (signal_count - n) * sizeof(signal_t));
+	memmove(&signal_plan[n], &signal_plan[n + 1], (signal_count - n) * sizeof(signal_plan_t));
+	memmove(&signal_state[n], &signal_state[n + 1], (signal_count - n) * sizeof(signal_state_t));
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+void signals_clear(void)
+{
+	signal_count = 0;
+}
+
+// ----------------------------------------------------------------------------
+bool signals_set_thresholds(uint8_t n, int32_t low, int32_t high)
+{
+	if (n >= signal_count || low > high)
+		return false;
+	
+	signal_table[n].low = low;
+	signal_table[n].high = high;
+	signal_state[n].valid = false;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+bool signals_set_events(uint8_t n, uint8_t events)
+{
+	if (n >= signal_count)
+		return false;
+	
+	signal_table[n].flags &= ~(SIGNAL_ON_CHANGE | SIGNAL_ON_THRESHOLD);
+	signal_table[n].flags |= events & (SIGNAL_ON_CHANGE | SIGNAL_ON_THRESHOLD);
+	signal_state[n].valid = false;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t signals_get_count(void)
+{
+	return signal_count;
+}
+
+// ----------------------------------------------------------------------------
+const signal_t * signals_get(uint8_t n)
+{
+	return &signal_table[n];
+}
+
+// ----------------------------------------------------------------------------
+int32_t signals_decode(uint8_t n, const can_t *msg)
+{
+	const signal_t *signal = &signal_table[n];
+	const signal_plan_t *plan = &signal_plan[n];
+	const uint8_t *data = &msg->data[plan->byte];
+	uint32_t raw = 0;
+	
+	if (signal->flags & SIGNAL_BIG_ENDIAN) {
+		for (uint8_t i = 0; i < plan->count; i++)
+			raw = (raw << 8) | data[i];
+	}
+	else {
+		for (uint8_t i = plan->count; i > 0; i--)
+			raw = (raw << 8) | data[i - 1];
+	}
+	
+	raw = (raw >> plan->shift) & plan->mask;
+	
+	// sign extension
+	if ((signal->flags & SIGNAL_SIGNED) && (raw & ~(plan->mask >> 1)))
+		raw |= ~plan->mask;
+	
+	return (int32_t) raw * signal->factor + signal->offset;
+}
+
+// ----------------------------------------------------------------------------
+void signals_print_value(uint8_t n, int32_t value)
+{
+	uint8_t decimals = signal_table[n].decimals;
+	
+	if (decimals == 0) {
+		printf_P(PSTR("%ld"), value);
+		return;
+	}
+	
+	uint32_t divisor = 1;
+	for (uint8_t i = 0; i < decimals; i++)
+		divisor *= 10;
+	
+	if (value < 0) {
+		term_putc('-');
+		value = -value;
+	}
+	
+	printf_P(PSTR("%lu.%0*lu"), (uint32_t) value / divisor, decimals,
+			(uint32_t) value % divisor);
+}
+
+// ----------------------------------------------------------------------------
+// Prueft ob die Nachricht lang genug fuer das Signal ist
+
+static bool signals_match(uint8_t n, const can_t *msg, uint32_t key)
+{
+	return (signal_table[n].key == key && !msg->flags.rtr &&
+			signal_plan[n].byte + signal_plan[n].count <= msg->length);
+}
+
+// ----------------------------------------------------------------------------
+void signals_print(const can_t *msg)
+{
+	uint32_t key = id_table_key(msg);
+	
+	for (uint8_t i = 0; i < signal_count; i++)
+	{
+		if (!signals_match(i, msg, key))
+			continue;
+		
+		printf_P(PSTR(" %u="), i);
+		signals_print_value(i, signals_decode(i, msg));
+	}
+}
+
+// ----------------------------------------------------------------------------
+void signals_set_streaming(bool enable)
+{
+	signal_streaming = enable;
+}
+
+// ----------------------------------------------------------------------------
+bool signals_get_streaming(void)
+{
+	return signal_streaming;
+}
+
+// ----------------------------------------------------------------------------
+bool signals_check(const can_t *msg)
+{
+	uint32_t key = id_table_key(msg);
+	
+	for (uint8_t i = 0; i < signal_count; i++)
+	{
+		const signal_t *signal = &signal_table[i];
+		signal_state_t *state = &signal_state[i];
+		
+		if (!(signal->flags & (SIGNAL_ON_CHANGE | SIGNAL_ON_THRESHOLD)) ||
+			!signals_match(i, msg, key))
+			continue;
+		
+		int32_t value = signals_decode(i, msg);
+		uint8_t zone = (value < signal->low) ? 0 : ((value > signal->high) ? 2 : 1);
+		
+		if (state->valid)
+		{
+			if ((signal->flags & SIGNAL_ON_THRESHOLD) && zone != state->zone) {
+				event_push(SIGNAL_EVENT, (zone == 0) ? 'l' : ((zone == 2) ? 'h' : 'n'),
+						i, value);
+			}
+			else if ((signal->flags & SIGNAL_ON_CHANGE) && value != state->value) {
+				event_push(SIGNAL_EVENT, 'c', i, value);
+			}
+		}
+		
+		state->value = value;
+		state->zone = zone;
+		state->valid = true;
+	}
+	
+	return !signal_streaming;
+}
+
+// ----------------------------------------------------------------------------
+void signals_save(void)
+{
+	eeprom_update_block(signal_table, ee_signal_table, signal_count * sizeof(signal_t));
+	eeprom_update_byte(&ee_signal_count, signal_count);
+}
+
+// ----------------------------------------------------------------------------
+void signals_load(void)
+{
+	uint8_t count = eeprom_read_byte(&ee_signal_count);
+	
+	signal_count = 0;
+	if (count > SIGNAL_COUNT)
+		return;
+	
+	for (uint8_t i = 0; i < count; i++)
+	{
+		signal_t signal;
+		
+		eeprom_read_block(&signal, &ee_signal_table[i], sizeof(signal_t));
+		signals_add(&signal);
+	}
+}
+
+#endif	// SUPPORT_SIGNALS
@@ -0,0 +1,144 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	SIGNALS_H
+#define	SIGNALS_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Decoding of signals from received messages
+ *
+ * Up to SIGNAL_COUNT signals can be defined. Each signal is given by the
+ * identifier of its message, start bit, length (1..32), byte order and
+ * sign like in a DBC file. The physical value is calculated in fixed
+ * point as
+ *
+ *   (raw * factor + offset) / 10^decimals
+ *
+ * When a signal is defined the position in the message is converted to a
+ * plan (first byte, number of bytes, shift and mask), so decoding only
+ * needs a few byte loads and one shift.
+ *
+ * Signals can generate events of type 'v' (see event_queue.h) with the
+ * number of the signal as key and the scaled value (before the division)
+ * as value: 'c' the value has changed, 'h' it rose above the upper
+ * threshold, 'l' it fell below the lower one and 'n' it is back between
+ * both thresholds.
+ *
+ * The definitions can be stored in the EEPROM.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "config.h"
+
+#define	SIGNAL_EVENT			'v'
+
+// flags
+#define	SIGNAL_BIG_ENDIAN		0x01	//!< Motorola byte order
+#define	SIGNAL_SIGNED			0x02
+#define	SIGNAL_ON_CHANGE		0x04	//!< event on every change
+#define	SIGNAL_ON_THRESHOLD		0x08	//!< event when crossing a threshold
+
+// ----------------------------------------------------------------------------
+typedef struct {
+	uint32_t key;			//!< identifier, see id_table_key()
+	uint8_t start;			//!< start bit (LSB, or MSB for big endian)
+	uint8_t length;
+	uint8_t flags;
+	uint8_t decimals;
+	int16_t factor;
+	int32_t offset;
+	int32_t low;			//!< thresholds in scaled units
+	int32_t high;
+} signal_t;
+
+// ----------------------------------------------------------------------------
+// Returns the number of the new signal or -1 if the definition is invalid
+// (the signal must not span more than 4 bytes) or the table is full.
+
+extern int8_t signals_add(const signal_t *signal);
+
+// ----------------------------------------------------------------------------
+extern bool signals_remove(uint8_t n);
+
+// ----------------------------------------------------------------------------
+extern void signals_clear(void);
+
+// ----------------------------------------------------------------------------
+extern bool signals_set_thresholds(uint8_t n, int32_t low, int32_t high);
+
+// ----------------------------------------------------------------------------
+// Selects the events (SIGNAL_ON_CHANGE, SIGNAL_ON_THRESHOLD) of signal n
+
+extern bool signals_set_events(uint8_t n, uint8_t events);
+
+// ----------------------------------------------------------------------------
+extern uint8_t signals_get_count(void);
+
+// ----------------------------------------------------------------------------
+extern const signal_t * signals_get(uint8_t n);
+
+// ----------------------------------------------------------------------------
+// Returns the scaled value of signal n in the message. The message must
+// have the identifier of the signal.
+
+extern int32_t signals_decode(uint8_t n, const can_t *msg);
+
+// ----------------------------------------------------------------------------
+// Prints a scaled value with the decimals of signal n
+
+extern void signals_print_value(uint8_t n, int32_t value);
+
+// ----------------------------------------------------------------------------
+// Prints all signals of the message as " n=value"
+
+extern void signals_print(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+// Only forward the events and no messages
+
+extern void signals_set_streaming(bool enable);
+
+// ----------------------------------------------------------------------------
+extern bool signals_get_streaming(void);
+
+// ----------------------------------------------------------------------------
+// Decodes the signals of the message and generates the events. Returns
+// false in streaming mode.
+
+extern bool signals_check(const can_t *msg);
+
+// ----------------------------------------------------------------------------
+extern void signals_save(void);
+
+// ----------------------------------------------------------------------------
+extern void signals_load(void);
+
+// ----------------------------------------------------------------------------
+#if !SUPPORT_SIGNALS
+	#define	signals_check(msg)		true
+	#define	signals_load()
+	#define	signals_print(msg)
+#endif
+
+#endif	// SIGNALS_H
@@ -0,0 +1,109 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	SYSTIME_H
+#define	SYSTIME_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	System time derived from the 10 ms interrupt of Timer 1
+ *
+ * Timer 1 counts with f_clk / 64 = 250 kHz (4 us per tick) from 0 to
+ * OCR1A = 2500. Together with the number of compare interrupts this gives
+ * the time since reset with a resolution of 4 us.
+ *
+ * \warning	With hardware version 1.1 Timer 1 is used as PWM for the LEDs,
+ *			the time has only a resolution of about 10 ms there.
+ */
+
+#include <avr/io.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "config.h"
+#include "utils.h"
+
+// ----------------------------------------------------------------------------
+// incremented every 10 ms by the timer interrupt in main.c. 32 bit wide so
+// that systime_ticks() wraps modulo 2^32 and not after 655 s.
+
+extern volatile uint32_t systime_10ms;
+
+// ----------------------------------------------------------------------------
+// Returns the milliseconds since reset. The value overflows after 65 s,
+// use systime_elapsed() to compare times.
+
+static inline uint16_t systime_ms(void)
+{
+	uint16_t ticks;
+	uint16_t count = 0;
+	
+	ENTER_CRITICAL_SECTION
+	ticks = systime_10ms;
+	
+	#if  HARDWARE_VERSION_MINOR >= 2
+	count = TCNT1;
+	
+	// compare match already happened but the interrupt is not yet served
+	if (TIFR1 & (1 << OCF1A)) {
+		ticks++;
+		count = TCNT1;
+	}
+	#endif
+	LEAVE_CRITICAL_SECTION
+	
+	return ticks * 10 + count / 250;
+}
+
+// ----------------------------------------------------------------------------
+// Returns the time since reset in ticks of 4 us. Also works with
+// interrupts disabled as long as less than 10 ms have passed since the
+// last timer interrupt.
+
+static inline uint32_t systime_ticks(void)
+{
+	uint32_t ticks;
+	uint16_t count = 0;
+	
+	ENTER_CRITICAL_SECTION
+	ticks = systime_10ms;
+	
+	#if  HARDWARE_VERSION_MINOR >= 2
+	count = TCNT1;
+	
+	if (TIFR1 & (1 << OCF1A)) {
+		ticks++;
+		count = TCNT1;
+	}
+	#endif
+	LEAVE_CRITICAL_SECTION
+	
+	return ticks * 2500 + count;
+}
+
+// ----------------------------------------------------------------------------
+// Checks if the given point in time is reached
+
+static inline bool systime_elapsed(uint16_t time)
+{
+	return (int16_t) (systime_ms() - time) >= 0;
+}
+
+#endif	// SYSTIME_H
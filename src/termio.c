@@ -47,6 +47,11 @@ uint8_t term_getc()
 	return t;
 }
 
+// ------------------------------------------------------------------------
+uint8_t term_tx_ready(void) {
+	return (!IS_SET(USB_TXE));
+}
+
 // ------------------------------------------------------------------------
 void term_putc(const char c)
 {
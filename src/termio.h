@@ -32,6 +32,9 @@
 extern uint8_t term_data_available(void);
 extern uint8_t term_getc(void);
 
+// -----------------------------------------------------------------------------
+extern uint8_t term_tx_ready(void);
+
 // -----------------------------------------------------------------------------
 extern void term_putc_cr(char c);
 extern void term_putc(const char c);
@@ -0,0 +1,190 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include <avr/io.h>
+#include <util/delay.h>
+
+#include "trigger_out.h"
+#include "utils.h"
+
+static capture_trigger_t trigger;
+static volatile uint8_t trigger_mode;
+static uint8_t trigger_output;
+static volatile uint16_t trigger_hits;
+
+// ----------------------------------------------------------------------------
+void trigger_out_set(const capture_trigger_t *t)
+{
+	ENTER_CRITICAL_SECTION
+	trigger = *t;
+	LEAVE_CRITICAL_SECTION
+}
+
+// ----------------------------------------------------------------------------
+// Ausgang in den Ruhezustand versetzen
+
+static void trigger_out_idle(uint8_t output)
+{
+	switch (output) {
+		case TRIGGER_OUT_PIN:
+			RESET(TRIGGER_PIN);
+			SET_OUTPUT(TRIGGER_PIN);
+			break;
+		
+		#if  HARDWARE_VERSION_MINOR >= 2
+		case TRIGGER_OUT_LED1:
+			RESET(LED_DUO1_1);
+			RESET(LED_DUO1_2);
+			break;
+		
+		case TRIGGER_OUT_LED2:
+			RESET(LED_DUO2_1);
+			RESET(LED_DUO2_2);
+			break;
+		#endif
+	}
+}
+
+// ----------------------------------------------------------------------------
+bool trigger_out_set_mode(trigger_out_mode_t mode, trigger_out_output_t output)
+{
+	#if  HARDWARE_VERSION_MINOR >= 2
+	if (output > TRIGGER_OUT_LED2)
+		return false;
+	#else
+	if (output != TRIGGER_OUT_PIN)
+		return false;
+	#endif
+	
+	if (mode > TRIGGER_OUT_TOGGLE)
+		return false;
+	
+	ENTER_CRITICAL_SECTION
+	trigger_mode = mode;
+	trigger_output = output;
+	trigger_hits = 0;
+	
+	trigger_out_idle(output);
+	LEAVE_CRITICAL_SECTION
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+trigger_out_mode_t trigger_out_get_mode(void)
+{
+	return trigger_mode;
+}
+
+// ----------------------------------------------------------------------------
+trigger_out_output_t trigger_out_get_output(void)
+{
+	return trigger_output;
+}
+
+// ----------------------------------------------------------------------------
+uint16_t trigger_out_get_hits(void)
+{
+	uint16_t hits;
+	
+	ENTER_CRITICAL_SECTION
+	hits = trigger_hits;
+	LEAVE_CRITICAL_SECTION
+	
+	return hits;
+}
+
+// ----------------------------------------------------------------------------
+static inline void trigger_out_toggle(void)
+{
+	switch (trigger_output) {
+		case TRIGGER_OUT_PIN:
+			TOGGLE(TRIGGER_PIN);
+			break;
+		
+		#if  HARDWARE_VERSION_MINOR >= 2
+		case TRIGGER_OUT_LED1:
+			TOGGLE(LED_DUO1_1);
+			break;
+		
+		case TRIGGER_OUT_LED2:
+			TOGGLE(LED_DUO2_1);
+			break;
+		#endif
+	}
+}
+
+// ----------------------------------------------------------------------------
+static inline void trigger_out_fire(void)
+{
+	trigger_out_toggle();
+	
+	if (trigger_mode == TRIGGER_OUT_PULSE) {
+		_delay_us(TRIGGER_PULSE_US);
+		trigger_out_toggle();
+	}
+	
+	trigger_hits++;
+}
+
+// ----------------------------------------------------------------------------
+// Interrupt Kontext, CANPAGE zeigt auf das empfangene MOb. Die Bibliothek
+// hat das MOb schon wieder fuer den Empfang freigegeben, gueltig sind nur
+// noch die Register des Identifiers.
+
+void trigger_out_check(void)
+{
+	if (trigger_mode == TRIGGER_OUT_OFF || trigger.length)
+		return;
+	
+	uint32_t id;
+	bool extended = (CANCDMOB & (1 << IDE)) ? true : false;
+	
+	if (extended != trigger.extended || (CANIDT4 & (1 << RTRTAG)))
+		return;
+	
+	if (extended) {
+		id = ((uint32_t) CANIDT1 << 21) | ((uint32_t) CANIDT2 << 13) |
+			 ((uint16_t) CANIDT3 << 5) | (CANIDT4 >> 3);
+	}
+	else {
+		id = ((uint16_t) CANIDT1 << 3) | (CANIDT2 >> 5);
+	}
+	
+	if ((id ^ trigger.id) & trigger.mask)
+		return;
+	
+	trigger_out_fire();
+}
+
+// ----------------------------------------------------------------------------
+void trigger_out_update(const can_t *msg)
+{
+	if (trigger_mode == TRIGGER_OUT_OFF || trigger.length == 0 || msg->flags.rtr)
+		return;
+	
+	if (!capture_match(&trigger, msg))
+		return;
+	
+	// the interrupt would stretch the pulse and also counts the hits
+	ENTER_CRITICAL_SECTION
+	trigger_out_fire();
+	LEAVE_CRITICAL_SECTION
+}
@@ -0,0 +1,114 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	TRIGGER_OUT_H
+#define	TRIGGER_OUT_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Hardware trigger output on a matching message
+ *
+ * Triggers on the identifier only are checked in the receive interrupt:
+ * the CAN library calls CAN_INDICATE_RX_TRAFFIC_FUNCTION while CANPAGE
+ * still selects the MOb of the received message, trigger_out_check()
+ * compares the identifier registers of the MOb and pulses or toggles the
+ * output on a match. DLC and data can not be read there, the library has
+ * already copied the message and enabled the MOb for the next reception
+ * (CANCDMOB without DLC). Triggers with data bytes are therefore checked
+ * by trigger_out_update() on the copy of the message when the main loop
+ * fetches it from the library (rx_queue_poll(), before all other
+ * functions).
+ *
+ * Latency (16 MHz) of an identifier trigger: the controller sets RXOK at
+ * the end of the frame, the interrupt copies the message into the buffer
+ * of the library and then calls the hook, the edge follows about 20 us
+ * after the end of the frame (about 320 cycles). This is the best case,
+ * the CAN interrupt is delayed by everything that blocks interrupts:
+ *
+ *  - mob_commit() with a reinitialization (bitrate, mode or partition)
+ *    keeps the interrupts disabled during can_init() and the setup of
+ *    all MObs, see mob_get_blind_time(). Messages received in that time
+ *    are lost anyway.
+ *  - the interrupt of timer 1 every 10 ms (system time and bus load)
+ *  - the interrupt for another MOb served first, about 20 us each
+ *  - short critical sections of a few us: the buffer functions of the
+ *    library used by the RX and TX queues (can_get_message() copies a
+ *    message), busload_add(), systime_ms() and systime_ticks(), the
+ *    MOb accesses of the MOb manager and the settings of the trigger
+ *
+ * A trigger with data bytes additionally depends on the main loop, e.g.
+ * on the output of the shell, its latency is in the range of ms.
+ *
+ * Outputs are TRIGGER_PIN (a spare pin, see config.h) or the green part
+ * of one of the duo LEDs. While used for the trigger the LED should not be
+ * used for the bus load gauge.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "config.h"
+#include "capture.h"
+
+// ----------------------------------------------------------------------------
+typedef enum {
+	TRIGGER_OUT_OFF,
+	TRIGGER_OUT_PULSE,		//!< pulse of TRIGGER_PULSE_US
+	TRIGGER_OUT_TOGGLE		//!< change the level on every match
+} trigger_out_mode_t;
+
+typedef enum {
+	TRIGGER_OUT_PIN,
+	TRIGGER_OUT_LED1,
+	TRIGGER_OUT_LED2
+} trigger_out_output_t;
+
+// ----------------------------------------------------------------------------
+// The trigger compares identifier, mask and data like a trigger of the
+// capture, remote frames never match. Without data bytes the trigger is
+// checked in the receive interrupt, otherwise in the main loop.
+
+extern void trigger_out_set(const capture_trigger_t *trigger);
+
+// ----------------------------------------------------------------------------
+extern bool trigger_out_set_mode(trigger_out_mode_t mode, trigger_out_output_t output);
+
+// ----------------------------------------------------------------------------
+extern trigger_out_mode_t trigger_out_get_mode(void);
+
+// ----------------------------------------------------------------------------
+extern trigger_out_output_t trigger_out_get_output(void);
+
+// ----------------------------------------------------------------------------
+extern uint16_t trigger_out_get_hits(void);
+
+// ----------------------------------------------------------------------------
+// Called from the receive interrupt (see CAN_INDICATE_RX_TRAFFIC_FUNCTION),
+// compares only the identifier
+
+extern void trigger_out_check(void);
+
+// ----------------------------------------------------------------------------
+// Checks a trigger with data bytes on a received message, called by
+// rx_queue_poll()
+
+extern void trigger_out_update(const can_t *msg);
+
+#endif	// TRIGGER_OUT_H
@@ -0,0 +1,266 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#include "tx_queue.h"
+
+#include "config.h"
+#include "utils.h"
+#include "systime.h"
+#include "mob_manager.h"
+#include "pool.h"
+#include "busload.h"
+#include "request.h"
+#include "gateway.h"
+
+// the lower bits of the flags hold the tag
+#define	TX_FLAG_DEADLINE	0x40
+#define	TX_FLAG_ONE_SHOT	0x80
+
+typedef struct {
+	uint8_t head;		// blocks of the pool
+	uint8_t tail;
+	uint8_t count;
+	
+	// MOb currently transmitting a message of this queue + 1, 0 if none
+	uint8_t mob;
+	uint16_t deadline;
+	uint8_t flags;
+	#if SUPPORT_TIMESTAMPS
+	uint16_t stamp;		// time stamp of the message (reception if forwarded)
+	#endif
+} tx_queue_t;
+
+static tx_queue_t tx_queue[TX_QUEUE_COUNT];
+
+// ----------------------------------------------------------------------------
+void tx_queue_init(void)
+{
+	for (uint8_t i = 0; i < TX_QUEUE_COUNT; i++) {
+		tx_queue[i].head = POOL_NONE;
+		tx_queue[i].tail = POOL_NONE;
+	}
+}
+
+// ----------------------------------------------------------------------------
+static void tx_queue_remove(tx_queue_t *q)
+{
+	uint8_t block = q->head;
+	
+	q->head = pool_get(block)->next;
+	if (q->head == POOL_NONE)
+		q->tail = POOL_NONE;
+	q->count--;
+	
+	pool_free(POOL_TX, block);
+}
+
+static uint16_t tx_expired;
+static uint16_t tx_aborted;
+
+// Identifiers below limit[n] go to queue n, all others to the last queue.
+// Extended identifiers are compared by their upper 11 bits.
+static const uint16_t tx_queue_limit[TX_QUEUE_COUNT - 1] = { TX_QUEUE_ID_LIMITS };
+
+// ----------------------------------------------------------------------------
+static uint8_t tx_queue_for_id(const can_t *msg)
+{
+	uint16_t id;
+	
+	if (msg->flags.extended)
+		id = msg->id >> 18;
+	else
+		id = msg->id;
+	
+	uint8_t queue = 0;
+	while (queue < TX_QUEUE_COUNT - 1 && id >= tx_queue_limit[queue])
+		queue++;
+	
+	return queue;
+}
+
+// ----------------------------------------------------------------------------
+bool tx_queue_send(const can_t *msg, const tx_options_t *options)
+{
+	uint8_t queue = TX_QUEUE_AUTO;
+	if (options)
+		queue = options->queue;
+	
+	if (queue == TX_QUEUE_AUTO)
+		queue = tx_queue_for_id(msg);
+	else if (queue >= TX_QUEUE_COUNT)
+		return false;
+	
+	uint8_t block = pool_alloc(POOL_TX);
+	if (block == POOL_NONE)
+		return false;
+	
+	pool_block_t *entry = pool_get(block);
+	
+	entry->msg = *msg;
+	entry->flags = 0;
+	if (options)
+	{
+		if (options->timeout) {
+			entry->deadline = systime_ms() + options->timeout;
+			entry->flags |= TX_FLAG_DEADLINE;
+		}
+		if (options->one_shot)
+			entry->flags |= TX_FLAG_ONE_SHOT;
+		entry->flags |= options->tag & (TX_TAG_MODULE | TX_TAG_INDEX);
+	}
+	
+	tx_queue_t *q = &tx_queue[queue];
+	if (q->tail == POOL_NONE)
+		q->head = block;
+	else
+		pool_get(q->tail)->next = block;
+	q->tail = block;
+	q->count++;
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+// Reports the transmission of a tagged message to its sender
+
+static void tx_queue_report(const tx_queue_t *q, uint8_t mob)
+{
+	uint8_t module = q->flags & TX_TAG_MODULE;
+	
+	// the MOb stores CANTIM at the end of the frame
+	if (module == TX_TAG_REQUEST)
+		request_tx_done(q->flags & TX_TAG_INDEX,
+				mob_stamp_to_ticks(mob_get_timestamp(mob)));
+	else if (module == TX_TAG_GATEWAY)
+		gateway_tx_done(q->flags & TX_TAG_INDEX, mob_stamp_to_ticks(q->stamp),
+				mob_stamp_to_ticks(mob_get_timestamp(mob)));
+}
+
+// ----------------------------------------------------------------------------
+// Checks the message of the queue currently in a MOb. Returns true if the
+// MOb is free again.
+
+static bool tx_queue_check_mob(tx_queue_t *q)
+{
+	uint8_t mob = q->mob - 1;
+	
+	// The library may also have used an RX MOb without filter, so the
+	// role of the MOb says nothing. If it is enabled for reception now the
+	// MOb manager has applied new filters, the message was either sent or
+	// aborted before.
+	if (mob_is_receiving(mob))
+		return true;
+	
+	if (!mob_is_busy(mob)) {
+		tx_queue_report(q, mob);
+		return true;
+	}
+	
+	if ((q->flags & TX_FLAG_ONE_SHOT) && mob_get_errors(mob)) {
+		mob_abort(mob);
+		tx_aborted++;
+		return true;
+	}
+	
+	if ((q->flags & TX_FLAG_DEADLINE) && systime_elapsed(q->deadline)) {
+		mob_abort(mob);
+		tx_expired++;
+		return true;
+	}
+	
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+void tx_queue_pump(void)
+{
+	// Check all MObs first, the library could otherwise reuse a finished
+	// MOb for another queue before its queue has seen it free.
+	for (uint8_t i = 0; i < TX_QUEUE_COUNT; i++)
+	{
+		tx_queue_t *q = &tx_queue[i];
+		
+		if (q->mob && tx_queue_check_mob(q))
+			q->mob = 0;
+	}
+	
+	for (uint8_t i = 0; i < TX_QUEUE_COUNT; i++)
+	{
+		tx_queue_t *q = &tx_queue[i];
+		
+		// wait until the last message of this queue is sent
+		if (q->mob)
+			continue;
+		
+		// discard messages which are too late
+		while (q->count)
+		{
+			pool_block_t *entry = pool_get(q->head);
+			
+			if (!(entry->flags & TX_FLAG_DEADLINE) || !systime_elapsed(entry->deadline))
+				break;
+			
+			tx_queue_remove(q);
+			tx_expired++;
+		}
+		
+		if (q->count == 0)
+			continue;
+		
+		if (!can_check_free_buffer())
+			return;
+		
+		pool_block_t *entry = pool_get(q->head);
+		
+		// can_send_message() returns the number of the MOb + 1
+		uint8_t mob = can_send_message(&entry->msg);
+		if (!mob)
+			return;
+		
+		busload_add(&entry->msg);
+		
+		q->mob = mob;
+		q->deadline = entry->deadline;
+		q->flags = entry->flags;
+		#if SUPPORT_TIMESTAMPS
+		q->stamp = entry->msg.timestamp;
+		#endif
+		
+		tx_queue_remove(q);
+	}
+}
+
+// ----------------------------------------------------------------------------
+uint8_t tx_queue_get_depth(uint8_t queue)
+{
+	return tx_queue[queue].count;
+}
+
+// ----------------------------------------------------------------------------
+uint16_t tx_queue_get_expired(void)
+{
+	return tx_expired;
+}
+
+// ----------------------------------------------------------------------------
+uint16_t tx_queue_get_aborted(void)
+{
+	return tx_aborted;
+}
@@ -0,0 +1,104 @@
+// coding: utf-8
+// -----------------------------------------------------------------------------
+/*
+ * Copyright (C) 2008 Fabian Greif, Roboterclub Aachen e.V.
+ * 
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef	TX_QUEUE_H
+#define	TX_QUEUE_H
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Priority queues for messages to be transmitted
+ *
+ * Every queue is a FIFO. Queue 0 has the highest priority, whenever a
+ * MOb for transmission is free it is fed from the highest priority
+ * non-empty queue. Each queue has at most one message in a MOb at a time
+ * so that the order within a queue is preserved.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+
+// select the queue by the identifier of the message
+#define	TX_QUEUE_AUTO		0xff
+
+// Tags of messages whose transmission is reported back to the sender:
+// the module in the upper bits and the number of an entry in the lower
+// bits, e.g. TX_TAG_REQUEST | n.
+#define	TX_TAG_NONE			0x00
+#define	TX_TAG_REQUEST		0x10
+#define	TX_TAG_GATEWAY		0x20
+#define	TX_TAG_MODULE		0x30
+#define	TX_TAG_INDEX		0x0f
+
+// ----------------------------------------------------------------------------
+/**
+ * \brief	Options for the transmission of a message
+ */
+typedef struct {
+	uint8_t queue;		//!< TX queue or TX_QUEUE_AUTO
+	uint16_t timeout;	//!< discard the message after timeout ms, 0 = never
+	bool one_shot;		//!< abort after the first failed attempt, see below
+	uint8_t tag;		//!< report the transmission, see tx_queue_send()
+} tx_options_t;
+
+// ----------------------------------------------------------------------------
+extern void tx_queue_init(void);
+
+// ----------------------------------------------------------------------------
+// Appends a message to a queue. Without options the queue is selected by
+// the identifier and the message waits until it is sent. Returns false
+// if no block of the pool is available.
+//
+// For messages with a tag the module is notified when the controller has
+// transmitted the message (e.g. request_tx_done()) together with the time
+// of the end of the frame taken from the time stamp of the MOb. Forwarded
+// messages keep the time stamp of their reception, it is reported as
+// well (gateway_tx_done()). The
+// completion is detected by tx_queue_pump(), messages which expire or
+// are aborted are not reported.
+
+extern bool tx_queue_send(const can_t *msg, const tx_options_t *options);
+
+// ----------------------------------------------------------------------------
+// Moves messages from the queues to free MObs, has to be called
+// periodically.
+
+extern void tx_queue_pump(void);
+
+// ----------------------------------------------------------------------------
+// Number of messages waiting in a queue
+
+extern uint8_t tx_queue_get_depth(uint8_t queue);
+
+// ----------------------------------------------------------------------------
+// Number of messages discarded because their deadline passed
+
+extern uint16_t tx_queue_get_expired(void);
+
+// ----------------------------------------------------------------------------
+// Number of one-shot messages aborted after a failed attempt. The errors
+// are polled from tx_queue_pump(), until then the controller retransmits
+// automatically (TTC mode would affect all MObs), so a one-shot message
+// may be repeated a few times before it is aborted.
+
+extern uint16_t tx_queue_get_aborted(void);
+
+#endif	// TX_QUEUE_H
@@ -29,6 +29,27 @@
 #include "utils.h"
 
 #include "termio.h"
+#include "rx_queue.h"
+#include "mob_manager.h"
+#include "tx_queue.h"
+#include "autobaud.h"
+#include "pool.h"
+#include "idfilter.h"
+#include "change_filter.h"
+#include "rate_limit.h"
+#include "id_stats.h"
+#include "event_queue.h"
+#include "period_watch.h"
+#include "busload.h"
+#include "capture.h"
+#include "signals.h"
+#include "isotp.h"
+#include "j1939.h"
+#include "request.h"
+#include "autoreply.h"
+#include "gateway.h"
+#include "trigger_out.h"
+#include "e2e.h"
 
 static bool use_timestamps = false;
 
@@ -40,7 +61,7 @@ static bool channel_open = false;
 static bool bitrate_set = false;
 
 // ----------------------------------------------------------------------------
-bool usbcan_decode_message(char *str, uint8_t length)
+bool usbcan_decode_message(char *str, uint8_t length, const tx_options_t *options)
 {
 	can_t msg;
 	uint8_t dlc_pos;
@@ -114,13 +135,1083 @@ bool usbcan_decode_message(char *str, uint8_t length)
 		}
 	}
 	
-	// finally try to send the message
-	if (can_send_message( &msg ))
+	// finally try to queue the message
+	if (tx_queue_send( &msg, options ))
 		return true;
 	else
 		return false;
 }
 
+// ----------------------------------------------------------------------------
+// Writes the message as t, T, r or R record without timestamp and \r
+
+static void usbcan_put_message(const can_t *message)
+{
+	uint8_t length = message->length;
+	
+	if (message->flags.rtr)
+	{
+		// print identifier
+		if (message->flags.extended) {
+			printf_P(PSTR("R%08lx"), message->id);
+		} else {
+			uint16_t id = message->id;
+			printf_P(PSTR("r%03x"), id);
+		}
+		term_putc(length + '0');
+	}
+	else
+	{
+		// print identifier
+		if (message->flags.extended) {
+			printf_P(PSTR("T%08lx"), message->id);
+		} else {
+			uint16_t id = message->id;
+			printf_P(PSTR("t%03x"), id);
+		}
+		term_putc(length + '0');
+		
+		// print data
+		for (uint8_t i = 0; i < length; i++)
+			term_put_hex(message->data[i]);
+	}
+}
+
+// ----------------------------------------------------------------------------
+// Reads a 32 bit value given as 8 hex digits
+
+static uint32_t usbcan_decode_long(char *str)
+{
+	return ((uint32_t) hex_to_byte(&str[0]) << 24) |
+		   ((uint32_t) hex_to_byte(&str[2]) << 16) |
+		   ((uint16_t) hex_to_byte(&str[4]) << 8) |
+		   hex_to_byte(&str[6]);
+}
+
+// ----------------------------------------------------------------------------
+// Reads an identifier given with 3 (standard) or 8 (extended) hex digits
+
+static bool usbcan_decode_id(char *str, uint8_t length, uint32_t *id, bool *extended)
+{
+	if (length == 8) {
+		*id = usbcan_decode_long(str);
+		*extended = true;
+	}
+	else if (length == 3) {
+		*id = ((uint16_t) char_to_byte(&str[0]) << 8) | hex_to_byte(&str[1]);
+		*extended = false;
+	}
+	else {
+		return false;
+	}
+	
+	return true;
+}
+
+#if SUPPORT_SIGNALS
+
+// ----------------------------------------------------------------------------
+// Reads a definition of a signal: identifier (3 or 8 digits), start bit,
+// length and flags (2 digits each), factor (4 digits), offset (8 digits)
+// and number of decimals (1 digit)
+
+static bool usbcan_decode_signal(char *str, uint8_t length, signal_t *signal)
+{
+	uint32_t id;
+	bool extended;
+	
+	if (length != 22 && length != 27)
+		return false;
+	
+	uint8_t n = length - 19;
+	if (!usbcan_decode_id(str, n, &id, &extended))
+		return false;
+	
+	str += n;
+	signal->key = extended ? (id | 0x80000000) : id;
+	signal->start = hex_to_byte(&str[0]);
+	signal->length = hex_to_byte(&str[2]);
+	signal->flags = hex_to_byte(&str[4]);
+	signal->factor = (hex_to_byte(&str[6]) << 8) | hex_to_byte(&str[8]);
+	signal->offset = usbcan_decode_long(&str[10]);
+	signal->decimals = str[18] - '0';
+	signal->low = INT32_MIN;
+	signal->high = INT32_MAX;
+	
+	return true;
+}
+
+#endif
+
+#if SUPPORT_REQUEST || SUPPORT_AUTOREPLY
+
+// ----------------------------------------------------------------------------
+// Reads a data frame given like t or T at the beginning of the string.
+// Returns the number of characters used or 0 if the format is wrong.
+
+static uint8_t usbcan_decode_frame(char *str, uint8_t length, can_t *msg)
+{
+	bool extended;
+	uint32_t id;
+	uint8_t n;
+	
+	if (str[0] == 't')
+		n = 3;
+	else if (str[0] == 'T')
+		n = 8;
+	else
+		return 0;
+	
+	if (length < n + 2)
+		return 0;
+	
+	uint8_t dlc = str[n + 1] - '0';
+	if (dlc > 8 || length < n + 2 + 2 * dlc)
+		return 0;
+	
+	if (!usbcan_decode_id(&str[1], n, &id, &extended))
+		return 0;
+	
+	msg->id = id;
+	msg->flags.extended = extended;
+	msg->flags.rtr = 0;
+	msg->length = dlc;
+	
+	for (uint8_t i = 0; i < dlc; i++)
+		msg->data[i] = hex_to_byte(&str[n + 2 + 2 * i]);
+	
+	return n + 2 + 2 * dlc;
+}
+
+#endif
+
+#if SUPPORT_REQUEST
+
+// ----------------------------------------------------------------------------
+// Reads an entry of the request engine: the request like t or T, the
+// identifier of the response, timeout and interval
+
+static bool usbcan_decode_request(char *str, uint8_t length, request_t *request)
+{
+	bool extended;
+	uint32_t id;
+	uint8_t n = (str[0] == 'T') ? 8 : 3;
+	
+	uint8_t used = usbcan_decode_frame(str, length, &request->msg);
+	if (used == 0 || length != used + n + 8)
+		return false;
+	
+	str += used;
+	if (!usbcan_decode_id(str, n, &id, &extended))
+		return false;
+	request->response_key = extended ? (id | 0x80000000) : id;
+	
+	str += n;
+	request->timeout = (hex_to_byte(&str[0]) << 8) | hex_to_byte(&str[2]);
+	request->interval = (hex_to_byte(&str[4]) << 8) | hex_to_byte(&str[6]);
+	
+	return true;
+}
+
+#endif
+
+// ----------------------------------------------------------------------------
+// Reads a trigger of the capture: identifier and mask (3 or 8 digits
+// each), number of data bytes n, n data bytes and n masks
+
+static bool usbcan_decode_trigger(char *str, uint8_t length, capture_trigger_t *trigger)
+{
+	uint8_t n = (length >= 7 && (length - 7) % 4 == 0) ? 3 : 8;
+	
+	if (length < 2 * n + 1 || !usbcan_decode_id(str, n, &trigger->id, &trigger->extended))
+		return false;
+	
+	bool extended;
+	if (!usbcan_decode_id(&str[n], n, &trigger->mask, &extended))
+		return false;
+	
+	str += 2 * n;
+	trigger->length = str[0] - '0';
+	if (trigger->length > 8 || length != 2 * n + 1 + 4 * trigger->length)
+		return false;
+	
+	for (uint8_t i = 0; i < trigger->length; i++) {
+		trigger->data[i] = hex_to_byte(&str[1 + 2 * i]);
+		trigger->data_mask[i] = hex_to_byte(&str[1 + 2 * (trigger->length + i)]);
+	}
+	
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+// Extensions to the Lawicel protocol. All of them start with 'x' followed by
+// an upper case letter selecting the function. Answers to a query repeat
+// the command (like 'V' or 'N'), records sent without a request use 'x'
+// followed by the corresponding lower case letter.
+//
+// xM[nn]	set/read the number of MObs reserved for transmission
+// xSn		change the bitrate (like S) while the channel is open, the
+//			filters are kept
+// xB		read the blind time of the last reconfiguration in us
+// xA		detect the bitrate (channel must be closed), answers with xAn
+//			where n is the parameter for S or xACn for the n-th custom
+//			bit timing
+// xU[rrtt]	read the usage of the message pool, answers with xUffrrtt
+//			(free blocks, blocks used by RX and TX) followed by the number
+//			of failed allocations for RX and TX as 4 hex digits each (for
+//			RX the received messages dropped for lack of a free block).
+//			With rrtt the blocks reserved for RX and TX are set.
+// xF[m]	set/read the mode of the software ID filter (0 = off, 1 = allow,
+//			2 = deny), answers with xFmssssee (mode, number of standard
+//			and extended identifiers)
+// xF+iii	add a standard (3 digits) or extended (8 digits) identifier
+// xF-iii	remove an identifier
+// xFC		remove all identifiers
+// xC[0|1kkkk]	disable or enable the change-only forwarding with a
+//			keepalive of kkkk ms (0000 = none). Without parameters answers
+//			with xCmkkkkssssvvvv (enabled, keepalive, suppressed messages,
+//			evictions from the cache).
+// xN		read the number of rate limiting rules and dropped messages,
+//			answers with xNnndddd
+// xN+iiijjjEhhhh	add a rule for the identifiers iii to jjj (3 or 8 digits
+//			each), E forwards every hhhh-th message, I at most one
+//			message per hhhh ms
+// xN-nn	remove rule nn
+// xNC		remove all rules
+// xI		dump the statistics of all received identifiers. For each
+//			identifier a record xiiii (or 8 digits) followed by count
+//			(8 digits), min, max and mean interval in ms (4 digits each),
+//			DLC and, without the receive buffer of the CAN library, the
+//			filter code (2 digits) is sent. The answer xInn gives the
+//			number of records.
+// xIC		clear the statistics
+// xW[hhhh]	start the supervision of cyclic messages with a training of
+//			hhhh ms or read the state (xW0 = off, xW1 = training, xW2 =
+//			active). Alarms are sent as xwciiivvvvvvvv with c = 'm'
+//			(missing for v ms), 'e' (too early, interval v ms) or 'r'
+//			(reappeared after v ms).
+// xW0		stop the supervision
+// xL		read the bus load, answers with xLccaapp (current, average and
+//			peak in percent, hex). Only frames passing the hardware
+//			filters are counted, the load is too low with filters set.
+// xLR		reset the peak
+// xLGn		show the bus load with the duo LEDs (n = 1) or the mode (n = 0)
+// xV		read the number of signals and the streaming mode, answers
+//			with xVnns
+// xV+iiissllffffffoooooooood	define a signal for the identifier iii (3 or
+//			8 digits): start bit ss, length ll, flags ff (1 = big endian,
+//			2 = signed, 4 = event on change, 8 = events for the limits),
+//			factor (16 bit) and offset (32 bit, both signed) and d
+//			decimals. The answer xVnn gives the number of the signal.
+//			Events are sent as xvcnnnvvvvvvvv with the number of the signal
+//			nnn and the scaled value v, c = 'c' (changed), 'h' (above the
+//			upper limit), 'l' (below the lower limit) or 'n' (back to
+//			normal).
+// xVLnnllllllllhhhhhhhh	set the limits of signal nn
+// xV-nn	remove signal nn
+// xVC		remove all signals
+// xVS		store the signals in the EEPROM
+// xVEn		only send the events (n = 1) or also the messages (n = 0)
+// xT		read the state of the ISO-TP channels, answers with xT followed
+//			by one digit per channel (1 = open)
+// xTOn<tx><rx>bbsspp	open ISO-TP channel n: TX and RX identifier (3 or 8
+//			digits each), block size and STmin for the flow control and
+//			the byte used for padding. Frames with the RX identifier are
+//			no longer forwarded, complete PDUs are sent as xtdnlll followed
+//			by the data (lll = length). Events are sent as xtc00nvvvvvvvv
+//			with c = 's' (sent), 'b' (no flow control), 'c' (no consecutive
+//			frame), 'q' (wrong sequence number), 'o' (overflow) or 'a'
+//			(aborted by the ECU), see isotp.h.
+// xTXn		close channel n
+// xTSn<data>	send a payload of up to ISOTP_TX_SIZE bytes on channel n (the
+//			command line limits it to 29 bytes)
+// xJ		read the state of the J1939 reassembly, answers with xJeaann
+//			(enabled, own address, transfers in progress)
+// xJ1aa	reassemble the J1939 transport protocol, aa is the own address
+//			used to answer RTS with CTS (fe = only monitor). The frames of
+//			PGN 0xEC00 and 0xEB00 are no longer forwarded, complete
+//			messages are sent as xjdppppppssddlll followed by the data
+//			(PGN, source and destination address, length). Events are sent
+//			as xjc0ssvvvvvvvv, see j1939.h.
+// xJ0		stop the reassembly
+// xQ		read the state of the request engine, answers with xQnnr
+//			(number of entries, running)
+// xQ+<t|T message><response>ttttiiii	add a request, e.g.
+//			"xQ+t7df802010c00000000007e800320064": the message like t or T,
+//			identifier of the response (same number of digits), timeout
+//			and repeat interval in ms
+//			(0000 = only once). The answer xQnn gives the number of the
+//			entry. Responses are sent as xqrnnllllllll followed by the
+//			message like t/T (entry, latency in us), missing responses as
+//			xqt0nntttttttt.
+// xQ-nn	remove entry nn
+// xQC		remove all entries
+// xQS		start sending the requests
+// xQX		stop
+// xR		read the number of auto-reply rules, answers with xRnn
+// xRD<trigger>	add a rule for data frames, the trigger has the format of
+//			xKA. The answer xRnn gives the number of the rule.
+// xRR<trigger>	add a rule for remote frames (number of data bytes 0)
+// xRAnn<t|T message>	set the reply of rule nn, the rule is only active
+//			with a reply
+// xROnnddddcmmsk	options of rule nn: delay in ms, counter byte c (0..7,
+//			f = none) with the bits mm, checksum byte s (0..7, f = none)
+//			and its type k (0 = sum, 1 = xor of the other bytes)
+// xR-nn	remove rule nn
+// xRC		remove all rules
+// xG		read the number of gateway rules, answers with xGnn
+// xG+<trigger>	add a rule retransmitting the matching data frames, the
+//			trigger has the format of xKA. The answer xGnn gives the
+//			number of the rule.
+// xGInn<id><mask>	replace the bits of the identifier selected by the
+//			mask (3 or 8 digits each)
+// xGPnn<data><mask>	replace the bits of the data selected by the mask
+//			(8 bytes each)
+// xGSnnbleffffoooo	scale the unsigned field at byte b with l (1 or 2)
+//			bytes, e = 1 for big endian, with factor / 256 and offset
+//			(signed 16 bit each). b = f disables the scaling.
+// xGHnn	read the statistics of rule nn, answers with xGHhhhhhhhhllllmmmm
+//			(hits, last and maximum latency in us from the reception
+//			to the end of the transmission of the copy)
+// xG-nn	remove rule nn
+// xGC		remove all rules
+// xH		read the trigger output, answers with xHmohhhh (mode, output,
+//			number of matches)
+// xHM<trigger>	set the match of the trigger output, format like xKA
+// xHmo		set the mode m (0 = off, 1 = pulse, 2 = toggle) and the output
+//			o (0 = TRIGGER_PIN, 1 = duo LED 1, 2 = duo LED 2)
+// xE		read the number of E2E checked identifiers, answers with xEnn
+// xE+<id>pdddd	check the identifier (3 or 8 digits) with profile p (1 or 2)
+//			and data ID dddd (profile 2: the low byte for all counter
+//			values, see xEI). The answer xEnn gives the number of the entry.
+// xELnncklm	layout of entry nn: CRC byte c and counter byte k (0..7,
+//			f = none), counter in the low (l = 0) or high nibble (l = 1),
+//			largest allowed step m of the counter (1..e). Profile 2
+//			needs the counter if the CRC is checked.
+// xEInn<data IDs>	set the DataIDList of entry nn (profile 2): 16 bytes,
+//			the data ID for the counter values 0 to 15
+// xESnn	read the counters of entry nn, answers with
+//			xESooooccccrrrrlllldddd (valid, CRC errors, repeated, lost and
+//			too short messages). Violations are sent as events
+//			xe<code><id><value>.
+// xE-nn	remove entry nn
+// xEC		remove all entries
+// xEZ		set all counters to zero
+// xKA<trigger>	set trigger A: identifier and mask (3 or 8 digits each),
+//			number of data bytes n, n data bytes and n data masks, e.g.
+//			"xKA1237ff2aa00ff00" for 0x123 with data[0] = 0xaa
+// xKBhhhh<trigger>	set trigger B which has to follow A within hhhh ms
+// xKB		only use trigger A
+// xKPnn	number of messages recorded after the trigger
+// xKS		clear the buffer and start the recording
+// xKX		stop the recording
+// xK		read the state, answers with xKsnntt (state, number of messages
+//			in the buffer, position of the trigger)
+// xKD		dump the buffer, each message is sent as xkc followed by the
+//			message (like t, T, r or R) and the time in ms (4 digits), c is
+//			'p' before, 't' for and 'a' after the trigger. The answer xKnn
+//			gives the number of messages.
+//
+// The following prefixes set options for the frame (t, T, r or R) after
+// them and can be combined, e.g. "xP0xD0064xOt1230":
+//
+// xPn		use the TX queue n
+// xDhhhh	discard the frame if it could not be sent within hhhh ms
+//			(0001..7530, i.e. at most 30000 ms)
+// xO		one-shot, abort the transmission after the first error. The
+//			error is noticed by the main loop, until then the controller
+//			repeats the frame automatically (the AT90CAN has no
+//			single-shot mode per MOb), so it may be sent more than once.
+
+static bool usbcan_decode_tx_prefix(char *str, uint8_t length)
+{
+	tx_options_t options = {
+		.queue = TX_QUEUE_AUTO,
+		.timeout = 0,
+		.one_shot = false
+	};
+	
+	while (length)
+	{
+		switch (str[0]) {
+			case 't':
+			case 'T':
+			case 'r':
+			case 'R':
+				return usbcan_decode_message(str, length, &options);
+			
+			case 'x':
+				str += 1;
+				length -= 1;
+				break;
+			
+			case 'P':
+				if (length < 2 || str[1] < '0' || str[1] >= '0' + TX_QUEUE_COUNT)
+					return false;
+				options.queue = str[1] - '0';
+				str += 2;
+				length -= 2;
+				break;
+			
+			case 'D':
+				if (length < 5)
+					return false;
+				options.timeout = (hex_to_byte(&str[1]) << 8) | hex_to_byte(&str[3]);
+				
+				// systime_elapsed() only covers half of the 16 bit range
+				if (options.timeout == 0 || options.timeout > 30000)
+					return false;
+				str += 5;
+				length -= 5;
+				break;
+			
+			case 'O':
+				options.one_shot = true;
+				str += 1;
+				length -= 1;
+				break;
+			
+			default:
+				return false;
+		}
+	}
+	
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+static bool usbcan_decode_extension(char *str, uint8_t length)
+{
+	uint8_t temp;
+	
+	if (length == 0)
+		return false;
+	
+	switch (str[0]) {
+		case 'M':
+			if (length == 3) {
+				if (!mob_set_partition(hex_to_byte(&str[1])))
+					return false;
+			}
+			else if (length == 1) {
+				printf_P(PSTR("xM%02x"), mob_get_tx_count());
+			}
+			else {
+				return false;
+			}
+			break;
+		
+		case 'S':
+			if ( length != 2 || !bitrate_set || (temp = str[1] - '0') > 8 || temp == 7 ) {
+				return false;
+			}
+			if ( temp == 8 ) {
+				temp--;
+			}
+			mob_init(temp);
+			break;
+		
+		case 'B':
+			printf_P(PSTR("xB%04x"), mob_get_blind_time());
+			break;
+		
+		case 'F':
+			if (length == 1) {
+				printf_P(PSTR("xF%x%04x%02x"), idfilter_get_mode(),
+						idfilter_get_standard_count(), idfilter_get_extended_count());
+			}
+			else if (str[1] == '+' || str[1] == '-') {
+				uint32_t id;
+				bool extended;
+				
+				if (!usbcan_decode_id(&str[2], length - 2, &id, &extended))
+					return false;
+				
+				if (str[1] == '+') {
+					if (!idfilter_add(id, extended))
+						return false;
+				}
+				else if (!idfilter_remove(id, extended)) {
+					return false;
+				}
+			}
+			else if (str[1] == 'C' && length == 2) {
+				idfilter_clear();
+			}
+			else if (length == 2 && (temp = str[1] - '0') <= IDFILTER_DENY) {
+				idfilter_set_mode(temp);
+			}
+			else {
+				return false;
+			}
+			break;
+		
+		case 'C':
+			if (length == 1) {
+				printf_P(PSTR("xC%x%04x%04x%04x"), change_filter_is_enabled(),
+						change_filter_get_keepalive(), change_filter_get_suppressed(),
+						change_filter_get_evictions());
+			}
+			else if (length == 2 && str[1] == '0') {
+				change_filter_disable();
+			}
+			else if (length == 6 && str[1] == '1') {
+				change_filter_enable((hex_to_byte(&str[2]) << 8) | hex_to_byte(&str[4]));
+			}
+			else {
+				return false;
+			}
+			break;
+		
+		case 'N':
+			if (length == 1) {
+				printf_P(PSTR("xN%02x%04x"), rate_limit_get_count(), rate_limit_get_dropped());
+			}
+			else if (str[1] == '+' && (length == 13 || length == 23)) {
+				rate_limit_rule_t rule;
+				uint8_t n = (length - 7) / 2;
+				char *p = &str[2 + 2 * n];
+				
+				if (!usbcan_decode_id(&str[2], n, &rule.first, &rule.extended) ||
+					!usbcan_decode_id(&str[2 + n], n, &rule.last, &rule.extended))
+					return false;
+				
+				if (p[0] == 'E')
+					rule.type = RATE_LIMIT_DECIMATE;
+				else if (p[0] == 'I')
+					rule.type = RATE_LIMIT_INTERVAL;
+				else
+					return false;
+				
+				rule.value = (hex_to_byte(&p[1]) << 8) | hex_to_byte(&p[3]);
+				
+				if (!rate_limit_add(&rule))
+					return false;
+			}
+			else if (str[1] == '-' && length == 4) {
+				if (!rate_limit_remove(hex_to_byte(&str[2])))
+					return false;
+			}
+			else if (str[1] == 'C' && length == 2) {
+				rate_limit_clear();
+			}
+			else {
+				return false;
+			}
+			break;
+		
+		case 'I':
+			if (length == 2 && str[1] == 'C') {
+				id_stats_clear();
+			}
+			else if (length == 1) {
+				uint8_t count = 0;
+				
+				for (uint8_t i = 0; i < ID_STATS_SIZE; i++)
+				{
+					uint32_t key = id_stats_get_key(i);
+					if (key == ID_TABLE_EMPTY)
+						continue;
+					
+					const id_stats_t *entry = id_stats_get(i);
+					
+					if (key & 0x80000000)
+						printf_P(PSTR("xi%08lx"), key & 0x1fffffff);
+					else
+						printf_P(PSTR("xi%03lx"), key);
+					
+					printf_P(PSTR("%08lx%04x%04x%04x%x"), entry->count,
+							(entry->count > 1) ? entry->min : 0, entry->max,
+							id_stats_get_mean(entry), entry->length);
+					#if CAN_RX_BUFFER_SIZE == 0
+					printf_P(PSTR("%02x"), entry->filter);
+					#endif
+					term_putc('\r');
+					count++;
+				}
+				
+				printf_P(PSTR("xI%02x"), count);
+			}
+			else {
+				return false;
+			}
+			break;
+		
+		case 'K':
+			if (length == 1) {
+				printf_P(PSTR("xK%x%02x%02x"), capture_get_state(), capture_get_count(),
+						capture_get_trigger_position());
+				break;
+			}
+			
+			switch (str[1]) {
+				case 'A': {
+					capture_trigger_t trigger;
+					if (!usbcan_decode_trigger(&str[2], length - 2, &trigger))
+						return false;
+					capture_set_trigger_a(&trigger);
+					break;
+				}
+				case 'B': {
+					capture_trigger_t trigger;
+					if (length == 2) {
+						capture_set_trigger_b(NULL, 0);
+					}
+					else if (length < 6 ||
+							 !usbcan_decode_trigger(&str[6], length - 6, &trigger) ||
+							 !capture_set_trigger_b(&trigger,
+									(hex_to_byte(&str[2]) << 8) | hex_to_byte(&str[4]))) {
+						return false;
+					}
+					break;
+				}
+				case 'P':
+					if (length != 4 || !capture_set_post(hex_to_byte(&str[2])))
+						return false;
+					break;
+				case 'S':
+					capture_arm();
+					break;
+				case 'X':
+					capture_stop();
+					break;
+				case 'D': {
+					uint8_t count = capture_get_count();
+					uint8_t trigger = capture_get_trigger_position();
+					
+					for (uint8_t i = 0; i < count; i++) {
+						const capture_frame_t *frame = capture_get(i);
+						
+						char c = (i < trigger) ? 'p' : ((i == trigger) ? 't' : 'a');
+						printf_P(PSTR("xk%c"), c);
+						usbcan_put_message(&frame->msg);
+						printf_P(PSTR("%04x\r"), frame->time);
+					}
+					printf_P(PSTR("xK%02x"), count);
+					break;
+				}
+				default:
+					return false;
+			}
+			break;
+		
+		#if SUPPORT_SIGNALS
+		case 'V':
+			if (length == 1) {
+				printf_P(PSTR("xV%02x%x"), signals_get_count(), signals_get_streaming());
+			}
+			else if (str[1] == '+') {
+				signal_t signal;
+				int8_t n;
+				
+				if (!usbcan_decode_signal(&str[2], length - 2, &signal) ||
+					(n = signals_add(&signal)) < 0)
+					return false;
+				printf_P(PSTR("xV%02x"), n);
+			}
+			else if (str[1] == 'L' && length == 20) {
+				if (!signals_set_thresholds(hex_to_byte(&str[2]),
+						usbcan_decode_long(&str[4]), usbcan_decode_long(&str[12])))
+					return false;
+			}
+			else if (str[1] == '-' && length == 4) {
+				if (!signals_remove(hex_to_byte(&str[2])))
+					return false;
+			}
+			else if (str[1] == 'C' && length == 2) {
+				signals_clear();
+			}
+			else if (str[1] == 'S' && length == 2) {
+				signals_save();
+			}
+			else if (str[1] == 'E' && length == 3 && (str[2] == '0' || str[2] == '1')) {
+				signals_set_streaming(str[2] == '1');
+			}
+			else {
+				return false;
+			}
+			break;
+		#endif
+		
+		#if SUPPORT_ISOTP
+		case 'T':
+			if (length == 1) {
+				term_putc('x');
+				term_putc('T');
+				for (uint8_t i = 0; i < ISOTP_CHANNELS; i++)
+					term_putc(isotp_get_config(i) ? '1' : '0');
+			}
+			else if (str[1] == 'O' && (length == 15 || length == 25)) {
+				isotp_config_t config;
+				uint32_t id;
+				bool extended;
+				uint8_t n = (length - 9) / 2;
+				char *p = &str[3 + 2 * n];
+				
+				if (!usbcan_decode_id(&str[3], n, &id, &extended))
+					return false;
+				config.tx_key = extended ? (id | 0x80000000) : id;
+				
+				if (!usbcan_decode_id(&str[3 + n], n, &id, &extended))
+					return false;
+				config.rx_key = extended ? (id | 0x80000000) : id;
+				
+				config.block_size = hex_to_byte(&p[0]);
+				config.st_min = hex_to_byte(&p[2]);
+				config.padding = hex_to_byte(&p[4]);
+				
+				if (!isotp_open(str[2] - '0', &config))
+					return false;
+			}
+			else if (str[1] == 'X' && length == 3) {
+				isotp_close(str[2] - '0');
+			}
+			else if (str[1] == 'S' && length >= 5 && (length & 1)) {
+				uint8_t data[ISOTP_TX_SIZE];
+				uint8_t count = (length - 3) / 2;
+				
+				if (count > ISOTP_TX_SIZE)
+					return false;
+				
+				for (uint8_t i = 0; i < count; i++)
+					data[i] = hex_to_byte(&str[3 + 2 * i]);
+				
+				if (!isotp_send(str[2] - '0', data, count))
+					return false;
+			}
+			else {
+				return false;
+			}
+			break;
+		#endif
+		
+		case 'H':
+			if (length == 1) {
+				printf_P(PSTR("xH%x%x%04x"), trigger_out_get_mode(),
+						trigger_out_get_output(), trigger_out_get_hits());
+			}
+			else if (str[1] == 'M') {
+				capture_trigger_t trigger;
+				
+				if (!usbcan_decode_trigger(&str[2], length - 2, &trigger))
+					return false;
+				trigger_out_set(&trigger);
+			}
+			else if (length == 3) {
+				if (!trigger_out_set_mode(str[1] - '0', str[2] - '0'))
+					return false;
+			}
+			else {
+				return false;
+			}
+			break;
+		
+		#if SUPPORT_E2E
+		case 'E':
+			if (length == 1) {
+				printf_P(PSTR("xE%02x"), e2e_get_count());
+			}
+			else if (str[1] == '+' && (length == 10 || length == 15)) {
+				uint8_t n = length - 7;
+				uint32_t id;
+				bool extended;
+				int8_t entry;
+				
+				if (!usbcan_decode_id(&str[2], n, &id, &extended))
+					return false;
+				if (extended)
+					id |= 0x80000000;
+				
+				if ((entry = e2e_add(id, str[2 + n] - '0',
+						(hex_to_byte(&str[3 + n]) << 8) | hex_to_byte(&str[5 + n]))) < 0)
+					return false;
+				printf_P(PSTR("xE%02x"), entry);
+			}
+			else if (str[1] == 'L' && length == 8) {
+				uint8_t c = (str[4] == 'f') ? E2E_NONE : str[4] - '0';
+				uint8_t k = (str[5] == 'f') ? E2E_NONE : str[5] - '0';
+				
+				if (!e2e_set_layout(hex_to_byte(&str[2]), c, k,
+						(str[6] == '1') ? 4 : 0, char_to_byte(&str[7])))
+					return false;
+			}
+			else if (str[1] == 'I' && length == 36) {
+				uint8_t list[16];
+				
+				for (uint8_t i = 0; i < 16; i++)
+					list[i] = hex_to_byte(&str[4 + 2 * i]);
+				
+				if (!e2e_set_data_id_list(hex_to_byte(&str[2]), list))
+					return false;
+			}
+			else if (str[1] == 'S' && length == 4) {
+				uint8_t n = hex_to_byte(&str[2]);
+				if (n >= e2e_get_count())
+					return false;
+				
+				const e2e_entry_t *entry = e2e_get(n);
+				printf_P(PSTR("xES%04x%04x%04x%04x%04x"), entry->ok,
+						entry->crc_errors, entry->repeated, entry->lost,
+						entry->length_errors);
+			}
+			else if (str[1] == '-' && length == 4) {
+				if (!e2e_remove(hex_to_byte(&str[2])))
+					return false;
+			}
+			else if (str[1] == 'C' && length == 2) {
+				e2e_clear();
+			}
+			else if (str[1] == 'Z' && length == 2) {
+				e2e_reset();
+			}
+			else {
+				return false;
+			}
+			break;
+		#endif
+		
+		#if SUPPORT_GATEWAY
+		case 'G':
+			if (length == 1) {
+				printf_P(PSTR("xG%02x"), gateway_get_count());
+			}
+			else if (str[1] == '+') {
+				capture_trigger_t trigger;
+				int8_t n;
+				
+				if (!usbcan_decode_trigger(&str[2], length - 2, &trigger) ||
+					(n = gateway_add(&trigger)) < 0)
+					return false;
+				printf_P(PSTR("xG%02x"), n);
+			}
+			else if (str[1] == 'I' && (length == 10 || length == 20)) {
+				uint32_t id, mask;
+				bool extended;
+				uint8_t n = (length - 4) / 2;
+				
+				if (!usbcan_decode_id(&str[4], n, &id, &extended) ||
+					!usbcan_decode_id(&str[4 + n], n, &mask, &extended) ||
+					!gateway_set_id(hex_to_byte(&str[2]), id, mask))
+					return false;
+			}
+			else if (str[1] == 'P' && length == 36) {
+				uint8_t data[8], mask[8];
+				
+				for (uint8_t i = 0; i < 8; i++) {
+					data[i] = hex_to_byte(&str[4 + 2 * i]);
+					mask[i] = hex_to_byte(&str[20 + 2 * i]);
+				}
+				
+				if (!gateway_set_patch(hex_to_byte(&str[2]), data, mask))
+					return false;
+			}
+			else if (str[1] == 'S' && length == 15) {
+				uint8_t byte = (str[4] == 'f') ? GATEWAY_NO_SCALE : str[4] - '0';
+				
+				if (!gateway_set_scale(hex_to_byte(&str[2]), byte, str[5] - '0',
+						str[6] == '1', (hex_to_byte(&str[7]) << 8) | hex_to_byte(&str[9]),
+						(hex_to_byte(&str[11]) << 8) | hex_to_byte(&str[13])))
+					return false;
+			}
+			else if (str[1] == 'H' && length == 4) {
+				uint8_t n = hex_to_byte(&str[2]);
+				if (n >= gateway_get_count())
+					return false;
+				
+				const gateway_rule_t *rule = gateway_get(n);
+				printf_P(PSTR("xGH%08lx%04x%04x"), rule->hits, rule->latency,
+						rule->latency_max);
+			}
+			else if (str[1] == '-' && length == 4) {
+				if (!gateway_remove(hex_to_byte(&str[2])))
+					return false;
+			}
+			else if (str[1] == 'C' && length == 2) {
+				gateway_clear();
+			}
+			else {
+				return false;
+			}
+			break;
+		#endif
+		
+		#if SUPPORT_AUTOREPLY
+		case 'R':
+			if (length == 1) {
+				printf_P(PSTR("xR%02x"), autoreply_get_count());
+			}
+			else if (str[1] == 'D' || str[1] == 'R') {
+				capture_trigger_t trigger;
+				int8_t n;
+				
+				if (!usbcan_decode_trigger(&str[2], length - 2, &trigger) ||
+					(n = autoreply_add(&trigger, str[1] == 'R')) < 0)
+					return false;
+				printf_P(PSTR("xR%02x"), n);
+			}
+			else if (str[1] == 'A' && length > 4) {
+				can_t reply;
+				
+				if (usbcan_decode_frame(&str[4], length - 4, &reply) != length - 4 ||
+					!autoreply_set_reply(hex_to_byte(&str[2]), &reply))
+					return false;
+			}
+			else if (str[1] == 'O' && length == 13) {
+				uint8_t c = (str[8] == 'f') ? AUTOREPLY_NONE : str[8] - '0';
+				uint8_t s = (str[11] == 'f') ? AUTOREPLY_NONE : str[11] - '0';
+				
+				if (!autoreply_set_options(hex_to_byte(&str[2]),
+						(hex_to_byte(&str[4]) << 8) | hex_to_byte(&str[6]),
+						c, hex_to_byte(&str[9]), s, str[12] - '0'))
+					return false;
+			}
+			else if (str[1] == '-' && length == 4) {
+				if (!autoreply_remove(hex_to_byte(&str[2])))
+					return false;
+			}
+			else if (str[1] == 'C' && length == 2) {
+				autoreply_clear();
+			}
+			else {
+				return false;
+			}
+			break;
+		#endif
+		
+		#if SUPPORT_REQUEST
+		case 'Q':
+			if (length == 1) {
+				printf_P(PSTR("xQ%02x%x"), request_get_count(), request_is_running());
+			}
+			else if (str[1] == '+') {
+				request_t request;
+				int8_t n;
+				
+				if (!usbcan_decode_request(&str[2], length - 2, &request) ||
+					(n = request_add(&request)) < 0)
+					return false;
+				printf_P(PSTR("xQ%02x"), n);
+			}
+			else if (str[1] == '-' && length == 4) {
+				if (!request_remove(hex_to_byte(&str[2])))
+					return false;
+			}
+			else if (str[1] == 'C' && length == 2) {
+				request_clear();
+			}
+			else if (str[1] == 'S' && length == 2) {
+				request_start();
+			}
+			else if (str[1] == 'X' && length == 2) {
+				request_stop();
+			}
+			else {
+				return false;
+			}
+			break;
+		#endif
+		
+		#if SUPPORT_J1939
+		case 'J':
+			if (length == 1) {
+				printf_P(PSTR("xJ%x%02x%02x"), j1939_is_enabled(),
+						j1939_get_address(), j1939_get_active());
+			}
+			else if (length == 2 && str[1] == '0') {
+				j1939_disable();
+			}
+			else if (length == 4 && str[1] == '1') {
+				j1939_enable(hex_to_byte(&str[2]));
+			}
+			else {
+				return false;
+			}
+			break;
+		#endif
+		
+		case 'L':
+			if (length == 1) {
+				printf_P(PSTR("xL%02x%02x%02x"), busload_get_current(),
+						busload_get_average(), busload_get_peak());
+			}
+			else if (length == 2 && str[1] == 'R') {
+				busload_reset_peak();
+			}
+			else if (length == 3 && str[1] == 'G' && (str[2] == '0' || str[2] == '1')) {
+				busload_set_gauge(str[2] == '1');
+			}
+			else {
+				return false;
+			}
+			break;
+		
+		case 'W':
+			if (length == 1) {
+				printf_P(PSTR("xW%x"), period_watch_get_state());
+			}
+			else if (length == 2 && str[1] == '0') {
+				period_watch_stop();
+			}
+			else if (length == 5) {
+				if (!period_watch_start((hex_to_byte(&str[1]) << 8) | hex_to_byte(&str[3])))
+					return false;
+			}
+			else {
+				return false;
+			}
+			break;
+		
+		case 'U':
+			if (length == 5) {
+				if (!pool_set_reserve(hex_to_byte(&str[1]), hex_to_byte(&str[3])))
+					return false;
+			}
+			else if (length == 1) {
+				printf_P(PSTR("xU%02x%02x%02x%04x%04x"), pool_get_free(),
+						pool_get_used(POOL_RX), pool_get_used(POOL_TX),
+						pool_get_failed(POOL_RX), pool_get_failed(POOL_TX));
+			}
+			else {
+				return false;
+			}
+			break;
+		
+		case 'A':
+			if ( channel_open || length != 1 ) {
+				return false;
+			}
+			temp = autobaud_detect();
+			if ( temp == AUTOBAUD_NONE ) {
+				return false;
+			}
+			else if ( temp & AUTOBAUD_CUSTOM ) {
+				printf_P(PSTR("xAC%x"), temp & ~AUTOBAUD_CUSTOM);
+			}
+			else {
+				// Take care of different index usage for 1 mbps.
+				if ( temp == BITRATE_1_MBPS ) {
+					temp++;
+				}
+				printf_P(PSTR("xA%x"), temp);
+			}
+			bitrate_set = true;
+			break;
+		
+		case 'P':
+		case 'D':
+		case 'O':
+			if ( !channel_open ) {
+				return false;
+			}
+			return usbcan_decode_tx_prefix(str, length);
+		
+		default:
+			return false;
+	}
+	
+	return true;
+}
+
 // ----------------------------------------------------------------------------
 void usbcan_decode_command(char *str, uint8_t length)
 {
@@ -154,8 +1245,8 @@ void usbcan_decode_command(char *str, uint8_t length)
 				if ( temp == 8 ) {
 					temp--;
 				}
-				// Set new bitrate, remember all MOB are cleared!
-				can_init(temp);
+				// Set new bitrate, the filters are restored afterwards.
+				mob_init(temp);
 				bitrate_set = true;
 			}
 			break;
@@ -168,7 +1259,7 @@ void usbcan_decode_command(char *str, uint8_t length)
 				goto error;
 			
 			} else {
-				if ( !usbcan_decode_message(str, length) ) {
+				if ( !usbcan_decode_message(str, length, NULL) ) {
 					goto error;
 				}
 			}
@@ -186,18 +1277,8 @@ void usbcan_decode_command(char *str, uint8_t length)
 				goto error;
 			
 			} else {
-				can_set_mode(NORMAL_MODE);
-				
-				// In case the baudrate changed, re-enable some filters.
-				can_filter_t filter = {
-					.mask = 0,
-					.id = 0,
-					.flags.extended = 0,
-					.flags.rtr = 0
-				};
-				for (uint8_t i=11; i<15; i++) {
-					can_set_filter(i, &filter);
-				}
+				mob_set_mode(NORMAL_MODE);
+				mob_open_catch_all();
 				
 				// Mark the channel as open.
 				channel_open = true;
@@ -209,7 +1290,8 @@ void usbcan_decode_command(char *str, uint8_t length)
 				goto error;
 			
 			} else {
-				can_set_mode(LISTEN_ONLY_MODE);
+				mob_set_mode(LISTEN_ONLY_MODE);
+				mob_open_catch_all();
 				channel_open = true;
 			}
 			break;
@@ -240,6 +1322,12 @@ void usbcan_decode_command(char *str, uint8_t length)
 			term_put_hex( (SOFTWARE_VERSION_MAJOR << 4) | SOFTWARE_VERSION_MINOR );
 			break;
 		
+		case 'x':	// extensions
+			if ( !usbcan_decode_extension(str + 1, length - 1) ) {
+				goto error;
+			}
+			break;
+		
 		case 'Z':
 			// Switch on or off timestamps.
 			// On Lawicel this value is stored in EEPROM.
@@ -265,53 +1353,102 @@ error:
 
 void usbcan_handle_protocol(void)
 {
-	static char buffer[40];
+	// long enough for the trigger of the capture with an extended identifier
+	static char buffer[64];
 	static uint8_t pos;
 	static can_error_register_t last_error = { 0, 0 };
 	can_error_register_t error;
 	
+	// events are sent in front of the received messages
+	const event_t *event = event_peek();
+	if (event != NULL && !channel_open) {
+		event_commit();
+	}
+	else if (event != NULL && term_tx_ready()) {
+		printf_P(PSTR("x%c%c"), event->type, event->code);
+		if (event->key & 0x80000000)
+			printf_P(PSTR("%08lx"), event->key & 0x1fffffff);
+		else
+			printf_P(PSTR("%03lx"), event->key);
+		printf_P(PSTR("%08lx\r"), event->value);
+		
+		event_commit();
+	}
+	
+	#if SUPPORT_ISOTP
+	// completely received ISO-TP PDUs
+	uint8_t channel;
+	uint16_t pdu_length;
+	const uint8_t *pdu = isotp_peek(&channel, &pdu_length);
+	if (pdu != NULL && !channel_open) {
+		isotp_commit(channel);
+	}
+	else if (pdu != NULL && term_tx_ready()) {
+		printf_P(PSTR("xtd%u%03x"), channel, pdu_length);
+		for (uint16_t i = 0; i < pdu_length; i++)
+			term_put_hex(pdu[i]);
+		term_putc('\r');
+		
+		isotp_commit(channel);
+	}
+	#endif
+	
+	#if SUPPORT_REQUEST
+	// responses of the request engine
+	const request_result_t *result = request_peek();
+	if (result != NULL && !channel_open) {
+		request_commit();
+	}
+	else if (result != NULL && term_tx_ready()) {
+		printf_P(PSTR("xqr%02x%08lx"), result->entry, result->latency);
+		usbcan_put_message(&result->msg);
+		term_putc('\r');
+		
+		request_commit();
+	}
+	#endif
+	
+	#if SUPPORT_J1939
+	// reassembled J1939 messages
+	j1939_message_t j1939;
+	uint8_t session = j1939_peek(&j1939);
+	if (session != 0xff && !channel_open) {
+		j1939_commit(session);
+	}
+	else if (session != 0xff && term_tx_ready()) {
+		printf_P(PSTR("xjd%06lx%02x%02x%03x"), j1939.pgn, j1939.source,
+				j1939.destination, j1939.length);
+		for (uint16_t i = 0; i < j1939.length; i++)
+			term_put_hex(j1939.data[i]);
+		term_putc('\r');
+		
+		j1939_commit(session);
+	}
+	#endif
+	
 	// check for new messages
-	if (can_check_message()) {
-		can_t message;
-		
-		// Only communicate data if channel is open.
-		// Due to left -> right evaluation messages are extracted from the 
-		// MOB to avoid overflow, even if no communication is desired.
-		if ( can_get_message(&message) && channel_open ) {
-			uint8_t length = message.length;
-			
-			if (message.flags.rtr)
-			{
-				// print identifier
-				if (message.flags.extended) {
-					printf_P(PSTR("R%08lx"), message.id);
-				} else {
-					uint16_t id = message.id;
-					printf_P(PSTR("r%03x"), id);
-				}
-				term_putc(length + '0');
-			}
-			else
-			{
-				// print identifier
-				if (message.flags.extended) {
-					printf_P(PSTR("T%08lx"), message.id);
-				} else {
-					uint16_t id = message.id;
-					printf_P(PSTR("t%03x"), id);
-				}
-				term_putc(length + '0');
-				
-				// print data
-				for (uint8_t i = 0; i < length; i++)
-					term_put_hex(message.data[i]);
-			}
-
-			if (use_timestamps)
-				printf_P(PSTR("%04x"), message.timestamp);
+	const rx_entry_t *entry = rx_queue_peek();
+	
+	// Only communicate data if channel is open. Messages are removed from
+	// the queue anyway to avoid an overflow, even if no communication is
+	// desired.
+	if (entry != NULL && !channel_open) {
+		rx_queue_commit();
+	}
+	else if (entry != NULL && term_tx_ready()) {
+		// The message is formatted directly from the queue. The slot is
+		// only released after the whole record was written, so a stalled
+		// USB connection leaves the message in the queue.
+		const can_t *message = &entry->msg;
+		
+		usbcan_put_message(message);
+		
+		if (use_timestamps)
+			printf_P(PSTR("%04x"), message->timestamp);
 
-			term_putc('\r');
-		}
+		term_putc('\r');
+		
+		rx_queue_commit();
 	}
 	
 	// get commands